@@ -0,0 +1,2040 @@
+/* kmdata Data Structures Library
+ * Benchmark program. Run with the name of a benchmark and, optionally, the
+ * problem sizes to use, e.g. ./bench oadict 1000 1m 50m */
+
+#include "bench.h"
+
+double bench_now(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+uint64_t bench_rand(uint64_t *state){
+    /* xorshift64*, plenty random for picking keys */
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+size_t bench_sizearg(const char *arg){
+    /* Accepts plain numbers or a k/m suffix. */
+    char *end;
+    size_t n = strtoull(arg, &end, 10);
+    if(*end == 'k' || *end == 'K'){
+        n *= 1000;
+    }else if(*end == 'm' || *end == 'M'){
+        n *= 1000000;
+    }
+    return n;
+}
+
+int32_t bench_intptr_hash(const void *key){
+    intptr_t k = (intptr_t)key;
+    return oat_hash(&k, sizeof(k));
+}
+
+int32_t bench_intptr_eq(const void *lhs, const void *rhs){
+    return ((intptr_t)lhs) == ((intptr_t)rhs);
+}
+
+void bench_engine_run(bench_engine_t *engine, size_t n, size_t lookups){
+    /* Keys 1..n go in, then random hits from that range and random misses
+     * from n+1..2n come out. Prints millions of operations per second. */
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    void *dict = engine->create(0);
+    intptr_t sum = 0;
+
+    double t0 = bench_now();
+    for(size_t i = 1; i <= n; i++){
+        engine->add(dict, (void *)i, (void *)i);
+    }
+    double t1 = bench_now();
+    for(size_t i = 0; i < lookups; i++){
+        sum += (intptr_t)engine->get(dict, (void *)(1 + bench_rand(&seed) % n));
+    }
+    double t2 = bench_now();
+    for(size_t i = 0; i < lookups; i++){
+        sum += (intptr_t)engine->get(dict, (void *)(n + 1 + bench_rand(&seed) % n));
+    }
+    double t3 = bench_now();
+    for(size_t i = 1; i <= n; i++){
+        sum -= (intptr_t)engine->remove(dict, (void *)i);
+    }
+    double t4 = bench_now();
+    engine->destroy(dict);
+
+    printf("%-10s %10zu %10.2f %10.2f %10.2f %10.2f %s\n", engine->name, n,
+        n / (t1 - t0) / 1e6, lookups / (t2 - t1) / 1e6,
+        lookups / (t3 - t2) / 1e6, n / (t4 - t3) / 1e6, sum ? "" : "(?)");
+}
+
+void *bench_dict_create(size_t size){
+    dict_t *dict = malloc(sizeof(dict_t));
+    dict_init(dict, size, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+    return dict;
+}
+
+void bench_dict_add(void *dict, void *key, void *data){
+    bucket_t result;
+    dict_add((dict_t *)dict, key, data, &result);
+}
+
+void *bench_dict_get(void *dict, void *key){
+    return dict_get((dict_t *)dict, key);
+}
+
+void *bench_dict_remove(void *dict, void *key){
+    bucket_t result;
+    return dict_remove((dict_t *)dict, key, &result);
+}
+
+void bench_dict_destroy(void *dict){
+    dict_clear((dict_t *)dict, 0);
+    free(dict);
+}
+
+void *bench_oadict_create(size_t size){
+    oadict_t *dict = malloc(sizeof(oadict_t));
+    oadict_init(dict, size, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+    return dict;
+}
+
+void bench_oadict_add(void *dict, void *key, void *data){
+    bucket_t result;
+    oadict_add((oadict_t *)dict, key, data, &result);
+}
+
+void *bench_oadict_get(void *dict, void *key){
+    return oadict_get((oadict_t *)dict, key);
+}
+
+void *bench_oadict_remove(void *dict, void *key){
+    bucket_t result;
+    return oadict_remove((oadict_t *)dict, key, &result);
+}
+
+void bench_oadict_destroy(void *dict){
+    oadict_clear((oadict_t *)dict, 0);
+    free(dict);
+}
+
+void bench_oadict(int argc, char **argv){
+    /* Chained dict_t against open addressing oadict_t. */
+    bench_engine_t engines[] = {
+        {"dict", bench_dict_create, bench_dict_add, bench_dict_get,
+            bench_dict_remove, bench_dict_destroy},
+        {"oadict", bench_oadict_create, bench_oadict_add, bench_oadict_get,
+            bench_oadict_remove, bench_oadict_destroy}
+    };
+    size_t defaults[] = {1000, 1000000, 50000000};
+    int32_t nsizes = argc > 0 ? argc : 3;
+
+    printf("%-10s %10s %10s %10s %10s %10s  (Mops/s)\n", "engine", "keys",
+        "add", "get hit", "get miss", "remove");
+    for(int32_t i = 0; i < nsizes; i++){
+        size_t n = argc > 0 ? bench_sizearg(argv[i]) : defaults[i];
+        size_t lookups = MAX(n, 10000000);
+        for(int32_t j = 0; j < 2; j++){
+            bench_engine_run(engines + j, n, lookups);
+        }
+    }
+}
+
+int bench_u32cmp(const void *lhs, const void *rhs){
+    uint32_t a = *(const uint32_t *)lhs, b = *(const uint32_t *)rhs;
+    return (a > b) - (a < b);
+}
+
+void bench_latency_run(const char *name, int32_t options, size_t n){
+    /* Times every single add and remove and reports the latency tail. */
+    uint32_t *lat = malloc(n * sizeof(uint32_t));
+    dict_t dict;
+    bucket_t result;
+    dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, options);
+
+    for(int32_t phase = 0; phase < 2; phase++){
+        double total = 0.0;
+        for(size_t i = 1; i <= n; i++){
+            double t0 = bench_now();
+            if(phase == 0){
+                dict_add(&dict, (void *)i, (void *)i, &result);
+            }else{
+                dict_remove(&dict, (void *)i, &result);
+            }
+            double dt = bench_now() - t0;
+            total += dt;
+            lat[i - 1] = (uint32_t)(dt * 1e9);
+        }
+        qsort(lat, n, sizeof(uint32_t), bench_u32cmp);
+        printf("%-12s %-7s %10zu %10.2f %10u %10u %10u %12u\n", name,
+            phase ? "remove" : "add", n, n / total / 1e6, lat[n / 2],
+            lat[(size_t)(n * 0.999)], lat[(size_t)(n * 0.99999)], lat[n - 1]);
+    }
+
+    dict_clear(&dict, 0);
+    free(lat);
+}
+
+void bench_rehash(int argc, char **argv){
+    /* Per operation latency of dict_add/dict_remove with and without
+     * DICTHT_INCREMENTAL. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 20000000;
+
+    printf("%-12s %-7s %10s %10s %10s %10s %10s %12s  (ns)\n", "mode", "op",
+        "keys", "Mops/s", "p50", "p99.9", "p99.999", "max");
+    bench_latency_run("default", DICTHT_DEFAULTS, n);
+    bench_latency_run("incremental", DICTHT_INCREMENTAL, n);
+}
+
+void bench_alpha26(char *buf, intptr_t n){
+    /* Same key generator as alpha26 in unittest.c */
+    int i = 0;
+    while(n > 0){
+        buf[i++] = (char)(n % 26) + 'a';
+        n /= 26;
+    }
+    buf[i] = '\0';
+}
+
+uint64_t bench_hash_calls = 0, bench_eq_calls = 0;
+
+int32_t bench_counting_string_hash(const void *str){
+    bench_hash_calls++;
+    return oat_string_hash(str);
+}
+
+int32_t bench_counting_string_eq(const void *lhs, const void *rhs){
+    bench_eq_calls++;
+    return !strcmp((const char *)lhs, (const char *)rhs);
+}
+
+void bench_strkeys(int argc, char **argv){
+    /* The test_dict_resize workload scaled up: add alpha26 keys 11..n, get
+     * them all back, then remove most of them so the table shrinks. Time
+     * spent in adds and removes that resized the table is reported apart. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 4000000;
+    char buf[16];
+    dict_t dict;
+    bucket_t result;
+    double resize_time = 0.0, t0, t1, start;
+    size_t resizes = 0;
+
+    dict_init(&dict, 0, bench_counting_string_hash, bench_counting_string_eq,
+        DICTHT_DEFAULTS);
+
+    printf("%-8s %10s %12s %12s %10s %10s\n", "phase", "keys", "hash calls",
+        "eq calls", "seconds", "resize s");
+
+    start = bench_now();
+    for(intptr_t i = 11; i < n; i++){
+        bench_alpha26(buf, i);
+        char *key = strdup(buf);
+        size_t length = dict.length;
+        t0 = bench_now();
+        dict_add(&dict, key, (void *)i, &result);
+        t1 = bench_now();
+        if(dict.length != length){
+            resize_time += t1 - t0;
+            resizes++;
+        }
+    }
+    printf("%-8s %10zu %12lu %12lu %10.3f %10.3f\n", "add", n - 11,
+        bench_hash_calls, bench_eq_calls, bench_now() - start, resize_time);
+
+    bench_hash_calls = bench_eq_calls = 0;
+    start = bench_now();
+    for(intptr_t i = 11; i < n; i++){
+        bench_alpha26(buf, i);
+        if((intptr_t)dict_get(&dict, buf) != i){
+            fprintf(stderr, "Corrupted dictionary at %s\n", buf);
+        }
+    }
+    printf("%-8s %10zu %12lu %12lu %10.3f %10s\n", "get", n - 11,
+        bench_hash_calls, bench_eq_calls, bench_now() - start, "-");
+
+    bench_hash_calls = bench_eq_calls = 0;
+    resize_time = 0.0;
+    start = bench_now();
+    for(intptr_t i = 500; i < n; i++){
+        bench_alpha26(buf, i);
+        size_t length = dict.length;
+        t0 = bench_now();
+        dict_remove(&dict, buf, &result);
+        t1 = bench_now();
+        if(dict.length != length){
+            resize_time += t1 - t0;
+            resizes++;
+        }
+        free(result.key);
+    }
+    printf("%-8s %10zu %12lu %12lu %10.3f %10.3f\n", "remove", n - 500,
+        bench_hash_calls, bench_eq_calls, bench_now() - start, resize_time);
+    printf("%zu resizes\n", resizes);
+
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+}
+
+static inline int32_t bench_intptr_oat_inline(intptr_t key){
+    return oat_hash_inline(&key, sizeof(key));
+}
+
+KM_DICT_DEFINE(intdict, intptr_t, intptr_t, km_intptr_hash, km_intptr_eq)
+
+KM_DICT_DEFINE(oatdict, intptr_t, intptr_t, bench_intptr_oat_inline, km_intptr_eq)
+
+void *bench_intdict_create(size_t size){
+    intdict_t *dict = malloc(sizeof(intdict_t));
+    intdict_init(dict, size, DICTHT_DEFAULTS);
+    return dict;
+}
+
+void bench_intdict_add(void *dict, void *key, void *data){
+    intdict_entry_t result;
+    intdict_add((intdict_t *)dict, (intptr_t)key, (intptr_t)data, &result);
+}
+
+void *bench_intdict_get(void *dict, void *key){
+    intptr_t *value = intdict_get((intdict_t *)dict, (intptr_t)key);
+    return value == NULL ? NULL : (void *)*value;
+}
+
+void *bench_intdict_remove(void *dict, void *key){
+    intdict_entry_t result;
+    if(intdict_remove((intdict_t *)dict, (intptr_t)key, &result)){
+        return (void *)result.data;
+    }
+    return NULL;
+}
+
+void bench_intdict_destroy(void *dict){
+    intdict_clear((intdict_t *)dict);
+    free(dict);
+}
+
+void *bench_oatdict_create(size_t size){
+    oatdict_t *dict = malloc(sizeof(oatdict_t));
+    oatdict_init(dict, size, DICTHT_DEFAULTS);
+    return dict;
+}
+
+void bench_oatdict_add(void *dict, void *key, void *data){
+    oatdict_entry_t result;
+    oatdict_add((oatdict_t *)dict, (intptr_t)key, (intptr_t)data, &result);
+}
+
+void *bench_oatdict_get(void *dict, void *key){
+    intptr_t *value = oatdict_get((oatdict_t *)dict, (intptr_t)key);
+    return value == NULL ? NULL : (void *)*value;
+}
+
+void *bench_oatdict_remove(void *dict, void *key){
+    oatdict_entry_t result;
+    if(oatdict_remove((oatdict_t *)dict, (intptr_t)key, &result)){
+        return (void *)result.data;
+    }
+    return NULL;
+}
+
+void bench_oatdict_destroy(void *dict){
+    oatdict_clear((oatdict_t *)dict);
+    free(dict);
+}
+
+void bench_tdict(int argc, char **argv){
+    /* dict_t against KM_DICT_DEFINE tables on intptr_t keys. oatdict uses
+     * the same one-at-a-time hash as dict_t does here, inlined; intdict uses
+     * km_intptr_hash. */
+    bench_engine_t engines[] = {
+        {"dict", bench_dict_create, bench_dict_add, bench_dict_get,
+            bench_dict_remove, bench_dict_destroy},
+        {"oatdict", bench_oatdict_create, bench_oatdict_add, bench_oatdict_get,
+            bench_oatdict_remove, bench_oatdict_destroy},
+        {"intdict", bench_intdict_create, bench_intdict_add, bench_intdict_get,
+            bench_intdict_remove, bench_intdict_destroy}
+    };
+    size_t defaults[] = {1000, 1000000, 10000000};
+    int32_t nsizes = argc > 0 ? argc : 3;
+
+    printf("%-10s %10s %10s %10s %10s %10s  (Mops/s)\n", "engine", "keys",
+        "add", "get hit", "get miss", "remove");
+    for(int32_t i = 0; i < nsizes; i++){
+        size_t n = argc > 0 ? bench_sizearg(argv[i]) : defaults[i];
+        size_t lookups = MAX(n, 10000000);
+        for(int32_t j = 0; j < 3; j++){
+            bench_engine_run(engines + j, n, lookups);
+        }
+    }
+}
+
+void bench_getmany(int argc, char **argv){
+    /* A loop of dict_get against dict_get_many at a few batch sizes, on a
+     * table much bigger than the last level cache. Random hits. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 20000000;
+    size_t lookups = argc > 1 ? bench_sizearg(argv[1]) : 20000000;
+    size_t batches[] = {16, 64, 256};
+    void *keys[256], *values[256];
+    uint64_t seed = 42;
+    intptr_t sum = 0;
+    dict_t dict;
+    bucket_t result;
+
+    dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+    for(size_t i = 1; i <= n; i++){
+        dict_add(&dict, (void *)i, (void *)i, &result);
+    }
+
+    printf("%-16s %10s %12s\n", "method", "keys", "Mlookups/s");
+    double t0 = bench_now();
+    for(size_t i = 0; i < lookups; i++){
+        sum += (intptr_t)dict_get(&dict, (void *)(1 + bench_rand(&seed) % n));
+    }
+    printf("%-16s %10zu %12.2f\n", "dict_get", n, lookups / (bench_now() - t0) / 1e6);
+
+    for(int32_t b = 0; b < 3; b++){
+        size_t batch = batches[b];
+        t0 = bench_now();
+        for(size_t i = 0; i < lookups; i += batch){
+            for(size_t j = 0; j < batch; j++){
+                keys[j] = (void *)(1 + bench_rand(&seed) % n);
+            }
+            dict_get_many(&dict, keys, values, batch);
+            sum += (intptr_t)values[batch - 1];
+        }
+        char label[32];
+        snprintf(label, sizeof(label), "get_many/%zu", batch);
+        printf("%-16s %10zu %12.2f\n", label, n, lookups / (bench_now() - t0) / 1e6);
+    }
+
+    dict_clear(&dict, 0);
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+int32_t bench_weak_intptr_hash(const void *key){
+    /* Only 64 different hashes, like a badly chosen hash or an attacker
+     * picking keys. */
+    return (int32_t)((intptr_t)key & 63);
+}
+
+int32_t bench_intptr_cmp(const void *lhs, const void *rhs){
+    return (intptr_t)lhs < (intptr_t)rhs ? -1 : (intptr_t)lhs > (intptr_t)rhs;
+}
+
+void bench_treeify(int argc, char **argv){
+    /* Build and random hit lookups with and without DICTHT_TREEIFY, under a
+     * hash that only has 64 values and under a good one. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 20000;
+    size_t lookups = argc > 1 ? bench_sizearg(argv[1]) : 200000;
+    int32_t (*hashes[])(const void *) = {bench_weak_intptr_hash, bench_intptr_hash};
+    const char *hash_names[] = {"weak", "oat"};
+    int32_t options[] = {DICTHT_DEFAULTS, DICTHT_TREEIFY};
+    intptr_t sum = 0;
+    bucket_t result;
+
+    printf("%-6s %-10s %10s %12s %12s\n", "hash", "options", "keys", "build ms", "Mlookups/s");
+    for(int32_t h = 0; h < 2; h++){
+        for(int32_t k = 0; k < 2; k++){
+            uint64_t seed = 42;
+            dict_t dict;
+            dict_init(&dict, 0, hashes[h], bench_intptr_eq, options[k]);
+            dict_set_cmp(&dict, bench_intptr_cmp);
+
+            double t0 = bench_now();
+            for(size_t i = 1; i <= n; i++){
+                dict_add(&dict, (void *)i, (void *)i, &result);
+            }
+            double build = bench_now() - t0;
+
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                sum += (intptr_t)dict_get(&dict, (void *)(1 + bench_rand(&seed) % n));
+            }
+            printf("%-6s %-10s %10zu %12.2f %12.2f\n", hash_names[h],
+                k ? "TREEIFY" : "DEFAULTS", n, build * 1e3,
+                lookups / (bench_now() - t0) / 1e6);
+            dict_clear(&dict, 0);
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+int32_t bench_identity_hash(const void *key){
+    return (int32_t)(intptr_t)key;
+}
+
+void bench_pow2(int argc, char **argv){
+    /* Random hit lookups with MOD indexing against DICTHT_POW2, for each
+     * table size given. Keys are spaced 64 apart so the identity hash is a
+     * weak one. */
+    size_t default_sizes[] = {10000, 1000000, 10000000};
+    size_t lookups = 10000000;
+    int32_t (*hashes[])(const void *) = {bench_identity_hash, bench_intptr_hash};
+    const char *hash_names[] = {"identity", "oat"};
+    int32_t options[] = {DICTHT_DEFAULTS, DICTHT_POW2};
+    intptr_t sum = 0;
+    bucket_t result;
+
+    int32_t count = argc > 0 ? argc : 3;
+    printf("%-9s %-9s %10s %12s %8s\n", "hash", "options", "keys", "Mlookups/s", "longest");
+    for(int32_t s = 0; s < count; s++){
+        size_t n = argc > 0 ? bench_sizearg(argv[s]) : default_sizes[s];
+        for(int32_t h = 0; h < 2; h++){
+            for(int32_t k = 0; k < 2; k++){
+                uint64_t seed = 42;
+                dict_t dict;
+                dict_init(&dict, 0, hashes[h], bench_intptr_eq, options[k]);
+                for(size_t i = 1; i <= n; i++){
+                    dict_add(&dict, (void *)(i << 6), (void *)i, &result);
+                }
+
+                size_t longest = 0;
+                for(size_t i = 0; i < dict.length; i++){
+                    size_t chain_length = 0;
+                    for(bucket_t *b = dict.table[i]; b != NULL; b = b->next){
+                        chain_length++;
+                    }
+                    longest = MAX(longest, chain_length);
+                }
+
+                double t0 = bench_now();
+                for(size_t i = 0; i < lookups; i++){
+                    void *key = (void *)((1 + bench_rand(&seed) % n) << 6);
+                    sum += (intptr_t)dict_get(&dict, key);
+                }
+                printf("%-9s %-9s %10zu %12.2f %8zu\n", hash_names[h],
+                    k ? "POW2" : "DEFAULTS", n, lookups / (bench_now() - t0) / 1e6,
+                    longest);
+                dict_clear(&dict, 0);
+            }
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+typedef struct {
+    cdict_t *cdict;
+    dict_t *dict;
+    pthread_mutex_t *lock;
+    size_t n;
+    size_t ops;
+    int32_t read_percent;
+    uint64_t seed;
+} bench_thread_arg_t;
+
+void *bench_cdict_worker(void *arg){
+    /* Random hits and misses over 2n keys. Writes are half adds and half
+     * removes, so the size stays around n. */
+    bench_thread_arg_t *targ = (bench_thread_arg_t *)arg;
+    bucket_t result;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < targ->ops; i++){
+        uint64_t r = bench_rand(&targ->seed);
+        void *key = (void *)(1 + (r >> 8) % (targ->n * 2));
+        if((int32_t)(r % 100) < targ->read_percent){
+            sum += (intptr_t)cdict_get(targ->cdict, key);
+        }else if(r & 128){
+            cdict_add(targ->cdict, key, key, &result);
+        }else{
+            cdict_remove(targ->cdict, key, &result);
+        }
+    }
+    return (void *)sum;
+}
+
+void *bench_locked_worker(void *arg){
+    /* The same mix on a dict_t behind one mutex. */
+    bench_thread_arg_t *targ = (bench_thread_arg_t *)arg;
+    bucket_t result;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < targ->ops; i++){
+        uint64_t r = bench_rand(&targ->seed);
+        void *key = (void *)(1 + (r >> 8) % (targ->n * 2));
+        pthread_mutex_lock(targ->lock);
+        if((int32_t)(r % 100) < targ->read_percent){
+            sum += (intptr_t)dict_get(targ->dict, key);
+        }else if(r & 128){
+            dict_add(targ->dict, key, key, &result);
+        }else{
+            dict_remove(targ->dict, key, &result);
+        }
+        pthread_mutex_unlock(targ->lock);
+    }
+    return (void *)sum;
+}
+
+void bench_cdict(int argc, char **argv){
+    /* Total throughput from 1 to max threads at 95/5 and 50/50 read/write
+     * mixes, for cdict_t and for dict_t behind a global mutex. Each thread
+     * does ops operations. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 1000000;
+    size_t ops = argc > 1 ? bench_sizearg(argv[1]) : 1000000;
+    int32_t max_threads = argc > 2 ? atoi(argv[2]) : 64;
+    int32_t mixes[] = {95, 50};
+    pthread_t threads[256];
+    bench_thread_arg_t args[256];
+    bucket_t result;
+
+    if(max_threads > 256){
+        max_threads = 256;
+    }
+
+    printf("%-8s %-6s %8s %10s\n", "dict", "reads", "threads", "Mops/s");
+    for(int32_t m = 0; m < 2; m++){
+        for(int32_t engine = 0; engine < 2; engine++){
+            for(int32_t t = 1; t <= max_threads; t *= 2){
+                cdict_t cdict;
+                dict_t dict;
+                pthread_mutex_t lock;
+                pthread_mutex_init(&lock, NULL);
+                if(engine == 0){
+                    cdict_init(&cdict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+                }else{
+                    dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+                }
+                for(size_t i = 1; i <= n * 2; i += 2){
+                    if(engine == 0){
+                        cdict_add(&cdict, (void *)i, (void *)i, &result);
+                    }else{
+                        dict_add(&dict, (void *)i, (void *)i, &result);
+                    }
+                }
+
+                double t0 = bench_now();
+                for(int32_t i = 0; i < t; i++){
+                    args[i] = (bench_thread_arg_t){&cdict, &dict, &lock, n, ops,
+                                mixes[m], 42 + i};
+                    pthread_create(threads + i, NULL,
+                        engine == 0 ? bench_cdict_worker : bench_locked_worker, args + i);
+                }
+                for(int32_t i = 0; i < t; i++){
+                    pthread_join(threads[i], NULL);
+                }
+                double elapsed = bench_now() - t0;
+
+                char reads[16];
+                snprintf(reads, sizeof(reads), "%d/%d", mixes[m], 100 - mixes[m]);
+                printf("%-8s %-6s %8d %10.2f\n", engine == 0 ? "cdict" : "locked",
+                    reads, t, ops * t / elapsed / 1e6);
+
+                if(engine == 0){
+                    cdict_clear(&cdict, 0);
+                }else{
+                    dict_clear(&dict, 0);
+                }
+                pthread_mutex_destroy(&lock);
+            }
+        }
+    }
+}
+
+size_t bench_heap_bytes(){
+    /* Heap in use, counting big blocks malloc got straight from mmap. */
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+}
+
+void bench_small(int argc, char **argv){
+    /* Creates count dicts holding k keys each, then tears them all down.
+     * Starting small (size 0) against asking for a full table up front,
+     * which is what every dict_init did before small dicts. */
+    size_t count = argc > 0 ? bench_sizearg(argv[0]) : 50000;
+    int32_t key_counts[] = {0, 3, 8, 9, 32};
+    size_t sizes[] = {0, DICTHT_MINIMUM_SIZE};
+    dict_t *dicts = malloc(count * sizeof(dict_t));
+    bucket_t result;
+
+    printf("%-6s %5s %10s %14s %14s %14s\n", "start", "keys", "dicts",
+        "create ns/dict", "bytes/dict", "clear ns/dict");
+    for(int32_t k = 0; k < 5; k++){
+        for(int32_t s = 0; s < 2; s++){
+            size_t before = bench_heap_bytes();
+            double t0 = bench_now();
+            for(size_t i = 0; i < count; i++){
+                dict_init(dicts + i, sizes[s], bench_intptr_hash, bench_intptr_eq,
+                    DICTHT_DEFAULTS);
+                for(intptr_t j = 1; j <= key_counts[k]; j++){
+                    dict_add(dicts + i, (void *)j, (void *)j, &result);
+                }
+            }
+            double create = bench_now() - t0;
+            size_t bytes = bench_heap_bytes() - before;
+
+            t0 = bench_now();
+            for(size_t i = 0; i < count; i++){
+                dict_clear(dicts + i, 0);
+            }
+            double clear = bench_now() - t0;
+
+            printf("%-6s %5d %10zu %14.1f %14.1f %14.1f\n", s ? "table" : "small",
+                key_counts[k], count, create / count * 1e9, (double)bytes / count,
+                clear / count * 1e9);
+        }
+    }
+    free(dicts);
+}
+
+void bench_odict(int argc, char **argv){
+    /* Memory, build time, key_set iteration and random hit lookups for
+     * dict_t against odict_t, for each size given. */
+    size_t default_sizes[] = {1000, 100000, 1000000};
+    int32_t count = argc > 0 ? argc : 3;
+    size_t lookups = 5000000;
+    intptr_t sum = 0;
+    bucket_t result;
+
+    printf("%-6s %10s %12s %10s %14s %12s\n", "dict", "keys", "bytes/key", "build ms",
+        "key_set ns/key", "Mlookups/s");
+    for(int32_t s = 0; s < count; s++){
+        size_t n = argc > 0 ? bench_sizearg(argv[s]) : default_sizes[s];
+        for(int32_t engine = 0; engine < 2; engine++){
+            dict_t dict;
+            odict_t odict;
+            uint64_t seed = 42;
+
+            size_t before = bench_heap_bytes();
+            double t0 = bench_now();
+            if(engine == 0){
+                dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+            }else{
+                odict_init(&odict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+            }
+            for(size_t i = 1; i <= n; i++){
+                if(engine == 0){
+                    dict_add(&dict, (void *)i, (void *)i, &result);
+                }else{
+                    odict_add(&odict, (void *)i, (void *)i, &result);
+                }
+            }
+            double build = bench_now() - t0;
+            size_t bytes = bench_heap_bytes() - before;
+
+            /* Repeat small key_sets so they take long enough to time. */
+            size_t reps = 1 + 10000000 / n;
+            t0 = bench_now();
+            for(size_t r = 0; r < reps; r++){
+                list_t keys;
+                list_init(&keys);
+                if(engine == 0){
+                    dict_key_set(&keys, &dict);
+                }else{
+                    odict_key_set(&keys, &odict);
+                }
+                sum += (intptr_t)keys.head->next->data;
+                list_clear(&keys, 0);
+            }
+            double iterate = bench_now() - t0;
+
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                void *key = (void *)(1 + bench_rand(&seed) % n);
+                if(engine == 0){
+                    sum += (intptr_t)dict_get(&dict, key);
+                }else{
+                    sum += (intptr_t)odict_get(&odict, key);
+                }
+            }
+            double lookup = bench_now() - t0;
+
+            printf("%-6s %10zu %12.1f %10.2f %14.1f %12.2f\n", engine ? "odict" : "dict",
+                n, (double)bytes / n, build * 1e3, iterate / reps / n * 1e9,
+                lookups / lookup / 1e6);
+            if(engine == 0){
+                dict_clear(&dict, 0);
+            }else{
+                odict_clear(&odict, 0);
+            }
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+void bench_upsert(int argc, char **argv){
+    /* Word counting: ops random picks from a vocabulary of words, counted
+     * with dict_get then dict_add, and with dict_upsert. Also plain
+     * overwrites through dict_add once every word is in. */
+    size_t words = argc > 0 ? bench_sizearg(argv[0]) : 100000;
+    size_t ops = argc > 1 ? bench_sizearg(argv[1]) : 10000000;
+    char **vocabulary = malloc(words * sizeof(char *));
+    char buf[16];
+    bucket_t result;
+    int32_t inserted;
+
+    for(size_t i = 0; i < words; i++){
+        bench_alpha26(buf, i + 1);
+        vocabulary[i] = strdup(buf);
+    }
+
+    printf("%-10s %10s %12s %10s\n", "method", "words", "ops", "Mops/s");
+    for(int32_t method = 0; method < 3; method++){
+        dict_t dict;
+        uint64_t seed = 42;
+        dict_init(&dict, 0, oat_string_hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+
+        double t0 = bench_now();
+        for(size_t i = 0; i < ops; i++){
+            char *word = vocabulary[bench_rand(&seed) % words];
+            if(method == 0){
+                intptr_t count = (intptr_t)dict_get(&dict, word);
+                dict_add(&dict, word, (void *)(count + 1), &result);
+            }else if(method == 1){
+                dict_add(&dict, word, (void *)i, &result);
+            }else{
+                bucket_t *count = dict_upsert(&dict, word, &inserted);
+                count->data = (void *)((intptr_t)count->data + 1);
+            }
+        }
+        printf("%-10s %10zu %12zu %10.2f\n",
+            method == 0 ? "get+add" : method == 1 ? "add" : "upsert",
+            words, ops, ops / (bench_now() - t0) / 1e6);
+        dict_clear(&dict, 0);
+    }
+
+    for(size_t i = 0; i < words; i++){
+        free(vocabulary[i]);
+    }
+    free(vocabulary);
+}
+
+void bench_drop_cache(const char *path){
+    /* Asks the kernel to forget path's cached pages, so the next open has
+     * to go to disk. Best effort: the pages have to be clean. */
+    int fd = open(path, O_RDONLY);
+    if(fd >= 0){
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+void bench_snapshot(int argc, char **argv){
+    /* Time to first lookup for a dict of string keys: rebuilding it with
+     * dict_add from a text file of "key value" lines, against mapping a
+     * dsnap_write snapshot of it. Both with the files' pages dropped from
+     * the page cache first and with them cached. Then random hit lookups
+     * through each. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 1000000;
+    size_t lookups = 5000000;
+    const char *text_path = "/tmp/kmdata_bench.txt";
+    const char *snap_path = "/tmp/kmdata_bench.snap";
+    char **words = malloc(n * sizeof(char *));
+    char buf[64];
+    bucket_t result;
+    intptr_t sum = 0;
+
+    dict_t dict;
+    dict_init(&dict, 0, oat_string_hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+    FILE *text = fopen(text_path, "w");
+    for(size_t i = 0; i < n; i++){
+        bench_alpha26(buf, i + 1);
+        words[i] = strdup(buf);
+        dict_add(&dict, words[i], (void *)(i + 1), &result);
+        fprintf(text, "%s %zu\n", words[i], i + 1);
+    }
+    fclose(text);
+    if(dsnap_write(snap_path, &dict, NULL)){
+        return;
+    }
+    dict_clear(&dict, 0);
+
+    printf("%-10s %10s %6s %14s %12s\n", "method", "keys", "cache", "first get ms",
+        "Mlookups/s");
+    for(int32_t method = 0; method < 2; method++){
+        for(int32_t cold = 1; cold >= 0; cold--){
+            dsnap_t snap;
+            uint64_t seed = 42;
+            if(cold){
+                bench_drop_cache(method ? snap_path : text_path);
+            }
+
+            double t0 = bench_now();
+            if(method == 0){
+                dict_init(&dict, 0, oat_string_hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+                text = fopen(text_path, "r");
+                size_t value;
+                while(fscanf(text, "%63s %zu", buf, &value) == 2){
+                    dict_add(&dict, strdup(buf), (void *)value, &result);
+                }
+                fclose(text);
+                sum += (intptr_t)dict_get(&dict, words[n / 2]);
+            }else{
+                dsnap_open(&snap, snap_path, oat_string_hash);
+                sum += *(const intptr_t *)dsnap_get(&snap, words[n / 2], NULL);
+            }
+            double first = bench_now() - t0;
+
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                char *word = words[bench_rand(&seed) % n];
+                if(method == 0){
+                    sum += (intptr_t)dict_get(&dict, word);
+                }else{
+                    sum += *(const intptr_t *)dsnap_get(&snap, word, NULL);
+                }
+            }
+            double lookup = bench_now() - t0;
+
+            printf("%-10s %10zu %6s %14.3f %12.2f\n", method ? "dsnap" : "rebuild", n,
+                cold ? "cold" : "warm", first * 1e3, lookups / lookup / 1e6);
+            if(method == 0){
+                dict_clear(&dict, DICTHT_FREE_KEYS);
+            }else{
+                dsnap_close(&snap);
+            }
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+
+    remove(text_path);
+    remove(snap_path);
+    for(size_t i = 0; i < n; i++){
+        free(words[i]);
+    }
+    free(words);
+}
+
+void bench_build(int argc, char **argv){
+    /* Building a dict of n integer keys with dict_add one at a time, then
+     * with dict_build at 1 to 32 threads. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 10000000;
+    int32_t max_threads = argc > 1 ? (int32_t)bench_sizearg(argv[1]) : 32;
+    void **keys = malloc(n * sizeof(void *));
+    bucket_t result;
+    for(size_t i = 0; i < n; i++){
+        keys[i] = (void *)(i + 1);
+    }
+
+    printf("%-10s %8s %10s %10s %10s\n", "method", "threads", "keys", "seconds", "Mpairs/s");
+    for(int32_t threads = 0; threads <= max_threads; threads = threads ? threads * 2 : 1){
+        dict_t dict;
+        dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+        double t0 = bench_now();
+        if(threads == 0){
+            for(size_t i = 0; i < n; i++){
+                dict_add(&dict, keys[i], keys[i], &result);
+            }
+        }else{
+            dict_build(&dict, keys, keys, n, threads);
+        }
+        double seconds = bench_now() - t0;
+        printf("%-10s %8d %10zu %10.3f %10.2f%s\n", threads ? "dict_build" : "dict_add",
+            threads, n, seconds, n / seconds / 1e6,
+            (size_t)dict.load == n && dict_get(&dict, keys[n / 2]) == keys[n / 2] ? "" : " (?)");
+        dict_clear(&dict, 0);
+    }
+    free(keys);
+}
+
+void bench_sum_values(void *key, void *data, void *acc){
+    *(intptr_t *)acc += (intptr_t)data;
+}
+
+void bench_scan(int argc, char **argv){
+    /* Summing every value of an n key dict through dict_value_set and
+     * through dict_parallel_for_each at 1 to 32 threads, then tearing it
+     * down with dict_clear and dict_parallel_clear. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 5000000;
+    int32_t max_threads = argc > 1 ? (int32_t)bench_sizearg(argv[1]) : 32;
+    intptr_t sums[32];
+    void *accs[32];
+    bucket_t result;
+    dict_t dict;
+
+    dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+    for(size_t i = 1; i <= n; i++){
+        dict_add(&dict, (void *)i, (void *)i, &result);
+    }
+    intptr_t expected = (intptr_t)(n * (n + 1) / 2);
+
+    printf("%-18s %8s %10s %10s\n", "scan", "threads", "keys", "ms");
+    for(int32_t threads = 0; threads <= max_threads; threads = threads ? threads * 2 : 1){
+        intptr_t sum = 0;
+        double t0 = bench_now();
+        if(threads == 0){
+            list_t values;
+            list_init(&values);
+            dict_value_set(&values, &dict);
+            for(node_t *node = values.head->next; node != values.head; node = node->next){
+                sum += (intptr_t)node->data;
+            }
+            list_clear(&values, 0);
+        }else{
+            for(int32_t t = 0; t < threads; t++){
+                sums[t] = 0;
+                accs[t] = sums + t;
+            }
+            dict_parallel_for_each(&dict, threads, bench_sum_values, accs);
+            for(int32_t t = 0; t < threads; t++){
+                sum += sums[t];
+            }
+        }
+        printf("%-18s %8d %10zu %10.2f%s\n",
+            threads ? "parallel_for_each" : "value_set", threads, n,
+            (bench_now() - t0) * 1e3, sum == expected ? "" : " (?)");
+    }
+
+    /* Every clear gets a dict rebuilt on a heap that has been through a
+     * clear, so they all free buckets laid out the same way. */
+    dict_clear(&dict, 0);
+    for(int32_t threads = 0; threads <= max_threads; threads = threads ? threads * 2 : 1){
+        dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+        for(size_t i = 1; i <= n; i++){
+            dict_add(&dict, (void *)i, (void *)i, &result);
+        }
+        double t0 = bench_now();
+        if(threads == 0){
+            dict_clear(&dict, 0);
+        }else{
+            dict_parallel_clear(&dict, 0, threads);
+        }
+        printf("%-18s %8d %10zu %10.2f\n", threads ? "parallel_clear" : "clear", threads,
+            n, (bench_now() - t0) * 1e3);
+    }
+}
+
+void bench_freeze(int argc, char **argv){
+    /* dict_get against fdict_get on the same integer keys: heap bytes per
+     * key, the time fdict_freeze takes, and random hit and miss lookups. */
+    size_t default_sizes[] = {100000, 1000000, 10000000};
+    int32_t count = argc > 0 ? argc : 3;
+    size_t lookups = 10000000;
+    bucket_t result;
+    intptr_t sum = 0;
+
+    printf("%-6s %10s %10s %10s %10s %10s %10s\n", "dict", "keys", "bytes/key",
+        "build ms", "overflow", "Mhits/s", "Mmisses/s");
+    for(int32_t s = 0; s < count; s++){
+        size_t n = argc > 0 ? bench_sizearg(argv[s]) : default_sizes[s];
+        dict_t dict;
+        fdict_t frozen;
+
+        size_t before = bench_heap_bytes();
+        double t0 = bench_now();
+        dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+        for(size_t i = 1; i <= n; i++){
+            dict_add(&dict, (void *)i, (void *)i, &result);
+        }
+        double build = bench_now() - t0;
+        size_t dict_bytes = bench_heap_bytes() - before;
+
+        before = bench_heap_bytes();
+        t0 = bench_now();
+        if(fdict_freeze(&frozen, &dict)){
+            printf("fdict_freeze failed\n");
+            return;
+        }
+        double freeze = bench_now() - t0;
+        size_t frozen_bytes = bench_heap_bytes() - before;
+
+        for(int32_t engine = 0; engine < 2; engine++){
+            uint64_t seed = 42;
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                void *key = (void *)(1 + bench_rand(&seed) % n);
+                sum += (intptr_t)(engine ? fdict_get(&frozen, key) : dict_get(&dict, key));
+            }
+            double hits = bench_now() - t0;
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                void *key = (void *)(n + 1 + bench_rand(&seed) % n);
+                sum += (intptr_t)(engine ? fdict_get(&frozen, key) : dict_get(&dict, key));
+            }
+            double misses = bench_now() - t0;
+
+            printf("%-6s %10zu %10.1f %10.1f %10d %10.2f %10.2f\n",
+                engine ? "fdict" : "dict", n,
+                (double)(engine ? frozen_bytes : dict_bytes) / n,
+                (engine ? freeze : build) * 1e3, engine ? frozen.overflow.load : 0,
+                lookups / hits / 1e6, lookups / misses / 1e6);
+        }
+        dict_clear(&dict, 0);
+        fdict_clear(&frozen, 0);
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+void bench_hset(int argc, char **argv){
+    /* dict_t with NULL data against hset_t as a set of integer keys: heap
+     * bytes per key, build time and membership tests (half hits). Then the
+     * union, intersection and difference of keys 1..n and n/2+1..3n/2, done
+     * with hset's set operations and with a key_set scan and dict_get and
+     * dict_add calls. */
+    size_t default_sizes[] = {1000, 100000, 1000000};
+    int32_t count = argc > 0 ? argc : 3;
+    size_t lookups = 5000000;
+    bucket_t result;
+    intptr_t sum = 0;
+
+    printf("%-6s %10s %10s %10s %12s %10s %10s %10s\n", "set", "keys", "bytes/key",
+        "build ms", "Mcontains/s", "union ms", "inter ms", "diff ms");
+    for(int32_t s = 0; s < count; s++){
+        size_t n = argc > 0 ? bench_sizearg(argv[s]) : default_sizes[s];
+        for(int32_t engine = 0; engine < 2; engine++){
+            dict_t dicts[2];
+            hset_t sets[2];
+            double ms[3];
+            uint64_t seed = 42;
+
+            size_t before = bench_heap_bytes();
+            double t0 = bench_now();
+            for(int32_t k = 0; k < 2; k++){
+                if(engine == 0){
+                    dict_init(dicts + k, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+                }else{
+                    hset_init(sets + k, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+                }
+                for(size_t i = 1 + k * n / 2; i <= n + k * n / 2; i++){
+                    if(engine == 0){
+                        dict_add(dicts + k, (void *)i, NULL, &result);
+                    }else{
+                        hset_add(sets + k, (void *)i);
+                    }
+                }
+                if(k == 0){
+                    t0 = bench_now() - t0;
+                    before = bench_heap_bytes() - before;
+                }
+            }
+            double build = t0;
+            size_t bytes = before;
+
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                void *key = (void *)(1 + bench_rand(&seed) % (2 * n));
+                if(engine == 0){
+                    sum += _dict_lookup(dicts, key, bench_intptr_hash(key)) != NULL;
+                }else{
+                    sum += hset_contains(sets, key);
+                }
+            }
+            double contains = bench_now() - t0;
+
+            for(int32_t op = 0; op < 3; op++){
+                t0 = bench_now();
+                if(engine == 0){
+                    dict_t rop;
+                    list_t keys;
+                    dict_init(&rop, 0, bench_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+                    for(int32_t k = 0; k < (op == 0 ? 2 : 1); k++){
+                        list_init(&keys);
+                        dict_key_set(&keys, dicts + k);
+                        for(node_t *node = keys.head->next; node != keys.head;
+                            node = node->next){
+
+                            int32_t in_other = op == 0
+                                || _dict_lookup(dicts + 1, node->data,
+                                    bench_intptr_hash(node->data)) != NULL;
+                            if(op == 0 || (op == 1) == in_other){
+                                dict_add(&rop, node->data, NULL, &result);
+                            }
+                        }
+                        list_clear(&keys, 0);
+                    }
+                    sum += rop.load;
+                    dict_clear(&rop, 0);
+                }else{
+                    hset_t rop;
+                    if(op == 0){
+                        hset_union(&rop, sets, sets + 1);
+                    }else if(op == 1){
+                        hset_intersection(&rop, sets, sets + 1);
+                    }else{
+                        hset_difference(&rop, sets, sets + 1);
+                    }
+                    sum += rop.load;
+                    hset_clear(&rop, 0);
+                }
+                ms[op] = (bench_now() - t0) * 1e3;
+            }
+
+            printf("%-6s %10zu %10.1f %10.2f %12.2f %10.2f %10.2f %10.2f\n",
+                engine ? "hset" : "dict", n, (double)bytes / n, build * 1e3,
+                lookups / contains / 1e6, ms[0], ms[1], ms[2]);
+            for(int32_t k = 0; k < 2; k++){
+                if(engine == 0){
+                    dict_clear(dicts + k, 0);
+                }else{
+                    hset_clear(sets + k, 0);
+                }
+            }
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+void bench_filter(int argc, char **argv){
+    /* dict_t with and without DICTHT_FILTER, on n integer keys and on n
+     * string keys: add time, random hits, random misses, and a 20% hit
+     * mix. Also the filter's bytes per key. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 1000000;
+    size_t lookups = 5000000;
+    char **words = malloc(2 * n * sizeof(char *));
+    char buf[16];
+    bucket_t result;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < 2 * n; i++){
+        bench_alpha26(buf, i + 1);
+        words[i] = strdup(buf);
+    }
+
+    printf("%-8s %-7s %10s %10s %10s %10s %10s %12s\n", "keys", "filter", "n", "add ms",
+        "Mhits/s", "Mmisses/s", "Mmix/s", "filter B/key");
+    for(int32_t strings = 0; strings < 2; strings++){
+        for(int32_t filtered = 0; filtered < 2; filtered++){
+            dict_t dict;
+            double rates[3];
+            uint64_t seed = 42;
+            int32_t options = filtered ? DICTHT_FILTER : DICTHT_DEFAULTS;
+            if(strings){
+                dict_init(&dict, 0, oat_string_hash, bench_counting_string_eq, options);
+            }else{
+                dict_init(&dict, 0, bench_intptr_hash, bench_intptr_eq, options);
+            }
+
+            double t0 = bench_now();
+            for(size_t i = 0; i < n; i++){
+                void *key = strings ? (void *)words[i] : (void *)(i + 1);
+                dict_add(&dict, key, (void *)(i + 1), &result);
+            }
+            double add = bench_now() - t0;
+
+            /* Hits are keys 0..n-1, misses n..2n-1. */
+            for(int32_t phase = 0; phase < 3; phase++){
+                t0 = bench_now();
+                for(size_t i = 0; i < lookups; i++){
+                    uint64_t r = bench_rand(&seed);
+                    int32_t hit = phase == 0 || (phase == 2 && r % 5 == 0);
+                    size_t k = (r >> 8) % n + (hit ? 0 : n);
+                    void *key = strings ? (void *)words[k] : (void *)(k + 1);
+                    sum += (intptr_t)dict_get(&dict, key);
+                }
+                rates[phase] = lookups / (bench_now() - t0) / 1e6;
+            }
+
+            printf("%-8s %-7s %10zu %10.1f %10.2f %10.2f %10.2f %12.2f\n",
+                strings ? "string" : "integer", filtered ? "yes" : "no", n, add * 1e3,
+                rates[0], rates[1], rates[2],
+                dict.filter ? (dict.filter->mask + 1) * 8.0 / dict.load : 0.0);
+            dict_clear(&dict, 0);
+        }
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+    for(size_t i = 0; i < 2 * n; i++){
+        free(words[i]);
+    }
+    free(words);
+}
+
+int32_t bench_strcmp(const void *lhs, const void *rhs){
+    return strcmp((const char *)lhs, (const char *)rhs);
+}
+
+void bench_intern(int argc, char **argv){
+    /* n distinct keys shaped like record names, each seen four times, kept
+     * in `tables` dicts. strdup'd keys with oat_string_hash and strcmp
+     * against atoms with atom_hash and atom_eq: time to take in the stream,
+     * heap bytes per distinct key, and dict_get and rbt_get rates. Atom
+     * lookups are given atoms, as a program that interns its input would
+     * have; the intern_find column is the cost of getting one from a plain
+     * string. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 200000;
+    size_t lookups = 5000000;
+    const int32_t tables = 4;
+    char **words = malloc(n * sizeof(char *));
+    char word[16], buf[48];
+    bucket_t result;
+    rbnode_t node;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < n; i++){
+        bench_alpha26(word, i + 1);
+        snprintf(buf, sizeof(buf), "customer/%s/address", word);
+        words[i] = strdup(buf);
+    }
+
+    printf("%-7s %10s %10s %10s %10s %10s %12s\n", "keys", "n", "take ms", "bytes/key",
+        "Mget/s", "Mrbt_get/s", "Mfind/s");
+    for(int32_t atoms = 0; atoms < 2; atoms++){
+        dict_t dicts[4];
+        rbtree_t tree;
+        intern_t pool;
+        char **keys = malloc(n * sizeof(char *));
+        uint64_t seed = 42;
+        double find = 0.0;
+
+        size_t before = bench_heap_bytes();
+        double t0 = bench_now();
+        if(atoms){
+            intern_init(&pool, 0);
+        }
+        for(int32_t k = 0; k < tables; k++){
+            if(atoms){
+                dict_init(dicts + k, 0, atom_hash, atom_eq, DICTHT_DEFAULTS);
+            }else{
+                dict_init(dicts + k, 0, oat_string_hash, bench_counting_string_eq,
+                    DICTHT_DEFAULTS);
+            }
+        }
+        rbt_init(&tree, atoms ? atom_cmp : bench_strcmp);
+        for(int32_t k = 0; k < tables; k++){
+            for(size_t i = 0; i < n; i++){
+                char *key = atoms ? intern_str(&pool, words[i]) : strdup(words[i]);
+                dict_add(dicts + k, key, (void *)(i + 1), &result);
+                if(k == 0){
+                    keys[i] = key;
+                    rbt_insert(&tree, key, (void *)(i + 1), &node);
+                }
+            }
+        }
+        double take = bench_now() - t0;
+        size_t bytes = bench_heap_bytes() - before;
+
+        double rates[2];
+        for(int32_t phase = 0; phase < 2; phase++){
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                size_t k = bench_rand(&seed) % n;
+                void *key = atoms ? (void *)keys[k] : (void *)words[k];
+                sum += (intptr_t)(phase ? rbt_get(&tree, key)
+                    : dict_get(dicts + (i & (tables - 1)), key));
+            }
+            rates[phase] = lookups / (bench_now() - t0) / 1e6;
+        }
+        if(atoms){
+            t0 = bench_now();
+            for(size_t i = 0; i < lookups; i++){
+                sum += intern_find(&pool, words[bench_rand(&seed) % n]) != NULL;
+            }
+            find = lookups / (bench_now() - t0) / 1e6;
+        }
+
+        printf("%-7s %10zu %10.1f %10.1f %10.2f %10.2f %12.2f\n", atoms ? "atom" : "strdup",
+            n, take * 1e3, (double)bytes / n, rates[0], rates[1], find);
+        rbt_clear(&tree, 0);
+        for(int32_t k = 0; k < tables; k++){
+            dict_clear(dicts + k, atoms ? 0 : DICTHT_FREE_KEYS);
+        }
+        if(atoms){
+            intern_clear(&pool);
+        }
+        free(keys);
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+    for(size_t i = 0; i < n; i++){
+        free(words[i]);
+    }
+    free(words);
+}
+
+void bench_lkey(int argc, char **argv){
+    /* n string keys against n lkey_t keys, at a short and a long key length,
+     * in a dict_t and an rbtree_t: random dict_get and rbt_get hits. "lkey"
+     * sets up a fresh lkey_t on the stack for every lookup, from a length
+     * the caller already has, so it still hashes once per dict_get. "cached"
+     * looks up with the same lkey_t each time a key comes around, so its
+     * hash is only worked out once. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 200000;
+    size_t lookups = 5000000;
+    const char *prefixes[] = {"customer/", "/srv/warehouse/partitions/2024/region=eu-west/customer="};
+    char word[16], buf[96];
+    bucket_t result;
+    rbnode_t node;
+    intptr_t sum = 0;
+
+    printf("%-7s %8s %10s %10s %10s\n", "keys", "length", "n", "Mget/s", "Mrbt_get/s");
+    for(int32_t p = 0; p < 2; p++){
+        char **words = malloc(n * sizeof(char *));
+        size_t *lengths = malloc(n * sizeof(size_t));
+        lkey_t *probes = malloc(n * sizeof(lkey_t));
+        for(size_t i = 0; i < n; i++){
+            bench_alpha26(word, i + 1);
+            snprintf(buf, sizeof(buf), "%s%s/address", prefixes[p], word);
+            words[i] = strdup(buf);
+            lengths[i] = strlen(buf);
+            lkey_init(probes + i, words[i], lengths[i]);
+        }
+
+        for(int32_t kind = 0; kind < 3; kind++){
+            dict_t dict;
+            rbtree_t tree;
+            uint64_t seed = 42;
+            if(kind == 0){
+                dict_init(&dict, 0, oat_string_hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+                rbt_init(&tree, bench_strcmp);
+            }else{
+                dict_init(&dict, 0, lkey_hash, lkey_eq, DICTHT_DEFAULTS);
+                rbt_init(&tree, lkey_cmp);
+            }
+            for(size_t i = 0; i < n; i++){
+                void *key = kind == 0 ? (void *)strdup(words[i])
+                    : (void *)lkey_new(words[i], lengths[i]);
+                dict_add(&dict, key, (void *)(i + 1), &result);
+                rbt_insert(&tree, key, (void *)(i + 1), &node);
+            }
+
+            double rates[2];
+            for(int32_t phase = 0; phase < 2; phase++){
+                double t0 = bench_now();
+                for(size_t i = 0; i < lookups; i++){
+                    size_t k = bench_rand(&seed) % n;
+                    lkey_t fresh;
+                    void *key = words[k];
+                    if(kind == 1){
+                        lkey_init(&fresh, words[k], lengths[k]);
+                        key = &fresh;
+                    }else if(kind == 2){
+                        key = probes + k;
+                    }
+                    sum += (intptr_t)(phase ? rbt_get(&tree, key) : dict_get(&dict, key));
+                }
+                rates[phase] = lookups / (bench_now() - t0) / 1e6;
+            }
+            printf("%-7s %8zu %10zu %10.2f %10.2f\n",
+                kind == 0 ? "string" : kind == 1 ? "lkey" : "cached",
+                lengths[n - 1], n, rates[0], rates[1]);
+            rbt_clear(&tree, 0);
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+        }
+        for(size_t i = 0; i < n; i++){
+            free(words[i]);
+        }
+        free(words);
+        free(lengths);
+        free(probes);
+    }
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+void bench_hash64(int argc, char **argv){
+    /* GB/s of oat_hash and each hash64 variant the CPU supports, over keys
+     * of 4 bytes to 4 KB cut from a 16 KB buffer that stays in cache. Keys
+     * are hashed back to back with nothing waiting on the results, so this
+     * is throughput, not latency. */
+    size_t sizes[] = {4, 8, 16, 32, 64, 256, 1024, 4096};
+    const char *names[] = {"portable", "crc32c", "aes"};
+    size_t target = argc > 0 ? bench_sizearg(argv[0]) : 256000000;
+    uint8_t *buf = malloc(16384 + 4096);
+    uint64_t seed = 42, sum = 0;
+    for(size_t i = 0; i < 16384 + 4096; i++){
+        buf[i] = (uint8_t)bench_rand(&seed);
+    }
+
+    printf("%-9s", "GB/s");
+    for(int32_t s = 0; s < 8; s++){
+        printf(" %8zu", sizes[s]);
+    }
+    printf("\n");
+    for(int32_t variant = -1; variant < HASH64_VARIANTS; variant++){
+        if(variant >= 0 && !hash64_supported(variant)){
+            continue;
+        }
+        printf("%-9s", variant < 0 ? "oat" : names[variant]);
+        for(int32_t s = 0; s < 8; s++){
+            /* oat_hash gets an eighth of the bytes; it's that much slower. */
+            size_t count = (variant < 0 ? target / 8 : target) / sizes[s];
+            double t0 = bench_now();
+            for(size_t i = 0; i < count; i++){
+                const uint8_t *key = buf + (i * 64 & 16383);
+                if(variant < 0){
+                    sum += (uint32_t)oat_hash(key, sizes[s]);
+                }else{
+                    sum += hash64_with(variant, key, sizes[s], 0);
+                }
+            }
+            printf(" %8.2f", count * sizes[s] / (bench_now() - t0) / 1e9);
+        }
+        printf("\n");
+    }
+    printf("hash64 uses %s\n", names[hash64_variant()]);
+    if(sum == 0){
+        printf("(?)\n");
+    }
+    free(buf);
+}
+
+int32_t bench_oat_string_hash(const void *str){
+    /* oat_string_hash that dict_t can't tell is oat_string_hash, so it
+     * hashes one key at a time. */
+    return oat_string_hash(str);
+}
+
+void bench_oatmany(int argc, char **argv){
+    /* Millions of keys hashed per second by oat_hash in a loop and by the
+     * batch code at each lane count the CPU has, on fixed width keys and on
+     * two kinds of strings. Then dict_get_many and dict_build on string keys,
+     * with oat_string_hash (batched) and with a wrapper around it (not). */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 1000000;
+    size_t widths[] = {4, 8, 16, 32};
+    int32_t lane_counts[] = {1, 8, 16};
+    uint8_t *bytes = malloc(n * 32);
+    char **strs[2];
+    void **keys = malloc(n * sizeof(void *));
+    size_t *lens = malloc(n * sizeof(size_t));
+    int32_t *hashes = malloc(n * sizeof(int32_t));
+    char word[16], buf[48];
+    uint64_t seed = 42;
+    int64_t sum = 0;
+    for(size_t i = 0; i < n * 32; i++){
+        bytes[i] = (uint8_t)bench_rand(&seed);
+    }
+    for(int32_t k = 0; k < 2; k++){
+        strs[k] = malloc(n * sizeof(char *));
+        for(size_t i = 0; i < n; i++){
+            bench_alpha26(word, i + 1);
+            snprintf(buf, sizeof(buf), k ? "customer/%s/address" : "%s", word);
+            strs[k][i] = strdup(buf);
+        }
+    }
+
+    printf("%-10s %10s %10s", "Mkeys/s", "loop", "lanes=1");
+    for(int32_t c = 1; c < 3 && lane_counts[c] <= oat_lanes(); c++){
+        printf("   lanes=%-2d", lane_counts[c]);
+    }
+    printf("\n");
+    for(int32_t kind = 0; kind < 6; kind++){
+        char label[16];
+        if(kind < 4){
+            snprintf(label, sizeof(label), "%zu bytes", widths[kind]);
+            for(size_t i = 0; i < n; i++){
+                keys[i] = bytes + i * 32;
+                lens[i] = widths[kind];
+            }
+        }else{
+            snprintf(label, sizeof(label), kind == 4 ? "alpha26" : "customer");
+            for(size_t i = 0; i < n; i++){
+                keys[i] = strs[kind - 4][i];
+                lens[i] = strlen(strs[kind - 4][i]);
+            }
+        }
+        printf("%-10s", label);
+
+        double t0 = bench_now();
+        for(size_t i = 0; i < n; i++){
+            sum += oat_hash(keys[i], lens[i]);
+        }
+        printf(" %10.2f", n / (bench_now() - t0) / 1e6);
+        for(int32_t c = 0; c < 3 && lane_counts[c] <= oat_lanes(); c++){
+            t0 = bench_now();
+            _oat_hash_lanes(keys, lens, hashes, n, lane_counts[c]);
+            printf(" %10.2f", n / (bench_now() - t0) / 1e6);
+            sum += hashes[n - 1];
+        }
+        printf("\n");
+    }
+
+    /* Lookups are random hits on the customer strings; the build is of all
+     * of them, on one thread. */
+    printf("\n%-22s %12s %12s\n", "customer keys", "Mget_many/s", "build ms");
+    for(int32_t batched = 0; batched < 2; batched++){
+        dict_t dict;
+        void *values[256];
+        int32_t (*hash)(const void *) = batched ? oat_string_hash : bench_oat_string_hash;
+
+        /* Best of three builds: the heap left behind by one skews the next. */
+        double build = 0.0, t0;
+        for(int32_t rep = 0; rep < 3; rep++){
+            if(rep > 0){
+                dict_clear(&dict, 0);
+            }
+            dict_init(&dict, 0, hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+            t0 = bench_now();
+            dict_build(&dict, (void **)strs[1], (void **)strs[1], n, 1);
+            t0 = bench_now() - t0;
+            build = rep == 0 || t0 < build ? t0 : build;
+        }
+
+        size_t lookups = 5000000;
+        t0 = bench_now();
+        for(size_t i = 0; i < lookups; i += 256){
+            for(size_t j = 0; j < 256; j++){
+                keys[j] = strs[1][bench_rand(&seed) % n];
+            }
+            sum += dict_get_many(&dict, keys, values, 256);
+        }
+        printf("%-22s %12.2f %12.1f\n", batched ? "oat_string_hash" : "one at a time",
+            lookups / (bench_now() - t0) / 1e6, build * 1e3);
+        dict_clear(&dict, 0);
+    }
+
+    if(sum == 0){
+        printf("(?)\n");
+    }
+    for(int32_t k = 0; k < 2; k++){
+        for(size_t i = 0; i < n; i++){
+            free(strs[k][i]);
+        }
+        free(strs[k]);
+    }
+    free(bytes);
+    free(keys);
+    free(lens);
+    free(hashes);
+}
+
+size_t bench_pair_length(const char *pair){
+    /* A pair is two C strings back to back; this is its length with both
+     * NULs. */
+    size_t fst = strlen(pair) + 1;
+    return fst + strlen(pair + fst) + 1;
+}
+
+int32_t bench_pair_hash(const void *pair){
+    return oat_hash(pair, bench_pair_length(pair));
+}
+
+int32_t bench_pair_eq(const void *lhs, const void *rhs){
+    size_t length = bench_pair_length(lhs);
+    return length == bench_pair_length(rhs) && !memcmp(lhs, rhs, length);
+}
+
+void bench_tuple(int argc, char **argv){
+    /* dict_get on n keys made of two strings, a region and a customer.
+     * "buffer" is the old way: copy both fields into a malloc'd buffer for
+     * every lookup, and hash that. "tuple" keys the dict by tuple_t and
+     * looks up with one on the stack, using tuple_string_hash and
+     * tuple_string_eq. Both hash the same bytes. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 20000;
+    size_t lookups = 5000000;
+    const char *regions[] = {"us-east", "us-west", "eu-west", "ap-south"};
+    char **customers = malloc(n * sizeof(char *));
+    tuple_t *pairs = malloc(n * sizeof(tuple_t));
+    char word[16], buf[32];
+    bucket_t result;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < n; i++){
+        bench_alpha26(word, i + 1);
+        snprintf(buf, sizeof(buf), "customer-%s", word);
+        customers[i] = strdup(buf);
+        tuple_init(pairs + i, (void *)regions[i % 4], customers[i]);
+    }
+
+    printf("%-7s %10s %10s\n", "keys", "n", "Mget/s");
+    for(int32_t kind = 0; kind < 2; kind++){
+        dict_t dict;
+        uint64_t seed = 42;
+        if(kind == 0){
+            dict_init(&dict, 0, bench_pair_hash, bench_pair_eq, DICTHT_DEFAULTS);
+        }else{
+            dict_init(&dict, 0, tuple_string_hash, tuple_string_eq, DICTHT_DEFAULTS);
+        }
+        for(size_t i = 0; i < n; i++){
+            void *key = pairs + i;
+            if(kind == 0){
+                size_t fst = strlen(pairs[i].fst) + 1, snd = strlen(pairs[i].snd) + 1;
+                char *pair = malloc(fst + snd);
+                memcpy(pair, pairs[i].fst, fst);
+                memcpy(pair + fst, pairs[i].snd, snd);
+                key = pair;
+            }
+            dict_add(&dict, key, (void *)(i + 1), &result);
+        }
+
+        double t0 = bench_now();
+        for(size_t i = 0; i < lookups; i++){
+            size_t k = bench_rand(&seed) % n;
+            const char *region = regions[k % 4];
+            const char *customer = customers[k];
+            if(kind == 0){
+                size_t fst = strlen(region) + 1, snd = strlen(customer) + 1;
+                char *pair = malloc(fst + snd);
+                memcpy(pair, region, fst);
+                memcpy(pair + fst, customer, snd);
+                sum += (intptr_t)dict_get(&dict, pair);
+                free(pair);
+            }else{
+                tuple_t probe;
+                tuple_init(&probe, (void *)region, (void *)customer);
+                sum += (intptr_t)dict_get(&dict, &probe);
+            }
+        }
+        double rate = lookups / (bench_now() - t0) / 1e6;
+        printf("%-7s %10zu %10.2f\n", kind == 0 ? "buffer" : "tuple", n, rate);
+        dict_clear(&dict, kind == 0 ? DICTHT_FREE_KEYS : 0);
+    }
+    for(size_t i = 0; i < n; i++){
+        free(customers[i]);
+    }
+    free(customers);
+    free(pairs);
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+uint64_t bench_cycles(){
+    /* TSC ticks, which run at the base clock rather than the core's, so
+     * turbo makes cycle counts look a little better than they are. Other
+     * machines get nanoseconds. */
+#ifdef BENCH_X86
+    return __rdtsc();
+#else
+    return (uint64_t)(bench_now() * 1e9);
+#endif
+}
+
+int32_t bench_hq_word(const void *key, size_t len){
+    /* The key's first 4 bytes as an integer: the identity hash on small
+     * ints, and a bad one on strings. A baseline to show what failing
+     * looks like. */
+    uint32_t word = 0;
+    memcpy(&word, key, len < 4 ? len : 4);
+    return (int32_t)word;
+}
+
+int32_t bench_hq_fold(int32_t variant, const void *key, size_t len){
+    uint64_t h = hash64_with(variant, key, len, 0);
+    return (int32_t)(h ^ (h >> 32));
+}
+
+int32_t bench_hq_portable(const void *key, size_t len){
+    return bench_hq_fold(HASH64_PORTABLE, key, len);
+}
+
+int32_t bench_hq_crc32c(const void *key, size_t len){
+    return bench_hq_fold(HASH64_CRC32C, key, len);
+}
+
+int32_t bench_hq_aes(const void *key, size_t len){
+    return bench_hq_fold(HASH64_AES, key, len);
+}
+
+/* The hash the dict callbacks below go through. */
+int32_t (*bench_hq_fn)(const void *, size_t) = oat_hash;
+
+int32_t bench_hq_intptr_hash(const void *key){
+    intptr_t k = (intptr_t)key;
+    return bench_hq_fn(&k, sizeof(k));
+}
+
+int32_t bench_hq_string_hash(const void *str){
+    return bench_hq_fn(str, strlen((const char *)str));
+}
+
+void bench_hq_avalanche(int32_t (*fn)(const void *, size_t), size_t len, size_t trials,
+                double *mean, double *worst){
+    /* Flips each input bit of random keys and counts how often each output
+     * bit flips with it. Ideally every one is a coin toss. mean is the
+     * fraction of output bits flipped overall, worst the largest distance
+     * from 1/2 of any input and output bit pair. With 10000 trials, chance
+     * alone gives a worst of about 0.02 to 0.03. */
+    uint8_t key[64];
+    uint32_t *counts = calloc(len * 8 * 32, sizeof(uint32_t));
+    uint64_t seed = 7, flips = 0;
+    for(size_t t = 0; t < trials; t++){
+        for(size_t b = 0; b < len; b++){
+            key[b] = (uint8_t)bench_rand(&seed);
+        }
+        uint32_t h = (uint32_t)fn(key, len);
+        for(size_t i = 0; i < len * 8; i++){
+            key[i / 8] ^= 1 << (i % 8);
+            uint32_t diff = h ^ (uint32_t)fn(key, len);
+            key[i / 8] ^= 1 << (i % 8);
+            flips += __builtin_popcount(diff);
+            for(; diff; diff &= diff - 1){
+                counts[i * 32 + __builtin_ctz(diff)]++;
+            }
+        }
+    }
+    *mean = (double)flips / ((double)trials * len * 8 * 32);
+    *worst = 0.0;
+    for(size_t c = 0; c < len * 8 * 32; c++){
+        double bias = fabs((double)counts[c] / trials - 0.5);
+        *worst = bias > *worst ? bias : *worst;
+    }
+    free(counts);
+}
+
+double bench_hq_independence(int32_t (*fn)(const void *, size_t), size_t len, size_t trials){
+    /* Bit independence: for each input bit, the correlation between the
+     * flips of every pair of output bits. Returns the largest, in absolute
+     * value. An output bit that never or always flips counts as 1. With
+     * 10000 trials, chance alone gives about 0.05. */
+    uint8_t key[64];
+    uint32_t ones[32];
+    uint32_t *both = malloc(32 * 32 * sizeof(uint32_t));
+    uint64_t seed = 11;
+    double worst = 0.0;
+    for(size_t i = 0; i < len * 8; i++){
+        memset(ones, 0, sizeof(ones));
+        memset(both, 0, 32 * 32 * sizeof(uint32_t));
+        for(size_t t = 0; t < trials; t++){
+            for(size_t b = 0; b < len; b++){
+                key[b] = (uint8_t)bench_rand(&seed);
+            }
+            uint32_t h = (uint32_t)fn(key, len);
+            key[i / 8] ^= 1 << (i % 8);
+            uint32_t diff = h ^ (uint32_t)fn(key, len);
+            for(uint32_t d = diff; d; d &= d - 1){
+                int32_t j = __builtin_ctz(d);
+                ones[j]++;
+                for(uint32_t e = d & (d - 1); e; e &= e - 1){
+                    both[j * 32 + __builtin_ctz(e)]++;
+                }
+            }
+        }
+        for(int32_t j = 0; j < 32; j++){
+            for(int32_t k = j + 1; k < 32; k++){
+                double pj = (double)ones[j] / trials, pk = (double)ones[k] / trials;
+                double var = pj * (1 - pj) * pk * (1 - pk);
+                double corr = var > 0 ? fabs((double)both[j * 32 + k] / trials - pj * pk) / sqrt(var) : 1.0;
+                worst = corr > worst ? corr : worst;
+            }
+        }
+    }
+    free(both);
+    return worst;
+}
+
+void bench_hq_chains(const char *name, dict_t *dict, size_t n){
+    /* How the keys in dict's table spread over its slots, next to what a
+     * random function gives at the same load: the share of empty slots, the
+     * longest chain, and the average number of buckets looked at to find a
+     * key that's there. */
+    size_t empty = 0, longest = 0, probes = 0;
+    for(size_t i = 0; i < dict->length; i++){
+        size_t chain = 0;
+        for(bucket_t *b = dict->table[i]; b != NULL; b = b->next){
+            chain++;
+        }
+        empty += chain == 0;
+        longest = chain > longest ? chain : longest;
+        probes += chain * (chain + 1) / 2;
+    }
+    double load = (double)n / dict->length;
+    printf(" %-9s %6.3f %7.2f%% %7.2f%% %7zu %8.3f %8.3f\n", name, load,
+        100.0 * empty / dict->length, 100.0 * exp(-load), longest,
+        (double)probes / n, 1 + load / 2);
+}
+
+void bench_hashq(int argc, char **argv){
+    /* What each hash costs and how well it mixes. bytes/cycle at a range of
+     * key lengths; avalanche and bit independence on 4, 8 and 32 byte
+     * random keys; then chain lengths in real dict_t tables, indexed with
+     * MOD as by default, filled with n sequential ints, alpha26 strings and
+     * random 64 bit keys. "word" is a deliberately weak baseline. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 1000000;
+    size_t trials = 10000;
+    struct {
+        const char *name;
+        int32_t (*fn)(const void *, size_t);
+        int32_t supported;
+    } hashes[] = {
+        {"oat", oat_hash, 1},
+        {"word", bench_hq_word, 1},
+        {"portable", bench_hq_portable, hash64_supported(HASH64_PORTABLE)},
+        {"crc32c", bench_hq_crc32c, hash64_supported(HASH64_CRC32C)},
+        {"aes", bench_hq_aes, hash64_supported(HASH64_AES)}
+    };
+    const int32_t HASHES = sizeof(hashes) / sizeof(hashes[0]);
+    size_t lengths[] = {4, 8, 16, 32, 64, 256, 1024};
+    size_t avalanche_lengths[] = {4, 8, 32};
+    uint8_t *buf = malloc(1024 + 64);
+    uint64_t seed = 42;
+    int64_t sum = 0;
+    for(size_t i = 0; i < 1024 + 64; i++){
+        buf[i] = (uint8_t)bench_rand(&seed);
+    }
+
+#ifdef BENCH_X86
+    printf("bytes/cycle (TSC)\n%-9s", "hash");
+#else
+    printf("bytes/ns\n%-9s", "hash");
+#endif
+    for(int32_t l = 0; l < 7; l++){
+        printf(" %7zu", lengths[l]);
+    }
+    printf("\n");
+    for(int32_t h = 0; h < HASHES; h++){
+        if(!hashes[h].supported){
+            continue;
+        }
+        printf("%-9s", hashes[h].name);
+        for(int32_t l = 0; l < 7; l++){
+            size_t reps = (64 << 20) / (lengths[l] + 16);
+            uint64_t c0 = bench_cycles();
+            for(size_t r = 0; r < reps; r++){
+                sum += hashes[h].fn(buf + (r & 63), lengths[l]);
+            }
+            printf(" %7.3f", (double)reps * lengths[l] / (bench_cycles() - c0));
+        }
+        printf("\n");
+    }
+
+    printf("\n%-9s %6s %9s %9s %9s\n", "hash", "bytes", "flipped", "worst", "bic");
+    for(int32_t h = 0; h < HASHES; h++){
+        if(!hashes[h].supported){
+            continue;
+        }
+        for(int32_t l = 0; l < 3; l++){
+            double mean, worst;
+            bench_hq_avalanche(hashes[h].fn, avalanche_lengths[l], trials, &mean, &worst);
+            double bic = bench_hq_independence(hashes[h].fn, avalanche_lengths[l], trials);
+            printf("%-9s %6zu %9.4f %9.4f %9.4f\n", hashes[h].name,
+                avalanche_lengths[l], mean, worst, bic);
+        }
+    }
+
+    char **words = malloc(n * sizeof(char *));
+    char word[16];
+    for(size_t i = 0; i < n; i++){
+        bench_alpha26(word, i + 1);
+        words[i] = strdup(word);
+    }
+    printf("\n%-9s %-9s %6s %8s %8s %7s %8s %8s\n", "hash", "keys", "load",
+        "empty", "random", "longest", "probes", "random");
+    for(int32_t h = 0; h < HASHES; h++){
+        if(!hashes[h].supported){
+            continue;
+        }
+        bench_hq_fn = hashes[h].fn;
+        for(int32_t kind = 0; kind < 3; kind++){
+            dict_t dict;
+            bucket_t result;
+            uint64_t key_seed = 99;
+            if(kind == 1){
+                dict_init(&dict, 0, bench_hq_string_hash, bench_counting_string_eq, DICTHT_DEFAULTS);
+            }else{
+                dict_init(&dict, 0, bench_hq_intptr_hash, bench_intptr_eq, DICTHT_DEFAULTS);
+            }
+            for(size_t i = 0; i < n; i++){
+                void *key = kind == 0 ? (void *)(intptr_t)(i + 1)
+                    : kind == 1 ? (void *)words[i]
+                    : (void *)(intptr_t)(bench_rand(&key_seed) | 1);
+                dict_add(&dict, key, NULL, &result);
+            }
+            printf("%-9s", hashes[h].name);
+            bench_hq_chains(kind == 0 ? "ints" : kind == 1 ? "alpha26" : "random", &dict, dict.load);
+            dict_clear(&dict, 0);
+        }
+    }
+    for(size_t i = 0; i < n; i++){
+        free(words[i]);
+    }
+    free(words);
+    free(buf);
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+void bench_rbtree(int argc, char **argv){
+    /* Millions of rbt_insert and rbt_remove calls per second, with n random
+     * keys inserted and then all removed in another random order, the
+     * seconds to rbt_clear a tree of n, and heap bytes per node, malloc's
+     * overhead included. */
+    size_t n = argc > 0 ? bench_sizearg(argv[0]) : 10000000;
+    intptr_t *keys = malloc(n * sizeof(intptr_t));
+    intptr_t *order = malloc(n * sizeof(intptr_t));
+    uint64_t seed = 42;
+    rbnode_t result;
+    rbtree_t tree;
+    intptr_t sum = 0;
+    for(size_t i = 0; i < n; i++){
+        keys[i] = order[i] = (intptr_t)(bench_rand(&seed) >> 2);
+    }
+    for(size_t i = n - 1; i > 0; i--){
+        size_t j = bench_rand(&seed) % (i + 1);
+        intptr_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    rbt_init(&tree, bench_intptr_cmp);
+
+    size_t before = bench_heap_bytes();
+    double t0 = bench_now();
+    for(size_t i = 0; i < n; i++){
+        rbt_insert(&tree, (void *)keys[i], (void *)keys[i], &result);
+    }
+    double ins = n / (bench_now() - t0) / 1e6;
+    double per_node = (double)(bench_heap_bytes() - before) / tree.size;
+
+    t0 = bench_now();
+    for(size_t i = 0; i < n; i++){
+        sum += (intptr_t)rbt_remove(&tree, (void *)order[i], &result);
+    }
+    double rem = n / (bench_now() - t0) / 1e6;
+
+    for(size_t i = 0; i < n; i++){
+        rbt_insert(&tree, (void *)keys[i], (void *)keys[i], &result);
+    }
+    t0 = bench_now();
+    rbt_clear(&tree, 0);
+    double clear = bench_now() - t0;
+
+    printf("%10s %10s %10s %10s %10s %10s\n", "n", "node", "bytes/node", "Mins/s", "Mrem/s", "clear s");
+    printf("%10zu %10zu %10.1f %10.2f %10.2f %10.3f\n", n, sizeof(rbnode_t), per_node,
+        ins, rem, clear);
+    free(keys);
+    free(order);
+    if(sum == 0){
+        printf("(?)\n");
+    }
+}
+
+int main(int argc, char **argv){
+    struct {
+        const char *name;
+        void (*run)(int, char **);
+    } BENCHES[] = {
+        {"oadict", bench_oadict},
+        {"rehash", bench_rehash},
+        {"strkeys", bench_strkeys},
+        {"tdict", bench_tdict},
+        {"getmany", bench_getmany},
+        {"treeify", bench_treeify},
+        {"pow2", bench_pow2},
+        {"cdict", bench_cdict},
+        {"small", bench_small},
+        {"odict", bench_odict},
+        {"upsert", bench_upsert},
+        {"snapshot", bench_snapshot},
+        {"build", bench_build},
+        {"scan", bench_scan},
+        {"freeze", bench_freeze},
+        {"hset", bench_hset},
+        {"filter", bench_filter},
+        {"intern", bench_intern},
+        {"lkey", bench_lkey},
+        {"hash64", bench_hash64},
+        {"oatmany", bench_oatmany},
+        {"tuple", bench_tuple},
+        {"hashq", bench_hashq},
+        {"rbtree", bench_rbtree}
+    };
+    const int32_t BENCH_LENGTH = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+    for(int32_t i = 0; argc > 1 && i < BENCH_LENGTH; i++){
+        if(!strcmp(argv[1], BENCHES[i].name)){
+            BENCHES[i].run(argc - 2, argv + 2);
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "usage: %s BENCHMARK [SIZE...]\nbenchmarks:", argv[0]);
+    for(int32_t i = 0; i < BENCH_LENGTH; i++){
+        fprintf(stderr, " %s", BENCHES[i].name);
+    }
+    fprintf(stderr, "\n");
+    return 1;
+}
@@ -0,0 +1,205 @@
+/* kmdata Data Structures Library
+ * Benchmark program. */
+
+#ifndef KMDATA_BENCH_H
+#define KMDATA_BENCH_H
+
+#include<stdio.h>
+#include<stdlib.h>
+#include<stdint.h>
+#include<string.h>
+#include<time.h>
+#include<pthread.h>
+#include<malloc.h>
+#include<math.h>
+#include<fcntl.h>
+#include<unistd.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BENCH_X86
+#include<x86intrin.h>
+#endif
+
+#include "cdict.h"
+#include "dict.h"
+#include "dsnap.h"
+#include "fdict.h"
+#include "hash64.h"
+#include "hset.h"
+#include "intern.h"
+#include "lkey.h"
+#include "oadict.h"
+#include "odict.h"
+#include "oat.h"
+#include "tdict.h"
+
+/* Common dict interface so one driver can time every engine. */
+typedef struct {
+    const char *name;
+    void *(*create)(size_t size);
+    void (*add)(void *dict, void *key, void *data);
+    void *(*get)(void *dict, void *key);
+    void *(*remove)(void *dict, void *key);
+    void (*destroy)(void *dict);
+} bench_engine_t;
+
+double bench_now();
+
+uint64_t bench_rand(uint64_t *state);
+
+size_t bench_sizearg(const char *arg);
+
+int32_t bench_intptr_hash(const void *key);
+
+int32_t bench_intptr_eq(const void *lhs, const void *rhs);
+
+void bench_engine_run(bench_engine_t *engine, size_t n, size_t lookups);
+
+void *bench_dict_create(size_t size);
+
+void bench_dict_add(void *dict, void *key, void *data);
+
+void *bench_dict_get(void *dict, void *key);
+
+void *bench_dict_remove(void *dict, void *key);
+
+void bench_dict_destroy(void *dict);
+
+void *bench_oadict_create(size_t size);
+
+void bench_oadict_add(void *dict, void *key, void *data);
+
+void *bench_oadict_get(void *dict, void *key);
+
+void *bench_oadict_remove(void *dict, void *key);
+
+void bench_oadict_destroy(void *dict);
+
+void bench_oadict(int argc, char **argv);
+
+int bench_u32cmp(const void *lhs, const void *rhs);
+
+void bench_latency_run(const char *name, int32_t options, size_t n);
+
+void bench_rehash(int argc, char **argv);
+
+void bench_alpha26(char *buf, intptr_t n);
+
+int32_t bench_counting_string_hash(const void *str);
+
+int32_t bench_counting_string_eq(const void *lhs, const void *rhs);
+
+void bench_strkeys(int argc, char **argv);
+
+void *bench_intdict_create(size_t size);
+
+void bench_intdict_add(void *dict, void *key, void *data);
+
+void *bench_intdict_get(void *dict, void *key);
+
+void *bench_intdict_remove(void *dict, void *key);
+
+void bench_intdict_destroy(void *dict);
+
+void *bench_oatdict_create(size_t size);
+
+void bench_oatdict_add(void *dict, void *key, void *data);
+
+void *bench_oatdict_get(void *dict, void *key);
+
+void *bench_oatdict_remove(void *dict, void *key);
+
+void bench_oatdict_destroy(void *dict);
+
+void bench_tdict(int argc, char **argv);
+
+void bench_getmany(int argc, char **argv);
+
+int32_t bench_weak_intptr_hash(const void *key);
+
+int32_t bench_intptr_cmp(const void *lhs, const void *rhs);
+
+void bench_treeify(int argc, char **argv);
+
+int32_t bench_identity_hash(const void *key);
+
+void bench_pow2(int argc, char **argv);
+
+void *bench_cdict_worker(void *arg);
+
+void *bench_locked_worker(void *arg);
+
+void bench_cdict(int argc, char **argv);
+
+size_t bench_heap_bytes();
+
+void bench_small(int argc, char **argv);
+
+void bench_odict(int argc, char **argv);
+
+void bench_upsert(int argc, char **argv);
+
+void bench_drop_cache(const char *path);
+
+void bench_snapshot(int argc, char **argv);
+
+void bench_build(int argc, char **argv);
+
+void bench_sum_values(void *key, void *data, void *acc);
+
+void bench_scan(int argc, char **argv);
+
+void bench_freeze(int argc, char **argv);
+
+void bench_hset(int argc, char **argv);
+
+void bench_filter(int argc, char **argv);
+
+int32_t bench_strcmp(const void *lhs, const void *rhs);
+
+void bench_intern(int argc, char **argv);
+
+void bench_lkey(int argc, char **argv);
+
+void bench_hash64(int argc, char **argv);
+
+int32_t bench_oat_string_hash(const void *str);
+
+void bench_oatmany(int argc, char **argv);
+
+size_t bench_pair_length(const char *pair);
+
+int32_t bench_pair_hash(const void *pair);
+
+int32_t bench_pair_eq(const void *lhs, const void *rhs);
+
+void bench_tuple(int argc, char **argv);
+
+uint64_t bench_cycles();
+
+int32_t bench_hq_word(const void *key, size_t len);
+
+int32_t bench_hq_fold(int32_t variant, const void *key, size_t len);
+
+int32_t bench_hq_portable(const void *key, size_t len);
+
+int32_t bench_hq_crc32c(const void *key, size_t len);
+
+int32_t bench_hq_aes(const void *key, size_t len);
+
+int32_t bench_hq_intptr_hash(const void *key);
+
+int32_t bench_hq_string_hash(const void *str);
+
+void bench_hq_avalanche(int32_t (*fn)(const void *, size_t), size_t len, size_t trials,
+                double *mean, double *worst);
+
+double bench_hq_independence(int32_t (*fn)(const void *, size_t), size_t len, size_t trials);
+
+void bench_hq_chains(const char *name, dict_t *dict, size_t n);
+
+void bench_hashq(int argc, char **argv);
+
+void bench_rbtree(int argc, char **argv);
+
+#endif
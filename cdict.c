@@ -0,0 +1,372 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Concurrent dict with lock-free readers and lock striped writers. */
+
+#include<sched.h>
+
+#include "cdict.h"
+
+/* Threads get reader counters round robin, the first time they read. */
+static __thread int32_t _cdict_reader_id = -1;
+static int32_t _cdict_next_reader = 0;
+
+cdreader_t *_cdict_reader(cdict_t *dict){
+    if(_cdict_reader_id < 0){
+        _cdict_reader_id = __atomic_fetch_add(&_cdict_next_reader, 1, __ATOMIC_RELAXED)
+                            % CDICT_READERS;
+    }
+    return dict->readers + _cdict_reader_id;
+}
+
+uint64_t _cdict_read_lock(cdict_t *dict, cdreader_t *reader){
+    /* Count ourselves in under the current epoch. If the epoch moved on
+     * before the count landed, cdict_synchronize might not have seen it, so
+     * back out and try again under the new one. */
+    for(;;){
+        uint64_t epoch = __atomic_load_n(&dict->epoch, __ATOMIC_SEQ_CST);
+        __atomic_fetch_add(&reader->count[epoch & 1], 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&dict->epoch, __ATOMIC_SEQ_CST) == epoch){
+            return epoch;
+        }
+        __atomic_fetch_sub(&reader->count[epoch & 1], 1, __ATOMIC_RELEASE);
+    }
+}
+
+cdtable_t *_cdict_table_new(size_t length){
+    cdtable_t *table = malloc(sizeof(cdtable_t));
+    if(table == NULL){
+        return NULL;
+    }
+    table->slots = calloc(length, sizeof(bucket_t *));
+    if(table->slots == NULL){
+        free(table);
+        return NULL;
+    }
+    table->length = length;
+    return table;
+}
+
+void cdict_init(cdict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options){
+    size_t length = CDICT_MINIMUM_SIZE;
+    while(length < size){
+        length <<= 1;
+    }
+
+    dict->table = _cdict_table_new(length);
+    if(dict->table == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return;
+    }
+
+    dict->hash = hash;
+    dict->eq = eq;
+    dict->flags = options;
+    dict->epoch = 0;
+    for(int32_t i = 0; i < CDICT_STRIPES; i++){
+        pthread_mutex_init(&dict->stripes[i].lock, NULL);
+        dict->stripes[i].load = 0;
+    }
+    for(int32_t i = 0; i < CDICT_READERS; i++){
+        dict->readers[i].count[0] = 0;
+        dict->readers[i].count[1] = 0;
+    }
+    pthread_mutex_init(&dict->resize_lock, NULL);
+    pthread_mutex_init(&dict->grace_lock, NULL);
+    pthread_mutex_init(&dict->retire_lock, NULL);
+    dict->retired = NULL;
+    dict->retired_count = 0;
+    dict->retired_size = 0;
+}
+
+void *cdict_get(cdict_t *dict, void *key){
+    int32_t hash = dict->hash(key);
+    uint32_t mixed = km_mix32((uint32_t)hash);
+    void *ret = NULL;
+
+    cdreader_t *reader = _cdict_reader(dict);
+    uint64_t epoch = _cdict_read_lock(dict, reader);
+
+    cdtable_t *table = __atomic_load_n(&dict->table, __ATOMIC_ACQUIRE);
+    bucket_t *bucket = __atomic_load_n(table->slots + (mixed & (table->length - 1)),
+                            __ATOMIC_ACQUIRE);
+    while(bucket != NULL){
+        if(bucket->hash == hash && dict->eq(key, bucket->key)){
+            ret = bucket->data;
+            break;
+        }
+        bucket = __atomic_load_n(&bucket->next, __ATOMIC_ACQUIRE);
+    }
+
+    __atomic_fetch_sub(&reader->count[epoch & 1], 1, __ATOMIC_RELEASE);
+    return ret;
+}
+
+int32_t cdict_add(cdict_t *dict, void *key, void *data, bucket_t *result){
+    int32_t hash = dict->hash(key);
+    uint32_t mixed = km_mix32((uint32_t)hash);
+    cdstripe_t *stripe = dict->stripes + (mixed & (CDICT_STRIPES - 1));
+
+    /* Readers may be on the old bucket, so even an overwrite needs a new
+     * one. Get it before taking the lock. */
+    bucket_t *new_bucket = malloc(sizeof(bucket_t));
+    if(!new_bucket){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        result->key = NULL;
+        return -1;
+    }
+    new_bucket->data = data;
+    new_bucket->key = key;
+    new_bucket->hash = hash;
+
+    pthread_mutex_lock(&stripe->lock);
+    /* Resizes hold every stripe, so the table can't change under us now. */
+    cdtable_t *table = dict->table;
+    size_t length = table->length;
+    bucket_t **head = table->slots + (mixed & (length - 1));
+    bucket_t **link = head;
+    bucket_t *bucket;
+    while((bucket = *link) != NULL){
+        if(bucket->hash == hash && dict->eq(key, bucket->key)){
+            break;
+        }
+        link = &bucket->next;
+    }
+
+    int32_t load = 0;
+    if(bucket != NULL){
+        result->key = bucket->key;
+        result->data = bucket->data;
+        new_bucket->next = bucket->next;
+        __atomic_store_n(link, new_bucket, __ATOMIC_RELEASE);
+    }else{
+        result->key = key;
+        result->data = data;
+        new_bucket->next = *head;
+        __atomic_store_n(head, new_bucket, __ATOMIC_RELEASE);
+        load = stripe->load = stripe->load + 1;
+    }
+    pthread_mutex_unlock(&stripe->lock);
+
+    if(bucket != NULL){
+        _cdict_retire(dict, bucket, CDICT_RETIRE_BUCKET);
+    }else if(((double)load) * CDICT_STRIPES / length > DICTHT_MAX_LOAD
+        && !(dict->flags & DICTHT_NO_GROW)
+        && ((double)cdict_load(dict)) / length > DICTHT_MAX_LOAD){
+        _cdict_resize(dict, length, length * DICTHT_GROW_FACTOR);
+    }
+    return hash;
+}
+
+void *cdict_remove(cdict_t *dict, void *key, bucket_t *result){
+    int32_t hash = dict->hash(key);
+    uint32_t mixed = km_mix32((uint32_t)hash);
+    cdstripe_t *stripe = dict->stripes + (mixed & (CDICT_STRIPES - 1));
+
+    /* Assume no match is found initially */
+    result->key = NULL;
+    result->data = NULL;
+
+    pthread_mutex_lock(&stripe->lock);
+    cdtable_t *table = dict->table;
+    size_t length = table->length;
+    bucket_t **link = table->slots + (mixed & (length - 1));
+    bucket_t *bucket;
+    while((bucket = *link) != NULL){
+        if(bucket->hash == hash && dict->eq(key, bucket->key)){
+            break;
+        }
+        link = &bucket->next;
+    }
+
+    if(bucket == NULL){
+        pthread_mutex_unlock(&stripe->lock);
+        return NULL; /* no match found */
+    }
+
+    /* Readers standing on bucket can still follow its next pointer. */
+    __atomic_store_n(link, bucket->next, __ATOMIC_RELEASE);
+    int32_t load = stripe->load = stripe->load - 1;
+    pthread_mutex_unlock(&stripe->lock);
+
+    void *ret = bucket->data;
+    result->key = bucket->key;
+    result->data = ret;
+    _cdict_retire(dict, bucket, CDICT_RETIRE_BUCKET);
+
+    if(((double)load) * CDICT_STRIPES / length < CDICT_SHRINK_LOAD
+        && !(dict->flags & DICTHT_NO_SHRINK) && length > CDICT_MINIMUM_SIZE
+        && ((double)cdict_load(dict)) / length < CDICT_SHRINK_LOAD){
+        _cdict_resize(dict, length, length / DICTHT_GROW_FACTOR);
+    }
+    return ret;
+}
+
+int32_t cdict_load(cdict_t *dict){
+    int32_t load = 0;
+    for(int32_t i = 0; i < CDICT_STRIPES; i++){
+        load += __atomic_load_n(&dict->stripes[i].load, __ATOMIC_RELAXED);
+    }
+    return load;
+}
+
+void _cdict_resize(cdict_t *dict, size_t old_length, size_t new_size){
+    pthread_mutex_lock(&dict->resize_lock);
+    cdtable_t *old_table = dict->table;
+    if(old_table->length != old_length){
+        /* Somebody else got here first. */
+        pthread_mutex_unlock(&dict->resize_lock);
+        return;
+    }
+
+    for(int32_t i = 0; i < CDICT_STRIPES; i++){
+        pthread_mutex_lock(&dict->stripes[i].lock);
+    }
+
+    /* Readers are still walking the old table, so its buckets can't be
+     * relinked. Copy them instead. */
+    cdtable_t *new_table = _cdict_table_new(new_size);
+    int32_t failed = new_table == NULL;
+    for(size_t i = 0; !failed && i < old_length; i++){
+        for(bucket_t *bucket = old_table->slots[i]; bucket != NULL; bucket = bucket->next){
+            bucket_t *copy = malloc(sizeof(bucket_t));
+            if(copy == NULL){
+                failed = 1;
+                break;
+            }
+            *copy = *bucket;
+            bucket_t **slot = new_table->slots
+                                + (km_mix32((uint32_t)bucket->hash) & (new_size - 1));
+            copy->next = *slot;
+            *slot = copy;
+        }
+    }
+
+    if(failed){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        if(new_table != NULL){
+            _cdict_free_retired(&(cdretired_t){new_table, CDICT_RETIRE_TABLE}, 1);
+        }
+    }else{
+        __atomic_store_n(&dict->table, new_table, __ATOMIC_RELEASE);
+    }
+
+    for(int32_t i = CDICT_STRIPES - 1; i >= 0; i--){
+        pthread_mutex_unlock(&dict->stripes[i].lock);
+    }
+    pthread_mutex_unlock(&dict->resize_lock);
+
+    if(!failed){
+        _cdict_retire(dict, old_table, CDICT_RETIRE_TABLE);
+    }
+}
+
+void cdict_synchronize(cdict_t *dict){
+    /* Move readers over to the other counter of each pair, then wait for
+     * the ones still counted under the old epoch to leave. */
+    pthread_mutex_lock(&dict->grace_lock);
+    uint64_t epoch = __atomic_load_n(&dict->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&dict->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+    for(int32_t i = 0; i < CDICT_READERS; i++){
+        while(__atomic_load_n(&dict->readers[i].count[epoch & 1], __ATOMIC_ACQUIRE) != 0){
+            sched_yield();
+        }
+    }
+    pthread_mutex_unlock(&dict->grace_lock);
+}
+
+void _cdict_free_retired(cdretired_t *retired, size_t count){
+    for(size_t i = 0; i < count; i++){
+        if(retired[i].kind == CDICT_RETIRE_TABLE){
+            cdtable_t *table = (cdtable_t *)retired[i].ptr;
+            for(size_t j = 0; j < table->length; j++){
+                bucket_t *bucket = table->slots[j];
+                bucket_t *next_bucket;
+                while(bucket != NULL){
+                    next_bucket = bucket->next;
+                    free(bucket);
+                    bucket = next_bucket;
+                }
+            }
+            free(table->slots);
+        }
+        free(retired[i].ptr);
+    }
+}
+
+void _cdict_retire(cdict_t *dict, void *ptr, int32_t kind){
+    /* Batch retired memory up, so the wait for a grace period is paid once
+     * per CDICT_RETIRE_BATCH writes. */
+    cdretired_t *batch = NULL;
+    size_t count = 0;
+
+    pthread_mutex_lock(&dict->retire_lock);
+    if(dict->retired_count == dict->retired_size){
+        size_t new_size = dict->retired_size ? dict->retired_size * 2 : CDICT_RETIRE_BATCH;
+        cdretired_t *retired = realloc(dict->retired, new_size * sizeof(cdretired_t));
+        if(retired == NULL){
+            pthread_mutex_unlock(&dict->retire_lock);
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            /* Nowhere to put it. Wait it out here instead. */
+            cdict_synchronize(dict);
+            _cdict_free_retired(&(cdretired_t){ptr, kind}, 1);
+            return;
+        }
+        dict->retired = retired;
+        dict->retired_size = new_size;
+    }
+    dict->retired[dict->retired_count].ptr = ptr;
+    dict->retired[dict->retired_count].kind = kind;
+    dict->retired_count = dict->retired_count + 1;
+
+    if(dict->retired_count >= CDICT_RETIRE_BATCH){
+        batch = dict->retired;
+        count = dict->retired_count;
+        dict->retired = NULL;
+        dict->retired_count = 0;
+        dict->retired_size = 0;
+    }
+    pthread_mutex_unlock(&dict->retire_lock);
+
+    if(batch != NULL){
+        cdict_synchronize(dict);
+        _cdict_free_retired(batch, count);
+        free(batch);
+    }
+}
+
+void cdict_clear(cdict_t *dict, int32_t options){
+    int32_t free_keys = options & DICTHT_FREE_KEYS;
+    int32_t free_values = options & DICTHT_FREE_VALUES;
+
+    cdtable_t *table = dict->table;
+    if(free_keys || free_values){
+        for(size_t i = 0; i < table->length; i++){
+            for(bucket_t *bucket = table->slots[i]; bucket != NULL; bucket = bucket->next){
+                if(free_keys){
+                    free(bucket->key);
+                }
+                if(free_values){
+                    free(bucket->data);
+                }
+            }
+        }
+    }
+    _cdict_free_retired(&(cdretired_t){table, CDICT_RETIRE_TABLE}, 1);
+    _cdict_free_retired(dict->retired, dict->retired_count);
+    free(dict->retired);
+
+    for(int32_t i = 0; i < CDICT_STRIPES; i++){
+        pthread_mutex_destroy(&dict->stripes[i].lock);
+        dict->stripes[i].load = 0;
+    }
+    pthread_mutex_destroy(&dict->resize_lock);
+    pthread_mutex_destroy(&dict->grace_lock);
+    pthread_mutex_destroy(&dict->retire_lock);
+    dict->table = NULL;
+    dict->retired = NULL;
+    dict->retired_count = 0;
+    dict->retired_size = 0;
+    dict->hash = NULL;
+    dict->eq = NULL;
+}
@@ -0,0 +1,133 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Concurrent dict with lock-free readers and lock striped writers.
+ *
+ * cdict_t can be shared by any number of threads without outside locking.
+ * cdict_get never takes a lock: it announces itself in a per-thread reader
+ * counter, walks the chain, and leaves. Writers lock one of CDICT_STRIPES
+ * mutexes picked by the key's hash, so writers to different stripes don't
+ * wait on each other. Table lengths are powers of two and never smaller
+ * than CDICT_STRIPES, so a slot always belongs to the same stripe.
+ *
+ * Buckets are never changed once readers can see them, except for their
+ * next pointers. An overwrite links in a new bucket in place of the old one,
+ * and a resize copies every bucket into the new table before publishing it.
+ * Unlinked buckets and old tables are retired, and only freed after a grace
+ * period: once every reader that might still be looking at them is done.
+ *
+ * Keys and values themselves are the caller's. If other threads could still
+ * be reading a key or value that cdict_remove handed back, call
+ * cdict_synchronize before freeing it.
+ */
+
+#ifndef KMDATA_CDICT_H
+#define KMDATA_CDICT_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
+
+#include "dict.h"
+
+/* Constants for internal use. */
+#define CDICT_STRIPES       64
+#define CDICT_READERS       64
+#define CDICT_MINIMUM_SIZE  1024
+#define CDICT_RETIRE_BATCH  1024
+#define CDICT_LINE_SIZE     64
+
+/* Writers guess the load from their own stripe's count times CDICT_STRIPES,
+ * which is cheap but, with only a few keys a stripe, far off. A guess past
+ * a threshold is checked against cdict_load before anything is resized.
+ * Resizes copy every bucket with all the stripes locked, so the shrink
+ * threshold sits well below DICTHT_MIN_LOAD: a table that just grew is 3/8
+ * full, one that just shrank 1/4, and both are a long way from the next
+ * resize. */
+#define CDICT_SHRINK_LOAD   (DICTHT_MIN_LOAD / 2)
+
+#define CDICT_RETIRE_BUCKET 0
+#define CDICT_RETIRE_TABLE  1
+
+/* Each stripe and reader counter gets its own cache line. */
+typedef struct {
+    pthread_mutex_t lock;
+    int32_t load;
+    char pad[CDICT_LINE_SIZE - (sizeof(pthread_mutex_t) + sizeof(int32_t)) % CDICT_LINE_SIZE];
+} cdstripe_t;
+
+typedef struct {
+    int64_t count[2];
+    char pad[CDICT_LINE_SIZE - 2 * sizeof(int64_t)];
+} cdreader_t;
+
+typedef struct {
+    bucket_t **slots;
+    size_t length;
+} cdtable_t;
+
+typedef struct {
+    void *ptr;
+    int32_t kind;
+} cdretired_t;
+
+typedef struct {
+    cdtable_t *table;
+    int32_t (*hash)(const void *);
+    int32_t (*eq)(const void *, const void *);
+    int32_t flags;
+    uint64_t epoch;
+    cdstripe_t stripes[CDICT_STRIPES];
+    cdreader_t readers[CDICT_READERS];
+    pthread_mutex_t resize_lock;
+    pthread_mutex_t grace_lock;
+    pthread_mutex_t retire_lock;
+    cdretired_t *retired;
+    size_t retired_count;
+    size_t retired_size;
+} cdict_t;
+
+/* PRIVATE FUNCTIONS */
+cdtable_t *_cdict_table_new(size_t length);
+
+void _cdict_resize(cdict_t *dict, size_t old_length, size_t new_size);
+
+void _cdict_retire(cdict_t *dict, void *ptr, int32_t kind);
+
+void _cdict_free_retired(cdretired_t *retired, size_t count);
+
+uint64_t _cdict_read_lock(cdict_t *dict, cdreader_t *reader);
+
+cdreader_t *_cdict_reader(cdict_t *dict);
+
+/* PUBLIC API */
+
+/* Initialize a new dict. Takes the same arguments and options as dict_init,
+ * except that lengths are always powers of two. Not thread safe: finish this
+ * before sharing the dict. */
+void cdict_init(cdict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options);
+
+/* Adds the value with the specified key to the dict. If the key is already
+ * in the dict, return its old K-V pair in result. */
+int32_t cdict_add(cdict_t *dict, void *key, void *data, bucket_t *result);
+
+/* Retrieves the data value associated with the given key from the dict.
+ * Never blocks. */
+void *cdict_get(cdict_t *dict, void *key);
+
+void *cdict_remove(cdict_t *dict, void *key, bucket_t *result);
+
+/* Returns the number of keys. While writers are running it's only a
+ * snapshot. */
+int32_t cdict_load(cdict_t *dict);
+
+/* Waits until every cdict_get that started before this call has returned. */
+void cdict_synchronize(cdict_t *dict);
+
+/* Clear memory belonging to this dict. Not thread safe: every other thread
+ * has to be done with the dict first. */
+void cdict_clear(cdict_t *dict, int32_t options);
+
+#endif
@@ -0,0 +1,148 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Cuckoo filters. */
+
+/* dict.h brings in cfilter.h along with km_mix32. */
+#include "dict.h"
+
+#define CFILTER_LANES   0x0001000100010001ULL
+#define CFILTER_HIGHS   0x8000800080008000ULL
+
+static inline int32_t _cfilter_has(uint64_t bucket, uint16_t fingerprint){
+    /* Whether any of the bucket's four 16 bit lanes equals fingerprint: xor
+     * zeroes the matching lanes, and the usual has-zero trick finds them. */
+    uint64_t v = bucket ^ (fingerprint * CFILTER_LANES);
+    return ((v - CFILTER_LANES) & ~v & CFILTER_HIGHS) != 0;
+}
+
+static inline size_t _cfilter_alt(const cfilter_t *filter, size_t index, uint16_t fingerprint){
+    /* The other bucket a fingerprint can live in. Applying it twice gets
+     * back to where it started. */
+    return (index ^ km_mix32(fingerprint)) & filter->mask;
+}
+
+void _cfilter_locate(const cfilter_t *filter, int32_t hash, uint16_t *fingerprint,
+    size_t *first, size_t *second){
+
+    uint32_t h = km_mix32((uint32_t)hash ^ 0x5BD1E995);
+    *fingerprint = (uint16_t)(km_mix32(h + 0x9E3779B9) >> 16);
+    if(*fingerprint == 0){
+        *fingerprint = 1;
+    }
+    *first = h & filter->mask;
+    *second = _cfilter_alt(filter, *first, *fingerprint);
+}
+
+int32_t _cfilter_put(uint64_t *bucket, uint16_t fingerprint){
+    /* Puts fingerprint in a free lane of bucket. Returns -1 if it's full. */
+    for(int32_t lane = 0; lane < CFILTER_SLOTS; lane++){
+        if(((*bucket >> (16 * lane)) & 0xFFFF) == 0){
+            *bucket |= (uint64_t)fingerprint << (16 * lane);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int32_t cfilter_init(cfilter_t *filter, size_t capacity){
+    size_t buckets = 2;
+    while(buckets * CFILTER_SLOTS * CFILTER_MAX_LOAD < capacity){
+        buckets <<= 1;
+    }
+    filter->buckets = calloc(buckets, sizeof(uint64_t));
+    filter->mask = buckets - 1;
+    filter->victim_index = 0;
+    filter->load = 0;
+    filter->has_victim = 0;
+    filter->victim = 0;
+    if(filter->buckets == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        filter->mask = 0;
+        return -1;
+    }
+    return 0;
+}
+
+int32_t cfilter_add(cfilter_t *filter, int32_t hash){
+    if(filter->has_victim){
+        return -1;
+    }
+    uint16_t fingerprint;
+    size_t first, second;
+    _cfilter_locate(filter, hash, &fingerprint, &first, &second);
+    filter->load = filter->load + 1;
+    if(!_cfilter_put(filter->buckets + first, fingerprint)
+        || !_cfilter_put(filter->buckets + second, fingerprint)){
+        return 0;
+    }
+
+    /* Both full. Evict fingerprints to their other buckets until one lands
+     * somewhere free. */
+    size_t index = (hash & 1) ? first : second;
+    for(int32_t kick = 0; kick < CFILTER_MAX_KICKS; kick++){
+        int32_t shift = 16 * (kick % CFILTER_SLOTS);
+        uint16_t evicted = (uint16_t)(filter->buckets[index] >> shift);
+        filter->buckets[index] &= ~((uint64_t)0xFFFF << shift);
+        filter->buckets[index] |= (uint64_t)fingerprint << shift;
+        fingerprint = evicted;
+        index = _cfilter_alt(filter, index, fingerprint);
+        if(!_cfilter_put(filter->buckets + index, fingerprint)){
+            return 0;
+        }
+    }
+
+    /* Keep the one left over, so nothing that was added gets lost. */
+    filter->has_victim = 1;
+    filter->victim = fingerprint;
+    filter->victim_index = index;
+    return -1;
+}
+
+int32_t cfilter_contains(const cfilter_t *filter, int32_t hash){
+    uint16_t fingerprint;
+    size_t first, second;
+    _cfilter_locate(filter, hash, &fingerprint, &first, &second);
+    uint64_t a = filter->buckets[first];
+    uint64_t b = filter->buckets[second];
+    return (_cfilter_has(a, fingerprint) | _cfilter_has(b, fingerprint))
+        || (filter->has_victim && filter->victim == fingerprint
+            && (filter->victim_index == first || filter->victim_index == second));
+}
+
+int32_t cfilter_remove(cfilter_t *filter, int32_t hash){
+    uint16_t fingerprint;
+    size_t first, second;
+    _cfilter_locate(filter, hash, &fingerprint, &first, &second);
+
+    size_t candidates[2] = {first, second};
+    for(int32_t c = 0; c < 2; c++){
+        uint64_t *bucket = filter->buckets + candidates[c];
+        for(int32_t lane = 0; lane < CFILTER_SLOTS; lane++){
+            if(((*bucket >> (16 * lane)) & 0xFFFF) == fingerprint){
+                *bucket &= ~((uint64_t)0xFFFF << (16 * lane));
+                filter->load = filter->load - 1;
+                return 1;
+            }
+        }
+    }
+    if(filter->has_victim && filter->victim == fingerprint
+        && (filter->victim_index == first || filter->victim_index == second)){
+
+        filter->has_victim = 0;
+        filter->load = filter->load - 1;
+        return 1;
+    }
+    return 0;
+}
+
+size_t cfilter_capacity(const cfilter_t *filter){
+    return (size_t)((filter->mask + 1) * CFILTER_SLOTS * CFILTER_MAX_LOAD);
+}
+
+void cfilter_clear(cfilter_t *filter){
+    free(filter->buckets);
+    filter->buckets = NULL;
+    filter->mask = 0;
+    filter->load = 0;
+    filter->has_victim = 0;
+}
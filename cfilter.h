@@ -0,0 +1,71 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Cuckoo filters.
+ *
+ * A cfilter_t answers "might a key with this hash have been added?" with no
+ * false negatives and about 0.01% false positives, in 2 to 4 bytes a key.
+ * It works from the int32_t hashes the tables already compute, not from
+ * keys. Each hash gets a 16 bit fingerprint and two candidate buckets of
+ * CFILTER_SLOTS fingerprints each, the second found from the first and the
+ * fingerprint alone, so fingerprints can be kicked between their two
+ * buckets to make room without knowing their keys. Unlike a Bloom filter,
+ * fingerprints can be taken out again, so the filter can track removes.
+ *
+ * dict_t keeps one of these in front of its table when DICTHT_FILTER is
+ * set, but it works on its own too.
+ */
+
+#ifndef KMDATA_CFILTER_H
+#define KMDATA_CFILTER_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+/* Constants for internal use. */
+#define CFILTER_SLOTS       4
+#define CFILTER_MAX_LOAD    0.9
+#define CFILTER_MAX_KICKS   500
+
+typedef struct {
+    uint64_t *buckets;      /* CFILTER_SLOTS 16 bit fingerprints each, 0 if empty */
+    size_t mask;
+    size_t victim_index;
+    int32_t load;
+    int32_t has_victim;     /* a fingerprint that couldn't be placed */
+    uint16_t victim;
+} cfilter_t;
+
+/* PRIVATE FUNCTIONS */
+void _cfilter_locate(const cfilter_t *filter, int32_t hash, uint16_t *fingerprint,
+    size_t *first, size_t *second);
+
+int32_t _cfilter_put(uint64_t *bucket, uint16_t fingerprint);
+
+/* PUBLIC API */
+
+/* Initialize a filter with room for capacity hashes. Returns 0, or -1 if
+ * there's no memory. */
+int32_t cfilter_init(cfilter_t *filter, size_t capacity);
+
+/* Adds a hash. Returns 0, or -1 if the filter is too full to place it. The
+ * filter still holds the hash after a failure, but it can't take any more:
+ * build a bigger one. */
+int32_t cfilter_add(cfilter_t *filter, int32_t hash);
+
+/* Returns 0 if no key with this hash was added (or all of them were
+ * removed), and 1 if one probably was. */
+int32_t cfilter_contains(const cfilter_t *filter, int32_t hash);
+
+/* Takes out one earlier add of hash. Only remove hashes that were added.
+ * Returns 1 if one was found, 0 if not. */
+int32_t cfilter_remove(cfilter_t *filter, int32_t hash);
+
+/* Returns how many hashes the filter was sized for. */
+size_t cfilter_capacity(const cfilter_t *filter);
+
+/* Clear memory belonging to this filter. */
+void cfilter_clear(cfilter_t *filter);
+
+#endif
@@ -3,99 +3,476 @@
  * dict implementation based on hash tables. */
 
 #include "dict.h"
+#include "oat.h"
 
+/* Marks tree bins. Only its address matters. */
+char _dict_treebin;
 
 void dict_init(dict_t *dict, size_t size, int32_t (*hash)(const void *), 
     int32_t (*eq)(const void *, const void *), int32_t options){
     size_t length = MAX(size, DICTHT_MINIMUM_SIZE);
-    dict->table = calloc(length, sizeof(bucket_t *));
-    if(dict->table == NULL){
-        fprintf(stderr, "%s\n", "Memory allocation failure.");
-        return;
+    if(options & DICTHT_POW2){
+        length = DICTHT_POW2_MINIMUM_SIZE;
+        while(length < size){
+            length <<= 1;
+        }
+    }
+    if(size <= DICTHT_SMALL_SIZE){
+        /* The table gets built by _dict_promote, if it's ever needed. */
+        dict->table = NULL;
+        length = 0;
+    }else{
+        dict->table = calloc(length, sizeof(bucket_t *));
+        if(dict->table == NULL){
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            return;
+        }
     }
 
+    dict->small = NULL;
+    dict->old_table = NULL;
+    dict->next_table = NULL;
     dict->hash = hash;
     dict->eq = eq;
+    dict->cmp = NULL;
+    dict->filter = NULL;
     dict->length = length;
+    dict->old_length = 0;
+    dict->next_length = 0;
+    dict->rehash_index = 0;
     dict->load = 0;
     dict->flags = options;
+    if(dict->table != NULL && (options & DICTHT_FILTER)){
+        _dict_filter_rebuild(dict, length);
+    }
 }
 
-void *dict_get(dict_t *dict, void *key){
-
-    int32_t hash = dict->hash(key);
-    int32_t index = MOD(hash, dict->length);
-
-    bucket_t *bucket = *(dict->table + index);
+void dict_set_cmp(dict_t *dict, int32_t (*cmp)(const void *, const void *)){
+    dict->cmp = cmp;
+}
 
+bucket_t *_dict_chain_find(dict_t *dict, bucket_t *bucket, void *key, int32_t hash){
+    /* Finds key in the chain or tree bin starting at bucket. */
     if(bucket == NULL)
         return NULL;
 
-    while(!(dict->eq(key, bucket->key))){
+    if(DICTHT_IS_TREEBIN(bucket)){
+        rbnode_t *node = rbt_getnode((rbtree_t *)bucket->data, key);
+        return node == NULL ? NULL : (bucket_t *)node->data;
+    }
+
+    while(!(bucket->hash == hash && dict->eq(key, bucket->key))){
         if(bucket->next == NULL)
             return NULL;
         bucket = bucket->next;
     }
+    return bucket;
+}
+
+bucket_t *_dict_small_find(dict_t *dict, void *key, int32_t hash){
+    for(int32_t i = 0; i < dict->load; i++){
+        bucket_t *entry = dict->small + i;
+        if(entry->hash == hash && dict->eq(key, entry->key)){
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+int32_t _dict_promote(dict_t *dict){
+    /* Moves a small dict's pairs into a real table. If that can't be done,
+     * the dict stays small and -1 is returned. */
+    size_t length = DICTHT_MIN_SIZE(dict);
+    bucket_t **table = calloc(length, sizeof(bucket_t *));
+    if(table == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return -1;
+    }
+
+    for(int32_t i = 0; i < dict->load; i++){
+        bucket_t *bucket = malloc(sizeof(bucket_t));
+        if(bucket == NULL){
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            for(size_t j = 0; j < length; j++){
+                bucket_t *next_bucket;
+                for(bucket = table[j]; bucket != NULL; bucket = next_bucket){
+                    next_bucket = bucket->next;
+                    free(bucket);
+                }
+            }
+            free(table);
+            return -1;
+        }
+        *bucket = dict->small[i];
+        bucket_t **slot = table + _dict_index(dict, bucket->hash, length);
+        bucket->next = *slot;
+        *slot = bucket;
+    }
+
+    free(dict->small);
+    dict->small = NULL;
+    dict->table = table;
+    dict->length = length;
+    if(dict->flags & DICTHT_FILTER){
+        _dict_filter_rebuild(dict, length);
+    }
+    return 0;
+}
+
+bucket_t *_dict_lookup(dict_t *dict, void *key, int32_t hash){
+    /* Finds the bucket holding key, looking in the old table first if an
+     * incremental resize is still running. */
+    if(DICTHT_IS_SMALL(dict)){
+        return _dict_small_find(dict, key, hash);
+    }
+    if(dict->filter != NULL && !cfilter_contains(dict->filter, hash)){
+        return NULL;
+    }
+
+    if(dict->old_table != NULL){
+        size_t old_index = _dict_index(dict, hash, dict->old_length);
+        if(old_index >= dict->rehash_index){
+            bucket_t *bucket = _dict_chain_find(dict, dict->old_table[old_index],
+                                    key, hash);
+            if(bucket != NULL){
+                return bucket;
+            }
+        }
+    }
+
+    size_t index = _dict_index(dict, hash, dict->length);
+    return _dict_chain_find(dict, *(dict->table + index), key, hash);
+}
+
+bucket_t *_dict_first_bucket(bucket_t *bucket){
+    /* Skips over a tree bin, so the chain in a slot can be walked the same
+     * way whether it has been treeified or not. */
+    if(bucket != NULL && DICTHT_IS_TREEBIN(bucket)){
+        return bucket->next;
+    }
+    return bucket;
+}
+
+void _dict_bin_push(bucket_t **slot, bucket_t *bucket){
+    /* Puts a bucket that's known not to be in the dict into a slot. */
+    bucket_t *bin = *slot;
+    if(bin != NULL && DICTHT_IS_TREEBIN(bin)){
+        rbnode_t result;
+        rbt_insert((rbtree_t *)bin->data, bucket->key, bucket, &result);
+        slot = &bin->next;
+    }
+    bucket->next = *slot;
+    *slot = bucket;
+}
+
+void _dict_treeify(dict_t *dict, bucket_t **slot){
+    /* Puts a tree bin in front of the chain in slot. If there's no memory
+     * for one, the chain just stays a plain chain. */
+    rbtree_t *tree = malloc(sizeof(rbtree_t));
+    bucket_t *bin = malloc(sizeof(bucket_t));
+    if(tree == NULL || bin == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        free(tree);
+        free(bin);
+        return;
+    }
+
+    rbt_init(tree, dict->cmp);
+    rbnode_t result;
+    for(bucket_t *bucket = *slot; bucket != NULL; bucket = bucket->next){
+        rbt_insert(tree, bucket->key, bucket, &result);
+    }
+
+    bin->key = &_dict_treebin;
+    bin->data = tree;
+    bin->next = *slot;
+    bin->hash = 0;
+    *slot = bin;
+}
+
+bucket_t *_dict_untreeify(bucket_t *bin){
+    /* Frees a tree bin and returns the chain it was in front of. */
+    bucket_t *chain = bin->next;
+    rbt_clear((rbtree_t *)bin->data, 0);
+    free(bin->data);
+    free(bin);
+    return chain;
+}
+
+void *dict_get(dict_t *dict, void *key){
+    if(DICTHT_REHASHING(dict)){
+        _dict_rehash_step(dict, DICTHT_REHASH_STEPS);
+    }
+
+    bucket_t *bucket = _dict_lookup(dict, key, dict->hash(key));
+    if(bucket == NULL)
+        return NULL;
+
     return bucket->data;
 }
 
-int32_t dict_add(dict_t *dict, void *key, void *data, bucket_t *result){
+void _dict_hash_many(dict_t *dict, void **keys, int32_t *hashes, size_t n){
+    /* oat_string_hash has a version that does a batch of keys at once.
+     * Other hash functions get called a key at a time. */
+    if(dict->hash == oat_string_hash){
+        oat_string_hash_many(keys, hashes, n);
+        return;
+    }
+    for(size_t i = 0; i < n; i++){
+        hashes[i] = dict->hash(keys[i]);
+    }
+}
+
+size_t dict_get_many(dict_t *dict, void **keys, void **values, size_t n){
+    int32_t hashes[DICTHT_BATCH_SIZE];
+    bucket_t *buckets[DICTHT_BATCH_SIZE];
+    size_t found = 0;
+
+    if(DICTHT_REHASHING(dict)){
+        _dict_rehash_step(dict, DICTHT_REHASH_STEPS);
+    }
+
+    if(DICTHT_IS_SMALL(dict)){
+        /* Nothing to prefetch, the pairs are all together already. */
+        for(size_t i = 0; i < n; i++){
+            bucket_t *bucket = _dict_small_find(dict, keys[i], dict->hash(keys[i]));
+            values[i] = bucket == NULL ? NULL : bucket->data;
+            found += bucket != NULL;
+        }
+        return found;
+    }
+
+    for(size_t start = 0; start < n; start += DICTHT_BATCH_SIZE){
+        size_t count = n - start;
+        if(count > DICTHT_BATCH_SIZE){
+            count = DICTHT_BATCH_SIZE;
+        }
+
+        /* Hash everything and get the table slots on their way. */
+        _dict_hash_many(dict, keys + start, hashes, count);
+        for(size_t i = 0; i < count; i++){
+            __builtin_prefetch(dict->table + _dict_index(dict, hashes[i], dict->length));
+        }
+
+        if(dict->old_table != NULL){
+            /* Mid-resize a key could be in either table, so leave it to
+             * _dict_lookup. The slot prefetches above still help. */
+            for(size_t i = 0; i < count; i++){
+                bucket_t *bucket = _dict_lookup(dict, keys[start + i], hashes[i]);
+                values[start + i] = bucket == NULL ? NULL : bucket->data;
+                found += bucket != NULL;
+            }
+            continue;
+        }
+
+        /* Then the first bucket of each chain. */
+        for(size_t i = 0; i < count; i++){
+            if(dict->filter != NULL && !cfilter_contains(dict->filter, hashes[i])){
+                buckets[i] = NULL;
+                continue;
+            }
+            buckets[i] = dict->table[_dict_index(dict, hashes[i], dict->length)];
+            if(buckets[i] != NULL){
+                __builtin_prefetch(buckets[i]);
+            }
+        }
+
+        /* By now most of them should be in cache. */
+        for(size_t i = 0; i < count; i++){
+            bucket_t *bucket = _dict_chain_find(dict, buckets[i], keys[start + i],
+                                    hashes[i]);
+            values[start + i] = bucket == NULL ? NULL : bucket->data;
+            found += bucket != NULL;
+        }
+    }
+    return found;
+}
+
+bucket_t *_dict_upsert(dict_t *dict, void *key, int32_t hash, int32_t *inserted){
+    /* Finds key's bucket, or adds one for it with NULL data if it isn't there
+     * yet. Either way that's one probe, and a bucket is only malloc'd when
+     * it's really going to be used. Returns NULL if there's no memory. */
+    *inserted = 0;
+
+    if(DICTHT_IS_SMALL(dict)){
+        bucket_t *entry = _dict_small_find(dict, key, hash);
+        if(entry != NULL){
+            return entry;
+        }
+
+        if(dict->small == NULL){
+            dict->small = malloc(DICTHT_SMALL_SIZE * sizeof(bucket_t));
+            if(dict->small == NULL){
+                fprintf(stderr, "%s\n", "Memory allocation failure.");
+                return NULL;
+            }
+        }
+        if(dict->load < DICTHT_SMALL_SIZE){
+            entry = dict->small + dict->load;
+            entry->key = key;
+            entry->data = NULL;
+            entry->next = NULL;
+            entry->hash = hash;
+            dict->load = dict->load + 1;
+            *inserted = 1;
+            return entry;
+        }
+
+        /* Full up, time for a real table. */
+        if(_dict_promote(dict)){
+            return NULL;
+        }
+    }
+
     /* Check the size of the dict. Do we need to grow? */
-    if(((double)(dict->load + 1)) / dict->length > DICTHT_MAX_LOAD
+    if(DICTHT_REHASHING(dict)){
+        _dict_rehash_step(dict, DICTHT_REHASH_STEPS);
+    }else if(((double)(dict->load + 1)) / dict->length > DICTHT_MAX_LOAD
         && !(dict->flags & DICTHT_NO_GROW)){
         
         _dict_resize(dict, (size_t)(dict->length * DICTHT_GROW_FACTOR));
     }
 
-    int32_t hash = dict->hash(key);
-    int32_t index = MOD(hash, dict->length);
+    if(dict->old_table != NULL){
+        /* The key may not have been moved over yet. */
+        bucket_t *bucket = _dict_lookup(dict, key, hash);
+        if(bucket != NULL){
+            return bucket;
+        }
+    }
+
+    bucket_t **target = dict->table + _dict_index(dict, hash, dict->length);
+    bucket_t *last_bucket = NULL;
+    int32_t chain_length = 1;
+    /* If the filter rules key out, skip the walk and put it at the front.
+     * That's only safe without tree bins, which need chain lengths. */
+    int32_t known_new = dict->filter != NULL && !(dict->flags & DICTHT_TREEIFY)
+        && !cfilter_contains(dict->filter, hash);
+    if(known_new){
+        last_bucket = NULL;
+    }else if(*target != NULL && DICTHT_IS_TREEBIN(*target)){
+        rbnode_t *node = rbt_getnode((rbtree_t *)(*target)->data, key);
+        if(node != NULL){
+            return (bucket_t *)node->data;
+        }
+    }else{
+        for(bucket_t *bucket = *target; bucket != NULL; bucket = bucket->next){
+            if(bucket->hash == hash && dict->eq(key, bucket->key)){
+                return bucket;
+            }
+            last_bucket = bucket;
+            chain_length++;
+        }
+    }
 
+    /* Not there, so now we need a bucket. */
     bucket_t *new_bucket = malloc(sizeof(bucket_t));
     if(!new_bucket){
         fprintf(stderr, "%s\n", "Memory allocation failure.");
-        result->key = NULL;
-        return -1;
+        return NULL;
     }
-
-    new_bucket->data = data;
+    new_bucket->data = NULL;
     new_bucket->key = key;
     new_bucket->next = NULL;
+    new_bucket->hash = hash;
 
-    bucket_t **target = dict->table + index;
-    if(*target == NULL){
-        *target = new_bucket;
+    if(last_bucket == NULL){
+        _dict_bin_push(target, new_bucket);
     }else{
-        bucket_t *bucket = *target;
-        bucket_t *last_bucket = NULL;
-        do{
-            last_bucket = bucket;
-            if(dict->eq(key, bucket->key)){
-                /* Scan down the buckets and replace the old one if the keys are
-                 * actually equal. */
-                result->key = bucket->key;
-                result->data = bucket->data;
-                bucket->key = key;
-                bucket->data = data;
-                free(new_bucket);
-                return hash;
-            }
-            bucket = bucket->next;
-        }while(bucket != NULL);
         last_bucket->next = new_bucket;
+        if(chain_length >= DICTHT_TREEIFY_THRESHOLD
+            && (dict->flags & DICTHT_TREEIFY) && dict->cmp != NULL){
+            _dict_treeify(dict, target);
+        }
+    }
+    if(dict->filter != NULL){
+        _dict_filter_add(dict, hash);
     }
     dict->load = dict->load + 1;
-    result->key = key;
-    result->data = data;
+    *inserted = 1;
+    return new_bucket;
+}
+
+bucket_t *dict_upsert(dict_t *dict, void *key, int32_t *inserted){
+    return _dict_upsert(dict, key, dict->hash(key), inserted);
+}
+
+int32_t dict_add(dict_t *dict, void *key, void *data, bucket_t *result){
+    int32_t hash = dict->hash(key);
+    int32_t inserted;
+
+    bucket_t *bucket = _dict_upsert(dict, key, hash, &inserted);
+    if(bucket == NULL){
+        result->key = NULL;
+        return -1;
+    }
+
+    if(inserted){
+        bucket->data = data;
+        result->key = key;
+        result->data = data;
+        return hash;
+    }
+
+    /* Replace the old pair, keys and all. */
+    result->key = bucket->key;
+    result->data = bucket->data;
+    dict_rekey(dict, bucket, key);
+    bucket->data = data;
     return hash;
 }
 
+void dict_rekey(dict_t *dict, bucket_t *bucket, void *key){
+    /* Points bucket at an equal key. A tree bin holding the bucket has its
+     * own pointer to the key, so that has to change too. */
+    bucket_t *bins[2] = {NULL, NULL};
+    if(!DICTHT_IS_SMALL(dict)){
+        bins[0] = dict->table[_dict_index(dict, bucket->hash, dict->length)];
+        if(dict->old_table != NULL){
+            size_t old_index = _dict_index(dict, bucket->hash, dict->old_length);
+            if(old_index >= dict->rehash_index){
+                bins[1] = dict->old_table[old_index];
+            }
+        }
+    }
+    for(int t = 0; t < 2; t++){
+        if(bins[t] != NULL && DICTHT_IS_TREEBIN(bins[t])){
+            rbnode_t *node = rbt_getnode((rbtree_t *)bins[t]->data, key);
+            if(node != NULL && node->data == bucket){
+                node->key = key;
+            }
+        }
+    }
+    bucket->key = key;
+}
+
 void *dict_remove(dict_t *dict, void *key, bucket_t *result){
+    if(DICTHT_IS_SMALL(dict)){
+        result->key = NULL;
+        result->data = NULL;
+
+        bucket_t *entry = _dict_small_find(dict, key, dict->hash(key));
+        if(entry == NULL){
+            return NULL;
+        }
+        void *ret = entry->data;
+        result->key = entry->key;
+        result->data = ret;
+
+        /* Order doesn't matter, so fill the hole with the last pair. */
+        dict->load = dict->load - 1;
+        *entry = dict->small[dict->load];
+        return ret;
+    }
+
     /* Check the size. Should we be using a smaller table? */
-    if((((double)(dict->load - 1)) / dict->length) < DICTHT_MIN_LOAD
-        && !(dict->flags & DICTHT_NO_SHRINK) && (dict->length > DICTHT_MINIMUM_SIZE)){
+    if(DICTHT_REHASHING(dict)){
+        _dict_rehash_step(dict, DICTHT_REHASH_STEPS);
+    }else if((((double)(dict->load - 1)) / dict->length) < DICTHT_MIN_LOAD
+        && !(dict->flags & DICTHT_NO_SHRINK) && (dict->length > DICTHT_MIN_SIZE(dict))){
         
         size_t new_size = MAX((size_t)(dict->length / DICTHT_GROW_FACTOR), 
-                            DICTHT_MINIMUM_SIZE);
+                            DICTHT_MIN_SIZE(dict));
 
         _dict_resize(dict, new_size);
     }
@@ -104,84 +481,525 @@ void *dict_remove(dict_t *dict, void *key, bucket_t *result){
     result->data = NULL;
 
     int32_t hash = dict->hash(key);
-    int32_t index = MOD(hash, dict->length);
+    bucket_t **target = NULL;
 
-    bucket_t *bucket = *(dict->table + index);
-    if(bucket == NULL){
-        return NULL; /* no such entry in the table */
+    if(dict->old_table != NULL){
+        /* Check the part of the old table that hasn't been moved yet. */
+        size_t old_index = _dict_index(dict, hash, dict->old_length);
+        if(old_index >= dict->rehash_index){
+            target = dict->old_table + old_index;
+        }
     }
 
-    bucket_t *last_bucket = NULL;
-    do{
-        if(dict->eq(key, bucket->key)){
+    for(int t = (target == NULL); t < 2; t++){
+        if(t == 1){
+            target = dict->table + _dict_index(dict, hash, dict->length);
+        }
+
+        bucket_t *bucket = *target;
+        if(bucket == NULL){
+            continue; /* no such entry in this table */
+        }
+
+        if(DICTHT_IS_TREEBIN(bucket)){
+            rbtree_t *tree = (rbtree_t *)bucket->data;
+            rbnode_t removed;
+            bucket_t *match = rbt_remove(tree, key, &removed);
+            if(match == NULL){
+                continue;
+            }
+
+            /* The tree found it, so unlinking it from the chain only takes
+             * pointer compares. */
+            bucket_t **link = &bucket->next;
+            while(*link != match){
+                link = &(*link)->next;
+            }
+            *link = match->next;
+            if(tree->size <= DICTHT_UNTREEIFY_THRESHOLD){
+                *target = _dict_untreeify(bucket);
+            }
+
+            if(dict->filter != NULL){
+                cfilter_remove(dict->filter, hash);
+            }
             dict->load = dict->load - 1;
-            void *ret = bucket->data;
-            result->key = bucket->key;
+            void *ret = match->data;
+            result->key = match->key;
             result->data = ret;
-            
-            if(last_bucket == NULL){
-                *(dict->table + index) = bucket->next;
-            }else{
-                last_bucket->next = bucket->next;
-            }
-            free(bucket);
+            free(match);
             return ret;
         }
-        last_bucket = bucket;
-    }while((bucket = bucket->next) != NULL);
+
+        bucket_t *last_bucket = NULL;
+        do{
+            if(bucket->hash == hash && dict->eq(key, bucket->key)){
+                if(dict->filter != NULL){
+                    cfilter_remove(dict->filter, hash);
+                }
+                dict->load = dict->load - 1;
+                void *ret = bucket->data;
+                result->key = bucket->key;
+                result->data = ret;
+                
+                if(last_bucket == NULL){
+                    *target = bucket->next;
+                }else{
+                    last_bucket->next = bucket->next;
+                }
+                free(bucket);
+                return ret;
+            }
+            last_bucket = bucket;
+        }while((bucket = bucket->next) != NULL);
+    }
 
     return NULL; /*no match found*/
 }
 
+size_t _dict_build_shard(dict_t *dict, int32_t hash, size_t threads){
+    /* Workers own contiguous runs of slots, so a slot's owner is just its
+     * position scaled down to the thread count. */
+    return _dict_index(dict, hash, dict->length) * threads / dict->length;
+}
+
+void _dict_run(int32_t threads, void *(*fn)(void *), void *args, size_t size){
+    /* Calls fn on each of threads arguments packed size bytes apart in args,
+     * the first on the calling thread and the rest on threads of their own.
+     * Any that can't get a thread run here too. */
+    pthread_t *workers = malloc(threads * sizeof(pthread_t));
+    int32_t *started = calloc(threads, sizeof(int32_t));
+    for(int32_t t = 1; workers != NULL && started != NULL && t < threads; t++){
+        started[t] = !pthread_create(workers + t, NULL, fn, (char *)args + t * size);
+    }
+    for(int32_t t = 0; t < threads; t++){
+        if(started == NULL || !started[t]){
+            fn((char *)args + t * size);
+        }
+    }
+    for(int32_t t = 1; started != NULL && t < threads; t++){
+        if(started[t]){
+            pthread_join(workers[t], NULL);
+        }
+    }
+    free(workers);
+    free(started);
+}
+
+void *_dict_build_hash(void *arg){
+    /* Hashes this builder's share of the input and counts how many pairs of
+     * it land in each shard. */
+    dbuilder_t *builder = (dbuilder_t *)arg;
+    dbuild_t *build = builder->build;
+    size_t threads = (size_t)build->threads;
+    size_t *counts = build->counts + (size_t)builder->id * threads;
+
+    _dict_hash_many(build->dict, build->keys + builder->lo, build->hashes + builder->lo,
+        builder->hi - builder->lo);
+    for(size_t i = builder->lo; i < builder->hi; i++){
+        counts[_dict_build_shard(build->dict, build->hashes[i], threads)]++;
+    }
+    return NULL;
+}
+
+void *_dict_build_scatter(void *arg){
+    /* Groups the input by shard. Within a shard, pairs from earlier shares
+     * of the input go first, so every shard stays in input order. */
+    dbuilder_t *builder = (dbuilder_t *)arg;
+    dbuild_t *build = builder->build;
+    size_t threads = (size_t)build->threads;
+    size_t id = (size_t)builder->id;
+    size_t *offsets = build->offsets + id * threads;
+
+    size_t start = 0;
+    for(size_t s = 0; s < threads; s++){
+        offsets[s] = start;
+        for(size_t t = 0; t < threads; t++){
+            if(t < id){
+                offsets[s] += build->counts[t * threads + s];
+            }
+            start += build->counts[t * threads + s];
+        }
+    }
+    for(size_t i = builder->lo; i < builder->hi; i++){
+        build->order[offsets[_dict_build_shard(build->dict, build->hashes[i], threads)]++] = i;
+    }
+    return NULL;
+}
+
+void *_dict_build_insert(void *arg){
+    /* Inserts this builder's shard. Nobody else touches its slots, so there's
+     * nothing to lock, and a later duplicate replaces an earlier one just as
+     * it would through dict_add. */
+    dbuilder_t *builder = (dbuilder_t *)arg;
+    dbuild_t *build = builder->build;
+    dict_t *dict = build->dict;
+    size_t threads = (size_t)build->threads;
+    size_t id = (size_t)builder->id;
+
+    size_t start = 0, end = 0;
+    for(size_t s = 0; s <= id; s++){
+        start = end;
+        for(size_t t = 0; t < threads; t++){
+            end += build->counts[t * threads + s];
+        }
+    }
+    for(size_t k = start; k < end; k++){
+        size_t i = build->order[k];
+        int32_t hash = build->hashes[i];
+        bucket_t **slot = dict->table + _dict_index(dict, hash, dict->length);
+        bucket_t *bucket = _dict_chain_find(dict, *slot, build->keys[i], hash);
+        if(bucket == NULL){
+            if((bucket = malloc(sizeof(bucket_t))) == NULL){
+                builder->failed = 1;
+                break;
+            }
+            bucket->hash = hash;
+            bucket->next = *slot;
+            *slot = bucket;
+            builder->load++;
+        }
+        bucket->key = build->keys[i];
+        bucket->data = build->values[i];
+    }
+
+    if((dict->flags & DICTHT_TREEIFY) && dict->cmp != NULL){
+        for(size_t i = (dict->length * id + threads - 1) / threads;
+            i < dict->length && i * threads / dict->length == id; i++){
+
+            int32_t chain = 0;
+            for(bucket_t *bucket = dict->table[i]; bucket != NULL; bucket = bucket->next){
+                chain++;
+            }
+            if(chain >= DICTHT_TREEIFY_THRESHOLD){
+                _dict_treeify(dict, dict->table + i);
+            }
+        }
+    }
+    return NULL;
+}
+
+int32_t dict_build(dict_t *dict, void **keys, void **values, size_t n, int32_t threads){
+    bucket_t result;
+    if(n == 0 || dict->load != 0 || DICTHT_REHASHING(dict)
+        || (DICTHT_IS_SMALL(dict) && n <= DICTHT_SMALL_SIZE)){
+
+        /* Not worth a table and threads, or not a fresh dict. */
+        for(size_t i = 0; i < n; i++){
+            dict_add(dict, keys[i], values[i], &result);
+            if(result.key == NULL){
+                return -1;
+            }
+        }
+        return 0;
+    }
+    threads = MAX(threads, 1);
+
+    /* Size the table once, for the size it would have grown to anyway. */
+    size_t length = DICTHT_IS_SMALL(dict) ? DICTHT_MIN_SIZE(dict) : dict->length;
+    while(((double)n) / length > DICTHT_MAX_LOAD && !(dict->flags & DICTHT_NO_GROW)){
+        length *= DICTHT_GROW_FACTOR;
+    }
+
+    dbuild_t build;
+    build.dict = dict;
+    build.keys = keys;
+    build.values = values;
+    build.n = n;
+    build.threads = threads;
+    build.hashes = malloc(n * sizeof(int32_t));
+    build.order = malloc(n * sizeof(size_t));
+    build.counts = calloc((size_t)threads * threads, sizeof(size_t));
+    build.offsets = malloc((size_t)threads * threads * sizeof(size_t));
+    build.builders = calloc(threads, sizeof(dbuilder_t));
+    bucket_t **table = length == dict->length ? dict->table
+        : calloc(length, sizeof(bucket_t *));
+
+    int32_t failed = build.hashes == NULL || build.order == NULL || build.counts == NULL
+        || build.offsets == NULL || build.builders == NULL || table == NULL;
+    if(failed){
+        if(table != dict->table){
+            free(table);
+        }
+    }else{
+        if(table != dict->table){
+            free(dict->table);
+            free(dict->small);
+            dict->small = NULL;
+            dict->table = table;
+            dict->length = length;
+        }
+
+        for(int32_t t = 0; t < threads; t++){
+            build.builders[t].build = &build;
+            build.builders[t].id = t;
+            build.builders[t].lo = n * t / threads;
+            build.builders[t].hi = n * (t + 1) / threads;
+        }
+        _dict_run(threads, _dict_build_hash, build.builders, sizeof(dbuilder_t));
+        _dict_run(threads, _dict_build_scatter, build.builders, sizeof(dbuilder_t));
+        _dict_run(threads, _dict_build_insert, build.builders, sizeof(dbuilder_t));
+
+        for(int32_t t = 0; t < threads; t++){
+            dict->load += build.builders[t].load;
+            failed = failed || build.builders[t].failed;
+        }
+        if(dict->flags & DICTHT_FILTER){
+            _dict_filter_rebuild(dict, dict->length);
+        }
+    }
+
+    free(build.hashes);
+    free(build.order);
+    free(build.counts);
+    free(build.offsets);
+    free(build.builders);
+    if(failed){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return -1;
+    }
+    return 0;
+}
+
 void dict_clear(dict_t *dict, int32_t options){
     int32_t free_keys = options & DICTHT_FREE_KEYS;
     int32_t free_values = options & DICTHT_FREE_VALUES;
 
-    for(int i = 0; i<dict->length; i++){
-        if(dict->table[i] != NULL){
-            bucket_t *bucket = dict->table[i];
-            bucket_t *next_bucket;
-            do{
-                next_bucket = bucket->next;
-                if(free_keys){
-                    free(bucket->key);
-                }
-                if(free_values){
-                    free(bucket->data);
-                }
-                free(bucket);
-            }while((bucket = next_bucket) != NULL);
+    if(DICTHT_IS_SMALL(dict)){
+        for(int32_t i = 0; i < dict->load; i++){
+            if(free_keys){
+                free(dict->small[i].key);
+            }
+            if(free_values){
+                free(dict->small[i].data);
+            }
         }
     }
+
+    _dict_clear_slots(dict, 0, dict->length + dict->old_length, options);
+    if(dict->filter != NULL){
+        cfilter_clear(dict->filter);
+        free(dict->filter);
+    }
+    free(dict->small);
     free(dict->table);
+    free(dict->old_table);
+    free(dict->next_table);
+    dict->filter = NULL;
+    dict->small = NULL;
+    dict->table = NULL;
+    dict->old_table = NULL;
+    dict->next_table = NULL;
     dict->load = 0;
     dict->length = 0;
+    dict->old_length = 0;
+    dict->next_length = 0;
+    dict->rehash_index = 0;
     dict->hash = NULL;
     dict->eq = NULL;
 }
 
+bucket_t **_dict_slot_at(dict_t *dict, size_t position){
+    /* Numbers the slots of table then old_table as one run, so scans can be
+     * split into ranges without caring which table a slot is in. */
+    if(position < dict->length){
+        return dict->table + position;
+    }
+    return dict->old_table + (position - dict->length);
+}
+
+void _dict_clear_slots(dict_t *dict, size_t lo, size_t hi, int32_t options){
+    /* Frees the buckets in slots lo up to hi, leaving them empty. */
+    int32_t free_keys = options & DICTHT_FREE_KEYS;
+    int32_t free_values = options & DICTHT_FREE_VALUES;
+
+    for(size_t i = lo; i < hi; i++){
+        bucket_t **slot = _dict_slot_at(dict, i);
+        if(*slot != NULL && DICTHT_IS_TREEBIN(*slot)){
+            *slot = _dict_untreeify(*slot);
+        }
+        bucket_t *next_bucket;
+        for(bucket_t *bucket = *slot; bucket != NULL; bucket = next_bucket){
+            next_bucket = bucket->next;
+            if(free_keys){
+                free(bucket->key);
+            }
+            if(free_values){
+                free(bucket->data);
+            }
+            free(bucket);
+        }
+        *slot = NULL;
+    }
+}
+
+void *_dict_scan_for_each(void *arg){
+    dscan_t *scan = (dscan_t *)arg;
+    for(size_t i = scan->lo; i < scan->hi; i++){
+        for(bucket_t *bucket = _dict_first_bucket(*_dict_slot_at(scan->dict, i));
+            bucket != NULL; bucket = bucket->next){
+
+            scan->fn(bucket->key, bucket->data, scan->acc);
+        }
+    }
+    return NULL;
+}
+
+void *_dict_scan_clear(void *arg){
+    dscan_t *scan = (dscan_t *)arg;
+    _dict_clear_slots(scan->dict, scan->lo, scan->hi, scan->options);
+    return NULL;
+}
+
+void _dict_scan(dict_t *dict, int32_t threads, void *(*fn)(void *),
+    void (*callback)(void *, void *, void *), void **accs, int32_t options){
+
+    /* Splits the slots of both tables into threads even ranges and runs fn
+     * over each range on a thread of its own. */
+    size_t total = dict->length + dict->old_length;
+    threads = (int32_t)MAX(1, MIN((size_t)MAX(threads, 1), total));
+    dscan_t *scans = malloc(threads * sizeof(dscan_t));
+    if(scans == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        dscan_t scan = {dict, callback, accs ? accs[0] : NULL, 0, total, options};
+        fn(&scan);
+        return;
+    }
+    for(int32_t t = 0; t < threads; t++){
+        scans[t].dict = dict;
+        scans[t].fn = callback;
+        scans[t].acc = accs ? accs[t] : NULL;
+        scans[t].lo = total * t / threads;
+        scans[t].hi = total * (t + 1) / threads;
+        scans[t].options = options;
+    }
+    _dict_run(threads, fn, scans, sizeof(dscan_t));
+    free(scans);
+}
+
+void dict_parallel_for_each(dict_t *dict, int32_t threads,
+    void (*fn)(void *key, void *data, void *acc), void **accs){
+
+    if(DICTHT_IS_SMALL(dict)){
+        for(int32_t i = 0; i < dict->load; i++){
+            fn(dict->small[i].key, dict->small[i].data, accs ? accs[0] : NULL);
+        }
+        return;
+    }
+    _dict_scan(dict, threads, _dict_scan_for_each, fn, accs, 0);
+}
+
+void dict_parallel_clear(dict_t *dict, int32_t options, int32_t threads){
+    if(!DICTHT_IS_SMALL(dict)){
+        _dict_scan(dict, threads, _dict_scan_clear, NULL, NULL, options);
+    }
+    /* The tables are empty now, so this just frees them. */
+    dict_clear(dict, options);
+}
+
+void _dict_filter_rebuild(dict_t *dict, size_t capacity){
+    /* Replaces the filter with one sized for capacity hashes, or for twice
+     * the load if that's more, filled from every bucket. Goes without a
+     * filter if there's no memory, or if the hashes still don't fit after
+     * DICTHT_FILTER_RETRIES doublings, which no amount of room fixes once
+     * too many keys share a hash. */
+    cfilter_t *filter = malloc(sizeof(cfilter_t));
+    capacity = MAX(capacity, 2 * (size_t)dict->load);
+    int32_t failed = filter == NULL;
+    for(int32_t tries = 0; !failed; tries++){
+        if(cfilter_init(filter, capacity)){
+            failed = 1;
+            break;
+        }
+        int32_t full = 0;
+        for(size_t i = 0; !full && i < dict->length + dict->old_length; i++){
+            for(bucket_t *bucket = _dict_first_bucket(*_dict_slot_at(dict, i));
+                !full && bucket != NULL; bucket = bucket->next){
+
+                full = cfilter_add(filter, bucket->hash);
+            }
+        }
+        if(!full){
+            break;
+        }
+        cfilter_clear(filter);
+        if(tries == DICTHT_FILTER_RETRIES){
+            failed = 1;
+            break;
+        }
+        capacity *= 2;
+    }
+
+    if(dict->filter != NULL){
+        cfilter_clear(dict->filter);
+        free(dict->filter);
+    }
+    if(failed){
+        free(filter);
+        filter = NULL;
+    }
+    dict->filter = filter;
+}
+
+void _dict_filter_add(dict_t *dict, int32_t hash){
+    /* Call with the new bucket already in the table, so a rebuild picks it
+     * up. */
+    size_t capacity = cfilter_capacity(dict->filter);
+    if(cfilter_add(dict->filter, hash) || (size_t)dict->filter->load > capacity){
+        _dict_filter_rebuild(dict, 2 * capacity);
+    }
+}
+
 void dict_print(FILE *output, dict_t *dict, void (*disp_key)(FILE *, const void *),
     void (*disp_value)(FILE *, const void *)){
     
     fprintf(output, "{ ");
     int32_t count = 0;
-    for(int i = 0; i<dict->length; i++){
-        if(dict->table[i] != NULL){
-            bucket_t *bucket = dict->table[i];
-            do{
-                disp_key(output, bucket->key);
-                fprintf(output, ": ");
-                disp_value(output, bucket->data);
-                if(++count < dict->load){
-                    fprintf(output, ", ");
-                }
-            }while((bucket = bucket->next) != NULL);
+    for(int32_t i = 0; DICTHT_IS_SMALL(dict) && i < dict->load; i++){
+        disp_key(output, dict->small[i].key);
+        fprintf(output, ": ");
+        disp_value(output, dict->small[i].data);
+        if(++count < dict->load){
+            fprintf(output, ", ");
+        }
+    }
+    for(int t = 0; t < 2; t++){
+        bucket_t **table = t ? dict->old_table : dict->table;
+        size_t length = t ? dict->old_length : dict->length;
+
+        for(int i = 0; i<length; i++){
+            bucket_t *bucket = _dict_first_bucket(table[i]);
+            if(bucket != NULL){
+                do{
+                    disp_key(output, bucket->key);
+                    fprintf(output, ": ");
+                    disp_value(output, bucket->data);
+                    if(++count < dict->load){
+                        fprintf(output, ", ");
+                    }
+                }while((bucket = bucket->next) != NULL);
+            }
         }
     }
     fprintf(output, "} ");
 }
 
 void _dict_resize(dict_t *dict, size_t new_size){
+    if(dict->flags & DICTHT_INCREMENTAL){
+        /* Don't calloc here. On a big table that can mean zeroing hundreds of
+         * megabytes in this one call, so _dict_rehash_step zeroes it a chunk
+         * at a time before any chains get moved. */
+        bucket_t **next_table = malloc(new_size * sizeof(bucket_t *));
+        if(!next_table){
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            return;
+        }
+        dict->next_table = next_table;
+        dict->next_length = new_size;
+        dict->rehash_index = 0;
+        return;
+    }
+
     bucket_t **new_table = calloc(new_size, sizeof(bucket_t *));      
     if(!new_table){
         fprintf(stderr, "%s\n", "Memory allocation failure.");
@@ -189,15 +1007,19 @@ void _dict_resize(dict_t *dict, size_t new_size){
     }
 
     /* Go through the old table and rehash the entries into the new one */
+    int32_t trees = 0;
     for(int i = 0; i < dict->length; i++){
+        if(dict->table[i] != NULL && DICTHT_IS_TREEBIN(dict->table[i])){
+            dict->table[i] = _dict_untreeify(dict->table[i]);
+            trees++;
+        }
         if(dict->table[i] != NULL){
             bucket_t *bucket = dict->table[i];
             bucket_t *next_bucket;
             do{
                 /* This is fast and screws up the old table to no end, so do it
                  * right */
-                int32_t hash = dict->hash(bucket->key);
-                int32_t new_index = MOD(hash, new_size);
+                size_t new_index = _dict_index(dict, bucket->hash, new_size);
                 next_bucket = bucket->next;
                 bucket->next = new_table[new_index];
                 new_table[new_index] = bucket;
@@ -205,29 +1027,135 @@ void _dict_resize(dict_t *dict, size_t new_size){
         }
     }
 
+    /* Chains that were long enough to be trees usually still are. Without
+     * any trees there's no need to go looking. */
+    if(trees > 0 && (dict->flags & DICTHT_TREEIFY) && dict->cmp != NULL){
+        for(size_t i = 0; i < new_size; i++){
+            int32_t chain_length = 0;
+            for(bucket_t *bucket = new_table[i]; bucket != NULL; bucket = bucket->next){
+                chain_length++;
+            }
+            if(chain_length >= DICTHT_TREEIFY_THRESHOLD){
+                _dict_treeify(dict, new_table + i);
+            }
+        }
+    }
+
     free(dict->table);
     dict->table = new_table;
     dict->length = new_size;
 }
 
+void _dict_rehash_step(dict_t *dict, int32_t steps){
+    /* Zeroes the next chunk of a pending table, or moves up to steps chains
+     * from the old table into the new one. Empty slots don't count as steps,
+     * but only so many get skipped per call, so the work done here stays
+     * bounded no matter how big the dict is. */
+    int32_t empty_visits = DICTHT_REHASH_EMPTY_VISITS;
+
+    if(dict->next_table != NULL){
+        size_t count = dict->next_length - dict->rehash_index;
+        if(count > DICTHT_REHASH_ZERO_SLOTS){
+            count = DICTHT_REHASH_ZERO_SLOTS;
+        }
+        memset(dict->next_table + dict->rehash_index, 0, count * sizeof(bucket_t *));
+        dict->rehash_index = dict->rehash_index + count;
+
+        if(dict->rehash_index == dict->next_length){
+            dict->old_table = dict->table;
+            dict->old_length = dict->length;
+            dict->table = dict->next_table;
+            dict->length = dict->next_length;
+            dict->next_table = NULL;
+            dict->next_length = 0;
+            dict->rehash_index = 0;
+        }
+        return;
+    }
+
+    while(steps > 0 && dict->rehash_index < dict->old_length){
+        bucket_t *bucket = dict->old_table[dict->rehash_index];
+        if(bucket == NULL){
+            dict->rehash_index = dict->rehash_index + 1;
+            if(--empty_visits == 0){
+                break;
+            }
+            continue;
+        }
+
+        /* A chain that was a tree is likely to make one again where it
+         * lands, so each slot it goes into gets counted, as far as the
+         * threshold, and treeified if it's that long. */
+        int32_t was_tree = DICTHT_IS_TREEBIN(bucket)
+            && (dict->flags & DICTHT_TREEIFY) && dict->cmp != NULL;
+        if(DICTHT_IS_TREEBIN(bucket)){
+            bucket = _dict_untreeify(bucket);
+        }
+
+        bucket_t *next_bucket;
+        do{
+            bucket_t **target = dict->table + _dict_index(dict, bucket->hash, dict->length);
+            next_bucket = bucket->next;
+            _dict_bin_push(target, bucket);
+            if(was_tree && !DICTHT_IS_TREEBIN(*target)){
+                int32_t chain_length = 0;
+                for(bucket_t *b = *target; b != NULL && chain_length < DICTHT_TREEIFY_THRESHOLD;
+                    b = b->next){
+                    chain_length++;
+                }
+                if(chain_length >= DICTHT_TREEIFY_THRESHOLD){
+                    _dict_treeify(dict, target);
+                }
+            }
+        }while((bucket = next_bucket) != NULL);
+
+        dict->old_table[dict->rehash_index] = NULL;
+        dict->rehash_index = dict->rehash_index + 1;
+        steps--;
+    }
+
+    if(dict->rehash_index == dict->old_length){
+        free(dict->old_table);
+        dict->old_table = NULL;
+        dict->old_length = 0;
+        dict->rehash_index = 0;
+    }
+}
+
 void dict_key_set(list_t *rop, dict_t *dict){
     bucket_t *bucket;
-    for(int i = 0; i < dict->length; i++){
-        if((bucket = dict->table[i]) != NULL){
-            do{
-                list_addlast(rop, bucket->key);
-            }while((bucket = bucket->next) != NULL);
+    for(int32_t i = 0; DICTHT_IS_SMALL(dict) && i < dict->load; i++){
+        list_addlast(rop, dict->small[i].key);
+    }
+    for(int t = 0; t < 2; t++){
+        bucket_t **table = t ? dict->old_table : dict->table;
+        size_t length = t ? dict->old_length : dict->length;
+
+        for(int i = 0; i < length; i++){
+            if((bucket = _dict_first_bucket(table[i])) != NULL){
+                do{
+                    list_addlast(rop, bucket->key);
+                }while((bucket = bucket->next) != NULL);
+            }
         }
     }
 }
 
 void dict_value_set(list_t *rop, dict_t *dict){
     bucket_t *bucket;
-    for(int i = 0; i < dict->length; i++){
-        if((bucket = dict->table[i]) != NULL){
-            do{
-                list_addlast(rop, bucket->data);
-            }while((bucket = bucket->next) != NULL);
+    for(int32_t i = 0; DICTHT_IS_SMALL(dict) && i < dict->load; i++){
+        list_addlast(rop, dict->small[i].data);
+    }
+    for(int t = 0; t < 2; t++){
+        bucket_t **table = t ? dict->old_table : dict->table;
+        size_t length = t ? dict->old_length : dict->length;
+
+        for(int i = 0; i < length; i++){
+            if((bucket = _dict_first_bucket(table[i])) != NULL){
+                do{
+                    list_addlast(rop, bucket->data);
+                }while((bucket = bucket->next) != NULL);
+            }
         }
     }
 }
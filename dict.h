@@ -2,22 +2,40 @@
  * kmdata Data Structures Library
  * dict implementation based on hash tables. */
 
+#ifndef KMDATA_DICT_H
+#define KMDATA_DICT_H
+
 #include<stdio.h>
 #include<stdint.h>
 #include<stdlib.h>
+#include<string.h>
+#include<pthread.h>
 
 #include "error_handling.h"
 #include "list.h"
+#include "rbtree.h"
+#include "cfilter.h"
 
 #define MAX(a,b) ((a)>(b) ? a : b)
 
+#define MIN(a,b) ((a)<(b) ? a : b)
+
 #define MOD(x,m) (((x)%(m) + (m))%(m))
 
 /* Constants for internal use. */
 #define DICTHT_MINIMUM_SIZE 2039
+#define DICTHT_POW2_MINIMUM_SIZE    2048
 #define DICTHT_GROW_FACTOR  2
 #define DICTHT_MAX_LOAD     0.75
 #define DICTHT_MIN_LOAD     0.25
+#define DICTHT_REHASH_STEPS 4
+#define DICTHT_REHASH_EMPTY_VISITS  40
+#define DICTHT_REHASH_ZERO_SLOTS    1024
+#define DICTHT_BATCH_SIZE   32
+#define DICTHT_SMALL_SIZE   8
+#define DICTHT_TREEIFY_THRESHOLD    8
+#define DICTHT_UNTREEIFY_THRESHOLD  6
+#define DICTHT_FILTER_RETRIES       3
 
 /* Options for manipulating hash tables. */
 #define DICTHT_FREE_KEYS    1
@@ -27,25 +45,195 @@
 #define DICTHT_DEFAULTS     0
 #define DICTHT_NO_GROW      4
 #define DICTHT_NO_SHRINK    8
+#define DICTHT_INCREMENTAL  16
+#define DICTHT_TREEIFY      32
+#define DICTHT_POW2         64
+#define DICTHT_FILTER       128
 
+/* Buckets remember the full hash of their key, so resizes never have to call
+ * the hash function again and chain walks only call eq on real candidates. */
 typedef struct _ht_bucket {
     void *data;
     void *key;
     struct _ht_bucket *next;
+    int32_t hash;
 } bucket_t;
 
+/* With DICTHT_TREEIFY set and a comparator given to dict_set_cmp, a chain
+ * that reaches DICTHT_TREEIFY_THRESHOLD buckets gets a tree bin put in front
+ * of it: a bucket whose key is &_dict_treebin, whose data is an rbtree_t
+ * mapping each key to its bucket, and whose next is the chain as before.
+ * Lookups in that slot are then O(log n) even under bad hashes, while code
+ * that only walks buckets just skips the bin. The tree is dropped once it
+ * shrinks to DICTHT_UNTREEIFY_THRESHOLD. */
+extern char _dict_treebin;
+
+#define DICTHT_IS_TREEBIN(bucket) ((bucket)->key == (void *)&_dict_treebin)
+
+/* With DICTHT_INCREMENTAL set, a resize doesn't happen all at once. First the
+ * new table sits in next_table while it gets zeroed, rehash_index slots at a
+ * time. Then it becomes table, the old one moves to old_table, and chains
+ * below rehash_index have been moved across. Each add, get and remove does a
+ * bounded amount of that work.
+ *
+ * A dict that starts out small has no table at all. Its first
+ * DICTHT_SMALL_SIZE pairs are kept in the small array, which is scanned in
+ * place, and only the add that would overflow it builds a real table.
+ *
+ * With DICTHT_FILTER set, every table-backed dict keeps a cuckoo filter of
+ * its keys' hashes, updated on add and remove. A lookup the filter rules
+ * out returns without touching the table, so misses cost no chain walks or
+ * eq calls. If there's ever no memory for the filter, filter goes back to
+ * NULL and the dict carries on without one. The same happens if the hashes
+ * won't fit even after DICTHT_FILTER_RETRIES doublings: more than eight keys
+ * sharing one hash can never fit, since that hash has only two buckets of
+ * CFILTER_SLOTS slots to go in. */
 typedef struct {
     bucket_t **table;
+    bucket_t *small;
+    bucket_t **old_table;
+    bucket_t **next_table;
     int32_t (*hash)(const void *);
     int32_t (*eq)(const void *, const void *);
+    int32_t (*cmp)(const void *, const void *);
+    cfilter_t *filter;
     size_t length;
+    size_t old_length;
+    size_t next_length;
+    size_t rehash_index;
     int32_t load;
     int32_t flags;
 } dict_t;
 
+/* State shared by the threads of a dict_build. The input is split into
+ * one share per thread for hashing, then regrouped into one shard per
+ * thread, each shard being the pairs whose slots fall in that thread's
+ * run of the table. counts and offsets are threads x threads, indexed by
+ * input share then shard. */
+struct _dict_builder;
+
+typedef struct {
+    dict_t *dict;
+    void **keys;
+    void **values;
+    int32_t *hashes;
+    size_t *order;
+    size_t *counts;
+    size_t *offsets;
+    struct _dict_builder *builders;
+    size_t n;
+    int32_t threads;
+} dbuild_t;
+
+typedef struct _dict_builder {
+    dbuild_t *build;
+    size_t lo;
+    size_t hi;
+    int32_t id;
+    int32_t load;
+    int32_t failed;
+} dbuilder_t;
+
+/* One thread's share of a parallel scan: slots lo up to hi, numbered across
+ * table and then old_table. */
+typedef struct {
+    dict_t *dict;
+    void (*fn)(void *key, void *data, void *acc);
+    void *acc;
+    size_t lo;
+    size_t hi;
+    int32_t options;
+} dscan_t;
+
+#define DICTHT_REHASHING(dict) ((dict)->old_table != NULL || (dict)->next_table != NULL)
+
+#define DICTHT_IS_SMALL(dict) ((dict)->table == NULL)
+
+static inline uint32_t km_mix32(uint32_t h){
+    /* MurmurHash3's finalizer. Spreads weak hashes (like the identity hash on
+     * integers) over the low bits used to index a table. It's a bijection
+     * with km_mix32(0) == 0, so it never returns 0 for nonzero input. */
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Deletes from the linear probed, power of two tables (hset_t, odict_t and
+ * KM_DICT_DEFINE's) leave no tombstones. Once slot hole is emptied, the rest
+ * of its run is walked, and the entry in slot j, whose probe started at
+ * home, can move back into the hole unless home lies cyclically after the
+ * hole and at or before j; moved there, it would sit ahead of its home slot
+ * where no lookup would find it. Every move leaves a new hole at j. */
+static inline int32_t km_probe_can_fill(size_t hole, size_t j, size_t home, size_t mask){
+    return ((j - home) & mask) >= ((j - hole) & mask);
+}
+
+/* Picks the slot for hash in a table of the given length. By default that's
+ * MOD, which costs two divisions. With DICTHT_POW2 set, lengths are powers
+ * of two and the slot is just the low bits of the finalized hash. */
+static inline size_t _dict_index(const dict_t *dict, int32_t hash, size_t length){
+    if(dict->flags & DICTHT_POW2){
+        return km_mix32((uint32_t)hash) & (length - 1);
+    }
+    return MOD(hash, length);
+}
+
+#define DICTHT_MIN_SIZE(dict) \
+    ((dict)->flags & DICTHT_POW2 ? DICTHT_POW2_MINIMUM_SIZE : DICTHT_MINIMUM_SIZE)
+
 /* PRIVATE FUNCTIONS */ 
 void _dict_resize(dict_t *dict, size_t new_size);
 
+void _dict_rehash_step(dict_t *dict, int32_t steps);
+
+bucket_t *_dict_lookup(dict_t *dict, void *key, int32_t hash);
+
+void _dict_hash_many(dict_t *dict, void **keys, int32_t *hashes, size_t n);
+
+bucket_t *_dict_small_find(dict_t *dict, void *key, int32_t hash);
+
+int32_t _dict_promote(dict_t *dict);
+
+bucket_t *_dict_upsert(dict_t *dict, void *key, int32_t hash, int32_t *inserted);
+
+bucket_t *_dict_chain_find(dict_t *dict, bucket_t *bucket, void *key, int32_t hash);
+
+void _dict_bin_push(bucket_t **slot, bucket_t *bucket);
+
+void _dict_treeify(dict_t *dict, bucket_t **slot);
+
+bucket_t *_dict_untreeify(bucket_t *bin);
+
+bucket_t *_dict_first_bucket(bucket_t *bucket);
+
+size_t _dict_build_shard(dict_t *dict, int32_t hash, size_t threads);
+
+void _dict_run(int32_t threads, void *(*fn)(void *), void *args, size_t size);
+
+void *_dict_build_hash(void *arg);
+
+void *_dict_build_scatter(void *arg);
+
+void *_dict_build_insert(void *arg);
+
+bucket_t **_dict_slot_at(dict_t *dict, size_t position);
+
+void _dict_clear_slots(dict_t *dict, size_t lo, size_t hi, int32_t options);
+
+void *_dict_scan_for_each(void *arg);
+
+void *_dict_scan_clear(void *arg);
+
+void _dict_scan(dict_t *dict, int32_t threads, void *(*fn)(void *),
+    void (*callback)(void *, void *, void *), void **accs, int32_t options);
+
+void _dict_filter_rebuild(dict_t *dict, size_t capacity);
+
+void _dict_filter_add(dict_t *dict, int32_t hash);
+
 
 /* PUBLIC API */
 
@@ -55,22 +243,78 @@ void _dict_resize(dict_t *dict, size_t new_size);
  */
 int32_t dict_add(dict_t *dict, void *key, void *data, bucket_t *result);
 
+/* Finds key's bucket, adding one with NULL data if key isn't in the dict,
+ * with a single hash and probe. *inserted is set to 1 if the bucket is new
+ * and 0 if not. Read, initialize or replace the value through bucket->data.
+ * The bucket is good until the next add, upsert or remove. Returns NULL if
+ * there's no memory. For example, to count words read into a buffer:
+ *
+ * bucket_t *count = dict_upsert(&dict, buf, &inserted);
+ * if(inserted){
+ *     dict_rekey(&dict, count, strdup(buf));
+ * }
+ * count->data = (void *)((intptr_t)count->data + 1);
+ */
+bucket_t *dict_upsert(dict_t *dict, void *key, int32_t *inserted);
+
+/* Swaps the key in bucket for an equal one, such as a copy of a temporary
+ * key just passed to dict_upsert. Don't set bucket->key directly. */
+void dict_rekey(dict_t *dict, bucket_t *bucket, void *key);
+
 /* Retrieves the data value associated with the given key from the dictionary.*/
 void *dict_get(dict_t *dict, void *key);
 
+/* Looks up n keys at once, storing each one's data value (or NULL) in values.
+ * Keys get hashed and their table slots and buckets prefetched a batch at a
+ * time before any of them are resolved, so the cache misses overlap instead
+ * of adding up. Returns the number of keys found. */
+size_t dict_get_many(dict_t *dict, void **keys, void **values, size_t n);
+
+/* Adds n pairs from the keys and values arrays, using up to threads
+ * threads. The table is sized once for all of them, then each thread
+ * fills its own run of slots without locking. Duplicate keys end up the
+ * way n dict_add calls in array order would leave them: the last one
+ * wins. Meant for a freshly initialized dict. If it already holds pairs,
+ * they're just added one at a time. Returns 0, or -1 if there's no
+ * memory, in which case some pairs may be missing. */
+int32_t dict_build(dict_t *dict, void **keys, void **values, size_t n, int32_t threads);
+
 /* Clear memory belonging to this dictionary. */
 void dict_clear(dict_t *dict, int32_t options);
 
+/* Calls fn on every pair in the dict, with the table's slots split into
+ * threads ranges, each scanned by a thread of its own. The thread doing
+ * range t passes accs[t] as acc (or NULL if accs is NULL), so each can
+ * accumulate into its own, unshared, result without atomics; combine them
+ * afterwards. Pairs are visited once each, in no particular order. fn gets
+ * the data pointer by value, so it can change what data points to but not
+ * which pointer the dict holds, and it mustn't change the dict. */
+void dict_parallel_for_each(dict_t *dict, int32_t threads,
+    void (*fn)(void *key, void *data, void *acc), void **accs);
+
+/* Does what dict_clear does, with the buckets freed by threads threads. */
+void dict_parallel_clear(dict_t *dict, int32_t options, int32_t threads);
+
 void *dict_remove(dict_t *dict, void *key, bucket_t *result);
 
 /* Initialize a new dictionary given a valid pointer and some other important
- * stuff. */
+ * stuff. DICTHT_POW2 picks the table sizing for good, so it has to be given
+ * here rather than set in flags later, and so does DICTHT_FILTER. A size of
+ * DICTHT_SMALL_SIZE or less (0 included) starts the dict small, without
+ * allocating anything. */
 void dict_init(dict_t *dict, size_t size, int32_t (*hash)(const void *), 
     int32_t (*eq)(const void *, const void *), int32_t options);
 
+/* Gives the dict an ordering on its keys, used to build tree bins when
+ * DICTHT_TREEIFY is set. cmp has to agree with eq: cmp(a, b) == 0 exactly
+ * when eq(a, b). */
+void dict_set_cmp(dict_t *dict, int32_t (*cmp)(const void *, const void *));
+
 void dict_print(FILE *output, dict_t *dict, void (*disp_key)(FILE *, const void *),
     void (*disp_value)(FILE *, const void *));
 
 void dict_key_set(list_t *rop, dict_t *dict);
 
 void dict_value_set(list_t *rop, dict_t *dict);
+
+#endif
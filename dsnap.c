@@ -0,0 +1,231 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Memory mapped, read only dict snapshots. */
+
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include "dsnap.h"
+
+size_t _dsnap_pad(size_t size){
+    return (size + DSNAP_ALIGN - 1) & ~(size_t)(DSNAP_ALIGN - 1);
+}
+
+int32_t _dsnap_write_record(FILE *file, dsslot_t *slots, size_t length,
+    bucket_t *bucket, uint64_t *offset,
+    const void *(*value_bytes)(const void *value, size_t *length)){
+
+    /* Appends bucket's record at *offset and points a free slot at it. */
+    static const char zeros[DSNAP_ALIGN];
+    size_t key_length = strlen((const char *)bucket->key);
+    size_t value_length = sizeof(void *);
+    const void *value = &bucket->data;
+    if(value_bytes != NULL){
+        value = value_bytes(bucket->data, &value_length);
+    }
+
+    dsrecord_t record = { .value_length = value_length };
+    size_t key_size = _dsnap_pad(sizeof(dsrecord_t) + key_length + 1) - sizeof(dsrecord_t);
+    size_t value_size = _dsnap_pad(value_length);
+    if(fwrite(&record, sizeof(dsrecord_t), 1, file) != 1
+        || fwrite(bucket->key, 1, key_length + 1, file) != key_length + 1
+        || fwrite(zeros, 1, key_size - key_length - 1, file) != key_size - key_length - 1
+        || fwrite(value, 1, value_length, file) != value_length
+        || fwrite(zeros, 1, value_size - value_length, file) != value_size - value_length){
+
+        return -1;
+    }
+
+    size_t mask = length - 1;
+    size_t i = km_mix32((uint32_t)bucket->hash) & mask;
+    while(slots[i].offset != 0){
+        i = (i + 1) & mask;
+    }
+    slots[i].hash = bucket->hash;
+    slots[i].key_length = (uint32_t)key_length;
+    slots[i].offset = *offset;
+    *offset += sizeof(dsrecord_t) + key_size + value_size;
+    return 0;
+}
+
+int32_t dsnap_write(const char *path, dict_t *dict,
+    const void *(*value_bytes)(const void *value, size_t *length)){
+
+    /* At most half the slots are used, so probe runs stay short. */
+    size_t length = 16;
+    while(length < 2 * (size_t)dict->load){
+        length <<= 1;
+    }
+    dsslot_t *slots = calloc(length, sizeof(dsslot_t));
+    char *tmp_path = malloc(strlen(path) + 5);
+    if(slots == NULL || tmp_path == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        free(slots);
+        free(tmp_path);
+        return -1;
+    }
+    sprintf(tmp_path, "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if(file == NULL){
+        fprintf(stderr, "Couldn't open %s for writing.\n", tmp_path);
+        free(slots);
+        free(tmp_path);
+        return -1;
+    }
+
+    /* Records go after the slots, which are written last, once every
+     * record's offset is known. */
+    dsheader_t header;
+    memset(&header, 0, sizeof(dsheader_t));
+    memcpy(header.magic, DSNAP_MAGIC, sizeof(header.magic));
+    header.byte_order = DSNAP_BYTE_ORDER;
+    header.probe_hash = dict->hash(DSNAP_HASH_PROBE);
+    header.load = (uint64_t)dict->load;
+    header.length = length;
+    header.slots_offset = sizeof(dsheader_t);
+
+    uint64_t offset = header.slots_offset + length * sizeof(dsslot_t);
+    int32_t failed = fseek(file, (long)offset, SEEK_SET);
+
+    for(int32_t i = 0; !failed && DICTHT_IS_SMALL(dict) && i < dict->load; i++){
+        failed = _dsnap_write_record(file, slots, length, dict->small + i,
+            &offset, value_bytes);
+    }
+    for(int t = 0; t < 2; t++){
+        bucket_t **table = t ? dict->old_table : dict->table;
+        size_t table_length = t ? dict->old_length : dict->length;
+
+        for(size_t i = 0; !failed && i < table_length; i++){
+            for(bucket_t *bucket = _dict_first_bucket(table[i]);
+                !failed && bucket != NULL; bucket = bucket->next){
+
+                failed = _dsnap_write_record(file, slots, length, bucket,
+                    &offset, value_bytes);
+            }
+        }
+    }
+
+    header.file_size = offset;
+    failed = failed
+        || fseek(file, 0, SEEK_SET)
+        || fwrite(&header, sizeof(dsheader_t), 1, file) != 1
+        || fwrite(slots, sizeof(dsslot_t), length, file) != length;
+    failed = fclose(file) || failed;
+    free(slots);
+
+    if(failed || rename(tmp_path, path)){
+        fprintf(stderr, "Couldn't write %s.\n", path);
+        remove(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    free(tmp_path);
+    return 0;
+}
+
+int32_t dsnap_open(dsnap_t *snap, const char *path, int32_t (*hash)(const void *)){
+    snap->map = NULL;
+    snap->slots = NULL;
+    snap->size = 0;
+    snap->length = 0;
+    snap->load = 0;
+    snap->hash = hash;
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        fprintf(stderr, "Couldn't open %s.\n", path);
+        return -1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || (size_t)st.st_size < sizeof(dsheader_t)){
+        fprintf(stderr, "%s isn't a dict snapshot.\n", path);
+        close(fd);
+        return -1;
+    }
+
+    /* The mapping outlives the descriptor. Pages get read in as lookups
+     * touch them. */
+    const char *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        fprintf(stderr, "Couldn't map %s.\n", path);
+        return -1;
+    }
+
+    const dsheader_t *header = (const dsheader_t *)map;
+    if(memcmp(header->magic, DSNAP_MAGIC, sizeof(header->magic))
+        || header->byte_order != DSNAP_BYTE_ORDER
+        || header->file_size != (uint64_t)st.st_size
+        || header->length == 0 || (header->length & (header->length - 1))
+        || header->slots_offset > header->file_size
+        || header->length > (header->file_size - header->slots_offset) / sizeof(dsslot_t)){
+
+        fprintf(stderr, "%s isn't a dict snapshot.\n", path);
+        munmap((void *)map, (size_t)st.st_size);
+        return -1;
+    }
+    if(header->probe_hash != hash(DSNAP_HASH_PROBE)){
+        fprintf(stderr, "%s was written with a different hash function.\n", path);
+        munmap((void *)map, (size_t)st.st_size);
+        return -1;
+    }
+
+    snap->map = map;
+    snap->slots = (const dsslot_t *)(map + header->slots_offset);
+    snap->size = (size_t)st.st_size;
+    snap->length = (size_t)header->length;
+    snap->load = (int32_t)header->load;
+    return 0;
+}
+
+const void *dsnap_get(dsnap_t *snap, const char *key, size_t *length){
+    int32_t hash = snap->hash(key);
+    size_t key_length = strlen(key);
+    size_t mask = snap->length - 1;
+
+    size_t key_size = _dsnap_pad(sizeof(dsrecord_t) + key_length + 1);
+
+    /* Slots carry the hash and key length, so only real candidates cost a
+     * trip out to their record. dsnap_open only checked the header, so a
+     * damaged file can have slots pointing past its end, or no empty slot
+     * to stop at. Records are checked against the file's size before
+     * they're read, and the probe gives up after every slot. */
+    size_t i = km_mix32((uint32_t)hash) & mask;
+    for(size_t probes = 0; probes < snap->length && snap->slots[i].offset != 0;
+        probes++, i = (i + 1) & mask){
+
+        const dsslot_t *slot = snap->slots + i;
+        if(slot->hash != hash || slot->key_length != key_length){
+            continue;
+        }
+        if(slot->offset > snap->size || key_size > snap->size - slot->offset){
+            return NULL;
+        }
+        const dsrecord_t *record = (const dsrecord_t *)(snap->map + slot->offset);
+        const char *record_key = (const char *)(record + 1);
+        if(record->value_length > snap->size - slot->offset - key_size){
+            return NULL;
+        }
+        if(memcmp(record_key, key, key_length) == 0){
+            if(length != NULL){
+                *length = (size_t)record->value_length;
+            }
+            return record_key + key_size - sizeof(dsrecord_t);
+        }
+    }
+    return NULL;
+}
+
+void dsnap_close(dsnap_t *snap){
+    if(snap->map != NULL){
+        munmap((void *)snap->map, snap->size);
+    }
+    snap->map = NULL;
+    snap->slots = NULL;
+    snap->size = 0;
+    snap->length = 0;
+    snap->load = 0;
+}
@@ -0,0 +1,103 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Memory mapped, read only dict snapshots.
+ *
+ * dsnap_write saves a dict_t with string keys to a file that dsnap_open maps
+ * back in with mmap. Nothing gets parsed or copied on open, so the snapshot
+ * is ready for dsnap_get straight away, and the OS only reads in the pages
+ * that lookups actually touch.
+ *
+ * A snapshot is not a dict_t, and dict_get can't look things up in one:
+ * dict_t is a table of pointers to malloc'd buckets, and turning a mapped
+ * file into that means rewriting every pointer, which is the parsing this
+ * is meant to skip. Look keys up with dsnap_get instead, which takes the
+ * same string keys and gives back the stored value bytes.
+ *
+ * The file is a header, then a power of two table of slots, then the
+ * records. Each slot holds a key's hash and the file offset of its record,
+ * and each record holds the key inline, NUL terminated, followed by the
+ * value's bytes. Everything is addressed by offset, so the file can be
+ * mapped anywhere. Slots are probed linearly from km_mix32(hash), using the
+ * hashes the dict already stored, so the file has to be opened with the
+ * same hash function it was written with. Numbers are stored in the
+ * writer's byte order and dsnap_open refuses files from the other one.
+ */
+
+#ifndef KMDATA_DSNAP_H
+#define KMDATA_DSNAP_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+
+#define DSNAP_MAGIC         "KMDSNAP1"
+#define DSNAP_BYTE_ORDER    0x01020304
+#define DSNAP_ALIGN         8
+
+/* Hashed at write and open time to catch a mismatched hash function. */
+#define DSNAP_HASH_PROBE    "kmdata"
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    int32_t probe_hash;
+    uint64_t load;
+    uint64_t length;        /* slots */
+    uint64_t slots_offset;
+    uint64_t file_size;
+    uint64_t reserved[2];
+} dsheader_t;
+
+typedef struct {
+    int32_t hash;
+    uint32_t key_length;    /* without the NUL */
+    uint64_t offset;        /* of the record, 0 for an empty slot */
+} dsslot_t;
+
+typedef struct {
+    uint64_t value_length;
+    /* Followed by the key, its NUL, padding to DSNAP_ALIGN, then the value. */
+} dsrecord_t;
+
+typedef struct {
+    const char *map;
+    const dsslot_t *slots;
+    size_t size;
+    size_t length;
+    int32_t load;
+    int32_t (*hash)(const void *);
+} dsnap_t;
+
+/* PRIVATE FUNCTIONS */
+size_t _dsnap_pad(size_t size);
+
+int32_t _dsnap_write_record(FILE *file, dsslot_t *slots, size_t length,
+    bucket_t *bucket, uint64_t *offset,
+    const void *(*value_bytes)(const void *value, size_t *length));
+
+/* PUBLIC API */
+
+/* Writes a snapshot of dict, whose keys have to be NUL terminated strings,
+ * to path. value_bytes gives the bytes to store for a value and their
+ * length. If it's NULL, the value pointers themselves are stored, which
+ * suits values that are really integers. The file is written under a
+ * temporary name and renamed into place, so readers never see half of one.
+ * Returns 0 on success and -1 on failure. */
+int32_t dsnap_write(const char *path, dict_t *dict,
+    const void *(*value_bytes)(const void *value, size_t *length));
+
+/* Maps the snapshot at path. hash has to be the hash function of the dict
+ * it was written from. Returns 0 on success and -1 on failure. */
+int32_t dsnap_open(dsnap_t *snap, const char *path, int32_t (*hash)(const void *));
+
+/* Returns a pointer to the bytes stored for key, or NULL if key isn't in
+ * the snapshot. If length isn't NULL it gets their length. The bytes are
+ * read only and 8 byte aligned, and stay valid until dsnap_close. */
+const void *dsnap_get(dsnap_t *snap, const char *key, size_t *length);
+
+void dsnap_close(dsnap_t *snap);
+
+#endif
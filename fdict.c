@@ -0,0 +1,238 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Frozen, read only dicts on a perfect hash. */
+
+#include "fdict.h"
+
+/* Marks slots no key was sent to. Only its address matters. */
+char _fdict_empty;
+
+int32_t _fdict_hash_cmp(const void *lhs, const void *rhs){
+    int32_t a = ((const bucket_t *)lhs)->hash;
+    int32_t b = ((const bucket_t *)rhs)->hash;
+    return (a > b) - (a < b);
+}
+
+int32_t _fdict_place(fdict_t *dict, bucket_t *pairs, size_t n){
+    /* Finds a seed and pilots that give each of the n pairs, whose hashes
+     * are all different, a slot of its own, and fills in the slots. Returns
+     * -1 if there's no memory or every seed failed. */
+    size_t bits = 1;
+    while(bits < 63 && ((size_t)1 << bits) < n){
+        bits++;
+    }
+    dict->length = (size_t)(n / FDICT_ALPHA) + 1;
+    dict->buckets = (size_t)(FDICT_BUCKET_SCALE * n / bits) + 2;
+    dict->pilots = calloc(dict->buckets, sizeof(uint16_t));
+    dict->entries = malloc(dict->length * sizeof(fdentry_t));
+
+    /* Pairs grouped by bucket, and buckets from biggest to smallest. */
+    size_t *starts = malloc((dict->buckets + 1) * sizeof(size_t));
+    size_t *fill = malloc(dict->buckets * sizeof(size_t));
+    size_t *members = malloc(MAX(n, 1) * sizeof(size_t));
+    size_t *order = malloc(dict->buckets * sizeof(size_t));
+    size_t slots[64];
+    uint32_t key_hashes[64];
+
+    /* Slots taken so far. Checking these bits instead of the slots
+     * themselves keeps the pilot search in cache. */
+    size_t words = (dict->length + 63) / 64;
+    uint64_t *taken = malloc(words * sizeof(uint64_t));
+
+    int32_t ret = -1;
+    int32_t allocated = dict->pilots != NULL && dict->entries != NULL && starts != NULL
+        && fill != NULL && members != NULL && order != NULL && taken != NULL;
+    if(!allocated){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+    }
+
+    for(uint32_t attempt = 0; allocated && ret && attempt < FDICT_MAX_SEEDS; attempt++){
+        dict->seed = attempt * 0x9E3779B9 + 0x7F4A7C15;
+        memset(starts, 0, (dict->buckets + 1) * sizeof(size_t));
+        for(size_t i = 0; i < n; i++){
+            starts[_fdict_bucket(dict, pairs[i].hash) + 1]++;
+        }
+        size_t biggest = 0;
+        for(size_t b = 0; b < dict->buckets; b++){
+            biggest = MAX(biggest, starts[b + 1]);
+            starts[b + 1] += starts[b];
+            fill[b] = starts[b];
+        }
+        if(biggest > sizeof(slots) / sizeof(slots[0])){
+            continue;
+        }
+        for(size_t i = 0; i < n; i++){
+            members[fill[_fdict_bucket(dict, pairs[i].hash)]++] = i;
+        }
+        size_t count = 0;
+        for(size_t size = biggest; size > 0; size--){
+            for(size_t b = 0; b < dict->buckets; b++){
+                if(starts[b + 1] - starts[b] == size){
+                    order[count++] = b;
+                }
+            }
+        }
+
+        memset(taken, 0, words * sizeof(uint64_t));
+        ret = 0;
+        for(size_t k = 0; !ret && k < count; k++){
+            size_t b = order[k];
+            size_t size = starts[b + 1] - starts[b];
+            size_t *bucket = members + starts[b];
+            for(size_t j = 0; j < size; j++){
+                key_hashes[j] = _fdict_key_hash(dict, pairs[bucket[j]].hash);
+            }
+
+            /* Try pilots until every key in the bucket lands in a slot that
+             * is free and not wanted by another key of the bucket. */
+            uint32_t pilot;
+            for(pilot = 0; pilot <= FDICT_MAX_PILOT; pilot++){
+                uint32_t pilot_hash = _fdict_pilot_hash(dict, pilot);
+                size_t j;
+                for(j = 0; j < size; j++){
+                    slots[j] = _fdict_range(key_hashes[j] ^ pilot_hash, dict->length);
+                    if(taken[slots[j] / 64] & ((uint64_t)1 << (slots[j] % 64))){
+                        break;
+                    }
+                    size_t other;
+                    for(other = 0; other < j && slots[other] != slots[j]; other++);
+                    if(other < j){
+                        break;
+                    }
+                }
+                if(j == size){
+                    break;
+                }
+            }
+            if(pilot > FDICT_MAX_PILOT){
+                ret = -1;
+                break;
+            }
+
+            dict->pilots[b] = (uint16_t)pilot;
+            for(size_t j = 0; j < size; j++){
+                taken[slots[j] / 64] |= (uint64_t)1 << (slots[j] % 64);
+            }
+        }
+    }
+
+    for(size_t i = 0; ret == 0 && i < dict->length; i++){
+        dict->entries[i].key = &_fdict_empty;
+        dict->entries[i].data = NULL;
+        dict->entries[i].hash = 0;
+    }
+    for(size_t b = 0; ret == 0 && b < dict->buckets; b++){
+        for(size_t k = starts[b]; k < starts[b + 1]; k++){
+            bucket_t *pair = pairs + members[k];
+            fdentry_t *entry = dict->entries + _fdict_slot(dict, pair->hash, dict->pilots[b]);
+            entry->key = pair->key;
+            entry->data = pair->data;
+            entry->hash = pair->hash;
+        }
+    }
+
+    free(starts);
+    free(fill);
+    free(members);
+    free(order);
+    free(taken);
+    return ret;
+}
+
+int32_t fdict_freeze(fdict_t *frozen, dict_t *dict){
+    frozen->pilots = NULL;
+    frozen->entries = NULL;
+    frozen->hash = dict->hash;
+    frozen->eq = dict->eq;
+    frozen->buckets = 0;
+    frozen->length = 0;
+    frozen->seed = 0;
+    frozen->load = 0;
+    dict_init(&frozen->overflow, 0, dict->hash, dict->eq, DICTHT_DEFAULTS);
+
+    size_t n = 0;
+    bucket_t *pairs = malloc(MAX((size_t)dict->load, 1) * sizeof(bucket_t));
+    if(pairs == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return -1;
+    }
+    for(int32_t i = 0; DICTHT_IS_SMALL(dict) && i < dict->load; i++){
+        pairs[n++] = dict->small[i];
+    }
+    for(size_t i = 0; i < dict->length + dict->old_length; i++){
+        for(bucket_t *bucket = _dict_first_bucket(*_dict_slot_at(dict, i));
+            bucket != NULL; bucket = bucket->next){
+
+            pairs[n++] = *bucket;
+        }
+    }
+
+    /* Keys whose hash is already taken can't be told apart by the slot
+     * hash, so they go on the side. */
+    qsort(pairs, n, sizeof(bucket_t), _fdict_hash_cmp);
+    size_t unique = 0;
+    bucket_t result;
+    int32_t failed = 0;
+    for(size_t i = 0; i < n && !failed; i++){
+        if(unique > 0 && pairs[unique - 1].hash == pairs[i].hash){
+            dict_add(&frozen->overflow, pairs[i].key, pairs[i].data, &result);
+            failed = result.key == NULL;
+        }else{
+            pairs[unique++] = pairs[i];
+        }
+    }
+
+    failed = failed || _fdict_place(frozen, pairs, unique);
+    free(pairs);
+    if(failed){
+        fdict_clear(frozen, 0);
+        return -1;
+    }
+    frozen->load = (int32_t)n;
+    return 0;
+}
+
+void *fdict_get(fdict_t *dict, void *key){
+    int32_t hash = dict->hash(key);
+    size_t slot = _fdict_slot(dict, hash, dict->pilots[_fdict_bucket(dict, hash)]);
+    fdentry_t *entry = dict->entries + slot;
+    if(entry->hash != hash || FDICT_IS_EMPTY(entry)){
+        return NULL;
+    }
+    if(dict->eq(key, entry->key)){
+        return entry->data;
+    }
+    /* The slot's key has the same hash, so key might be one of the ones
+     * on the side. */
+    return dict->overflow.load > 0 ? dict_get(&dict->overflow, key) : NULL;
+}
+
+void fdict_clear(fdict_t *dict, int32_t options){
+    int32_t free_keys = options & DICTHT_FREE_KEYS;
+    int32_t free_values = options & DICTHT_FREE_VALUES;
+
+    for(size_t i = 0; dict->entries != NULL && (free_keys || free_values)
+        && i < dict->length; i++){
+
+        fdentry_t *entry = dict->entries + i;
+        if(FDICT_IS_EMPTY(entry)){
+            continue;
+        }
+        if(free_keys){
+            free(entry->key);
+        }
+        if(free_values){
+            free(entry->data);
+        }
+    }
+    dict_clear(&dict->overflow, options);
+    free(dict->pilots);
+    free(dict->entries);
+    dict->pilots = NULL;
+    dict->entries = NULL;
+    dict->buckets = 0;
+    dict->length = 0;
+    dict->load = 0;
+    dict->hash = NULL;
+    dict->eq = NULL;
+}
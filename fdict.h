@@ -0,0 +1,112 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Frozen, read only dicts on a perfect hash.
+ *
+ * fdict_freeze copies the pairs of a dict_t that won't change any more into
+ * a table with exactly one slot per key, picked by a perfect hash in the
+ * style of PTHash. Keys are split unevenly into buckets of a few keys each,
+ * and every bucket gets a 16 bit pilot, found at build time, that sends its
+ * keys to slots no other key uses. A get reads the key's pilot, then its
+ * slot, and calls eq once. There are no chains and no empty slot probing.
+ *
+ * Pilots cost about FDICT_BUCKET_SCALE * 16 / log2(n) bits per key, and
+ * the slot array has 1 / FDICT_ALPHA slots per key. The slot hash is built
+ * from the dict's 32 bit hash, so keys with the same hash as another key
+ * can't get slots of their own. The few such keys go in a plain dict_t
+ * on the side. It only gets checked when a key's slot holds a different
+ * key with the same hash, so other misses still cost one slot read.
+ */
+
+#ifndef KMDATA_FDICT_H
+#define KMDATA_FDICT_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+
+/* Constants for internal use. */
+#define FDICT_ALPHA         0.99
+#define FDICT_BUCKET_SCALE  5.0
+#define FDICT_MAX_PILOT     65535
+#define FDICT_MAX_SEEDS     16
+
+typedef struct {
+    void *key;
+    void *data;
+    int32_t hash;
+} fdentry_t;
+
+/* Slots no key was sent to have their key set to &_fdict_empty. */
+extern char _fdict_empty;
+
+#define FDICT_IS_EMPTY(entry) ((entry)->key == (void *)&_fdict_empty)
+
+typedef struct {
+    uint16_t *pilots;
+    fdentry_t *entries;
+    dict_t overflow;
+    int32_t (*hash)(const void *);
+    int32_t (*eq)(const void *, const void *);
+    size_t buckets;
+    size_t length;
+    uint32_t seed;
+    int32_t load;
+} fdict_t;
+
+/* Maps x to 0..n-1 without dividing. */
+static inline size_t _fdict_range(uint32_t x, size_t n){
+    return (size_t)(((uint64_t)x * n) >> 32);
+}
+
+static inline size_t _fdict_bucket(const fdict_t *dict, int32_t hash){
+    /* Sends about 60% of keys to the first 30% of buckets. Placing those
+     * big buckets first, while the table is nearly empty, is what makes the
+     * pilots easy to find. There are always at least 2 buckets, so both
+     * groups have some. */
+    uint32_t x = km_mix32((uint32_t)hash ^ dict->seed);
+    size_t dense = dict->buckets * 3 / 10 + 1;
+    if((x & 0xFF) < 154){
+        return _fdict_range(x, dense);
+    }
+    return dense + _fdict_range(x, dict->buckets - dense);
+}
+
+/* A key's slot is its finalized hash xored with its pilot's, scaled down
+ * to the table. The two halves are split out so building can work out each
+ * once per key and once per pilot. */
+static inline uint32_t _fdict_key_hash(const fdict_t *dict, int32_t hash){
+    return km_mix32((uint32_t)hash + dict->seed);
+}
+
+static inline uint32_t _fdict_pilot_hash(const fdict_t *dict, uint32_t pilot){
+    return km_mix32((pilot + 1) * 0x9E3779B9 ^ dict->seed);
+}
+
+static inline size_t _fdict_slot(const fdict_t *dict, int32_t hash, uint32_t pilot){
+    return _fdict_range(_fdict_key_hash(dict, hash) ^ _fdict_pilot_hash(dict, pilot),
+        dict->length);
+}
+
+/* PRIVATE FUNCTIONS */
+int32_t _fdict_hash_cmp(const void *lhs, const void *rhs);
+
+int32_t _fdict_place(fdict_t *dict, bucket_t *pairs, size_t n);
+
+/* PUBLIC API */
+
+/* Builds a frozen copy of dict, using its hash and eq. The keys and values
+ * are shared, not copied, so dict can be cleared without freeing them and
+ * the frozen copy keeps working. Returns 0, or -1 if there's no memory or
+ * no perfect hash was found, leaving frozen empty. */
+int32_t fdict_freeze(fdict_t *frozen, dict_t *dict);
+
+/* Retrieves the data value associated with the given key from the dict. */
+void *fdict_get(fdict_t *dict, void *key);
+
+/* Clear memory belonging to this dict. */
+void fdict_clear(fdict_t *dict, int32_t options);
+
+#endif
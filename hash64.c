@@ -0,0 +1,286 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * 64 bit hashing a word at a time. */
+
+#include "hash64.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HASH64_X86
+#include<immintrin.h>
+#endif
+
+#define HASH64_P1   0x9E3779B185EBCA87ULL
+#define HASH64_P2   0xC2B2AE3D27D4EB4FULL
+#define HASH64_P3   0x165667B19E3779F9ULL
+#define HASH64_P4   0x85EBCA77C2B2AE63ULL
+#define HASH64_P5   0x27D4EB2F165667C5ULL
+
+static inline uint64_t _hash64_read64(const uint8_t *p){
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint64_t _hash64_read32(const uint8_t *p){
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint64_t _hash64_rotl(uint64_t x, int32_t r){
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t _hash64_round(uint64_t acc, uint64_t input){
+    acc += input * HASH64_P2;
+    return _hash64_rotl(acc, 31) * HASH64_P1;
+}
+
+static inline uint64_t _hash64_merge(uint64_t acc, uint64_t v){
+    acc ^= _hash64_round(0, v);
+    return acc * HASH64_P1 + HASH64_P4;
+}
+
+static inline uint64_t _hash64_avalanche(uint64_t h){
+    h ^= h >> 33;
+    h *= HASH64_P2;
+    h ^= h >> 29;
+    h *= HASH64_P3;
+    h ^= h >> 32;
+    return h;
+}
+
+static inline void _hash64_short(const uint8_t *p, size_t len, uint64_t *lo, uint64_t *hi){
+    /* Reads up to 16 bytes as two words. Loads are lined up with both ends
+     * and may overlap, which is fine since len gets mixed in too. */
+    if(len >= 8){
+        *lo = _hash64_read64(p);
+        *hi = _hash64_read64(p + len - 8);
+    }else if(len >= 4){
+        *lo = _hash64_read32(p);
+        *hi = _hash64_read32(p + len - 4);
+    }else if(len > 0){
+        *lo = p[0] | (uint64_t)p[len / 2] << 8 | (uint64_t)p[len - 1] << 16;
+        *hi = 0;
+    }else{
+        *lo = *hi = 0;
+    }
+}
+
+uint64_t _hash64_portable(const void *key, size_t len, uint64_t seed){
+    /* XXH64, read little endian. */
+    const uint8_t *p = key;
+    const uint8_t *end = p + len;
+    uint64_t h;
+
+    if(len >= 32){
+        uint64_t v1 = seed + HASH64_P1 + HASH64_P2;
+        uint64_t v2 = seed + HASH64_P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HASH64_P1;
+        for(; p + 32 <= end; p += 32){
+            v1 = _hash64_round(v1, _hash64_read64(p));
+            v2 = _hash64_round(v2, _hash64_read64(p + 8));
+            v3 = _hash64_round(v3, _hash64_read64(p + 16));
+            v4 = _hash64_round(v4, _hash64_read64(p + 24));
+        }
+        h = _hash64_rotl(v1, 1) + _hash64_rotl(v2, 7) + _hash64_rotl(v3, 12)
+            + _hash64_rotl(v4, 18);
+        h = _hash64_merge(h, v1);
+        h = _hash64_merge(h, v2);
+        h = _hash64_merge(h, v3);
+        h = _hash64_merge(h, v4);
+    }else{
+        h = seed + HASH64_P5;
+    }
+
+    h += len;
+    for(; p + 8 <= end; p += 8){
+        h ^= _hash64_round(0, _hash64_read64(p));
+        h = _hash64_rotl(h, 27) * HASH64_P1 + HASH64_P4;
+    }
+    if(p + 4 <= end){
+        h ^= _hash64_read32(p) * HASH64_P1;
+        h = _hash64_rotl(h, 23) * HASH64_P2 + HASH64_P3;
+        p += 4;
+    }
+    for(; p < end; p++){
+        h ^= *p * HASH64_P5;
+        h = _hash64_rotl(h, 11) * HASH64_P1;
+    }
+    return _hash64_avalanche(h);
+}
+
+#ifdef HASH64_X86
+__attribute__((target("sse4.2")))
+uint64_t _hash64_crc32c(const void *key, size_t len, uint64_t seed){
+    /* crc32 takes 3 cycles but can start one a cycle, so three streams of
+     * words keep it busy. The streams only mix 32 bits each and CRC is
+     * linear, so the finish has to do the real mixing. */
+    const uint8_t *p = key;
+    uint64_t a = (uint32_t)seed;
+    uint64_t b = seed >> 32;
+    uint64_t c = len;
+
+    if(len <= 16){
+        /* At 8 bytes lo and hi are the same word, and crc32 of one word
+         * from two starting values differs by a constant, so a and b only
+         * carry 32 bits between them. No second crc32 of the word, rotated
+         * any amount, makes up the rest, since the pair stays linear. c
+         * takes the whole word through a multiply instead. */
+        uint64_t lo, hi;
+        _hash64_short(p, len, &lo, &hi);
+        a = _mm_crc32_u64(a, lo);
+        b = _mm_crc32_u64(b, hi);
+        c ^= hi * HASH64_P2;
+    }else{
+        /* Whole 24 byte steps, then the last 24 bytes, which may go over
+         * bytes already read. Keys under 24 bytes read 0, 8 and len - 8. */
+        const uint8_t *last = len >= 24 ? p + len - 24 : p;
+        for(; p < last; p += 24){
+            a = _mm_crc32_u64(a, _hash64_read64(p));
+            b = _mm_crc32_u64(b, _hash64_read64(p + 8));
+            c = _mm_crc32_u64(c, _hash64_read64(p + 16));
+        }
+        a = _mm_crc32_u64(a, _hash64_read64(last));
+        b = _mm_crc32_u64(b, _hash64_read64(last + 8));
+        c = _mm_crc32_u64(c, _hash64_read64((const uint8_t *)key + len - 8));
+    }
+
+    uint64_t h = (a << 32 | b) ^ _hash64_rotl(c * HASH64_P1, 29) ^ seed;
+    return _hash64_avalanche(h + len * HASH64_P5);
+}
+
+__attribute__((target("aes,sse4.1")))
+uint64_t _hash64_aes(const void *key, size_t len, uint64_t seed){
+    /* Each 16 byte block goes in as the round key of an AES round, so it's
+     * xored in after that round and mixed by the ones that follow. Past 64
+     * bytes, blocks are dealt out to four streams that run side by side.
+     * Every stream then gets two more rounds before they're xored together:
+     * after just one, a flipped bit only reaches 4 bytes, and changes in two
+     * streams cancel about one time in a hundred. Three last rounds spread
+     * every input bit over all 128. */
+    const uint8_t *p = key;
+    const uint8_t *end = p + len;
+    const __m128i k0 = _mm_set_epi64x((long long)(seed ^ HASH64_P1), (long long)(len ^ HASH64_P2));
+    const __m128i k1 = _mm_set_epi64x((long long)HASH64_P3, (long long)HASH64_P4);
+    const __m128i k2 = _mm_set_epi64x((long long)HASH64_P5, (long long)HASH64_P1);
+    __m128i s = k0;
+
+    if(len <= 16){
+        uint64_t lo, hi;
+        _hash64_short(p, len, &lo, &hi);
+        s = _mm_aesenc_si128(s, _mm_set_epi64x((long long)hi, (long long)lo));
+    }else if(len <= 64){
+        /* Whole blocks, then the last 16 bytes, which may go over bytes
+         * already read. */
+        for(; p + 16 < end; p += 16){
+            s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i *)p));
+        }
+        s = _mm_aesenc_si128(s, _mm_loadu_si128((const __m128i *)(end - 16)));
+    }else{
+        __m128i s0 = k0;
+        __m128i s1 = _mm_xor_si128(k0, k1);
+        __m128i s2 = _mm_xor_si128(k0, k2);
+        __m128i s3 = _mm_xor_si128(k1, k2);
+        for(; p + 64 < end; p += 64){
+            s0 = _mm_aesenc_si128(s0, _mm_loadu_si128((const __m128i *)p));
+            s1 = _mm_aesenc_si128(s1, _mm_loadu_si128((const __m128i *)(p + 16)));
+            s2 = _mm_aesenc_si128(s2, _mm_loadu_si128((const __m128i *)(p + 32)));
+            s3 = _mm_aesenc_si128(s3, _mm_loadu_si128((const __m128i *)(p + 48)));
+        }
+        /* 1 to 64 bytes left, taken as above, a stream at a time. */
+        for(; p + 16 < end; p += 16){
+            s0 = _mm_aesenc_si128(s0, _mm_loadu_si128((const __m128i *)p));
+            __m128i t = s0;
+            s0 = s1;
+            s1 = s2;
+            s2 = s3;
+            s3 = t;
+        }
+        s0 = _mm_aesenc_si128(s0, _mm_loadu_si128((const __m128i *)(end - 16)));
+        s0 = _mm_aesenc_si128(_mm_aesenc_si128(s0, k1), k2);
+        s1 = _mm_aesenc_si128(_mm_aesenc_si128(s1, k2), k0);
+        s2 = _mm_aesenc_si128(_mm_aesenc_si128(s2, k0), k1);
+        s3 = _mm_aesenc_si128(_mm_aesenc_si128(s3, k1), k0);
+        s = _mm_xor_si128(_mm_xor_si128(s0, s1), _mm_xor_si128(s2, s3));
+    }
+
+    s = _mm_aesenc_si128(s, k1);
+    s = _mm_aesenc_si128(s, k2);
+    s = _mm_aesenc_si128(s, k0);
+    return (uint64_t)_mm_cvtsi128_si64(s) ^ (uint64_t)_mm_extract_epi64(s, 1);
+}
+#else
+uint64_t _hash64_crc32c(const void *key, size_t len, uint64_t seed){
+    return _hash64_portable(key, len, seed);
+}
+
+uint64_t _hash64_aes(const void *key, size_t len, uint64_t seed){
+    return _hash64_portable(key, len, seed);
+}
+#endif
+
+static uint64_t (*const _hash64_variants[HASH64_VARIANTS])(const void *, size_t, uint64_t) = {
+    _hash64_portable,
+    _hash64_crc32c,
+    _hash64_aes
+};
+
+/* What hash64 calls. It starts out as _hash64_resolve, which swaps itself
+ * out for the right variant on the first call. */
+static uint64_t (*_hash64_impl)(const void *, size_t, uint64_t) = _hash64_resolve;
+
+int32_t hash64_supported(int32_t variant){
+#ifdef HASH64_X86
+    __builtin_cpu_init();
+    switch(variant){
+        case HASH64_PORTABLE:
+            return 1;
+        case HASH64_CRC32C:
+            return __builtin_cpu_supports("sse4.2") != 0;
+        case HASH64_AES:
+            return __builtin_cpu_supports("aes") && __builtin_cpu_supports("sse4.1");
+    }
+    return 0;
+#else
+    return variant == HASH64_PORTABLE;
+#endif
+}
+
+int32_t hash64_variant(){
+    /* AES first: it takes 16 bytes a step to CRC32C's 8. */
+    if(hash64_supported(HASH64_AES)){
+        return HASH64_AES;
+    }
+    if(hash64_supported(HASH64_CRC32C)){
+        return HASH64_CRC32C;
+    }
+    return HASH64_PORTABLE;
+}
+
+uint64_t _hash64_resolve(const void *key, size_t len, uint64_t seed){
+    /* Threads racing through here all store the same pointer. */
+    uint64_t (*impl)(const void *, size_t, uint64_t) = _hash64_variants[hash64_variant()];
+    __atomic_store_n(&_hash64_impl, impl, __ATOMIC_RELAXED);
+    return impl(key, len, seed);
+}
+
+uint64_t hash64(const void *key, size_t len, uint64_t seed){
+    return __atomic_load_n(&_hash64_impl, __ATOMIC_RELAXED)(key, len, seed);
+}
+
+uint64_t hash64_with(int32_t variant, const void *key, size_t len, uint64_t seed){
+    return _hash64_variants[variant](key, len, seed);
+}
+
+int32_t hash64_string_hash(const void *str){
+    uint64_t h = hash64(str, strlen((const char *)str), 0);
+    return (int32_t)(h ^ (h >> 32));
+}
+
+int32_t hash64_intptr_hash(const void *key){
+    intptr_t k = (intptr_t)key;
+    uint64_t h = hash64(&k, sizeof(k), 0);
+    return (int32_t)(h ^ (h >> 32));
+}
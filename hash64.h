@@ -0,0 +1,66 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * 64 bit hashing a word at a time.
+ *
+ * oat_hash takes one byte per step, each step waiting on the one before,
+ * and gives 32 bits. hash64 reads 8 or 16 bytes a step, several streams at
+ * once, and gives 64. There are three variants:
+ *
+ *   HASH64_PORTABLE    XXH64, in plain C. Same answers on every machine.
+ *   HASH64_CRC32C      Three streams of the SSE4.2 crc32 instruction, with a
+ *                      multiply and xorshift finish.
+ *   HASH64_AES         Four streams of AES-NI rounds, with three more rounds
+ *                      to finish.
+ *
+ * hash64 uses the fastest one the CPU has, picked the first time it's
+ * called. That means its answers can change from one machine to another,
+ * so anything that writes hashes out (like a dsnap_t snapshot) should use
+ * hash64_with and a fixed variant. The hardware variants need an x86-64
+ * build; elsewhere only HASH64_PORTABLE is supported. None of these are
+ * meant to stand up to keys picked by an attacker.
+ */
+
+#ifndef KMDATA_HASH64_H
+#define KMDATA_HASH64_H
+
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+/* Variants. */
+#define HASH64_PORTABLE     0
+#define HASH64_CRC32C       1
+#define HASH64_AES          2
+#define HASH64_VARIANTS     3
+
+/* PRIVATE FUNCTIONS */
+uint64_t _hash64_portable(const void *key, size_t len, uint64_t seed);
+
+uint64_t _hash64_crc32c(const void *key, size_t len, uint64_t seed);
+
+uint64_t _hash64_aes(const void *key, size_t len, uint64_t seed);
+
+uint64_t _hash64_resolve(const void *key, size_t len, uint64_t seed);
+
+/* PUBLIC API */
+
+/* Hashes len bytes of key with the best variant this CPU supports. */
+uint64_t hash64(const void *key, size_t len, uint64_t seed);
+
+/* Hashes with the given variant, which has to be supported. */
+uint64_t hash64_with(int32_t variant, const void *key, size_t len, uint64_t seed);
+
+/* Returns 1 if this build and CPU can run variant, 0 if not. */
+int32_t hash64_supported(int32_t variant);
+
+/* Returns the variant hash64 uses. */
+int32_t hash64_variant();
+
+/* Hash callbacks for dict_t and friends, with hash64 folded to 32 bits:
+ * hash64_string_hash in place of oat_string_hash, and hash64_intptr_hash for
+ * keys that are integers stored in the pointer. */
+int32_t hash64_string_hash(const void *str);
+
+int32_t hash64_intptr_hash(const void *key);
+
+#endif
@@ -0,0 +1,239 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Hash sets. */
+
+#include "hset.h"
+
+size_t _hset_length_for(size_t size){
+    /* The smallest table that holds size keys without going over
+     * DICTHT_MAX_LOAD. */
+    size_t length = HSET_MINIMUM_SIZE;
+    while((double)size > length * DICTHT_MAX_LOAD){
+        length <<= 1;
+    }
+    return length;
+}
+
+void hset_init(hset_t *set, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options){
+
+    set->keys = NULL;
+    set->hashes = NULL;
+    set->hash = hash;
+    set->eq = eq;
+    set->length = 0;
+    set->load = 0;
+    set->flags = options;
+    if(_hset_resize(set, _hset_length_for(size))){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+    }
+}
+
+size_t _hset_find(hset_t *set, const void *key, int32_t hash){
+    /* Returns the slot holding key, or set->length if it's not there. */
+    size_t mask = set->length - 1;
+    for(size_t i = km_mix32((uint32_t)hash) & mask; set->keys[i] != NULL; i = (i + 1) & mask){
+        if(set->hashes[i] == hash && set->eq(key, set->keys[i])){
+            return i;
+        }
+    }
+    return set->length;
+}
+
+int32_t _hset_insert(hset_t *set, void *key, int32_t hash){
+    /* Puts a key that's known not to be in the set into a set with room
+     * for it. Returns the slot it went in. */
+    size_t mask = set->length - 1;
+    size_t i = km_mix32((uint32_t)hash) & mask;
+    while(set->keys[i] != NULL){
+        i = (i + 1) & mask;
+    }
+    set->keys[i] = key;
+    set->hashes[i] = hash;
+    set->load = set->load + 1;
+    return (int32_t)i;
+}
+
+int32_t _hset_resize(hset_t *set, size_t new_size){
+    /* Moves every key into a table of new_size slots. Returns -1 with the
+     * set untouched if there's no memory. */
+    void **keys = calloc(new_size, sizeof(void *));
+    int32_t *hashes = malloc(new_size * sizeof(int32_t));
+    if(keys == NULL || hashes == NULL){
+        free(keys);
+        free(hashes);
+        return -1;
+    }
+
+    void **old_keys = set->keys;
+    int32_t *old_hashes = set->hashes;
+    size_t old_length = set->length;
+    set->keys = keys;
+    set->hashes = hashes;
+    set->length = new_size;
+    set->load = 0;
+    for(size_t i = 0; i < old_length; i++){
+        if(old_keys[i] != NULL){
+            _hset_insert(set, old_keys[i], old_hashes[i]);
+        }
+    }
+    free(old_keys);
+    free(old_hashes);
+    return 0;
+}
+
+int32_t hset_add(hset_t *set, void *key){
+    return _hset_add(set, key, set->hash(key));
+}
+
+int32_t _hset_add(hset_t *set, void *key, int32_t hash){
+    /* hset_add for callers that already have the key's hash. */
+    if(_hset_find(set, key, hash) != set->length){
+        return 0;
+    }
+
+    /* A probe has to be able to run into an empty slot, so even with
+     * DICTHT_NO_GROW one slot always stays free. */
+    if(((set->load + 1) > set->length * DICTHT_MAX_LOAD && !(set->flags & DICTHT_NO_GROW))
+        || (size_t)set->load + 1 >= set->length){
+
+        if(_hset_resize(set, set->length * DICTHT_GROW_FACTOR)){
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            return -1;
+        }
+    }
+    _hset_insert(set, key, hash);
+    return 1;
+}
+
+int32_t hset_contains(hset_t *set, const void *key){
+    return _hset_find(set, key, set->hash(key)) != set->length;
+}
+
+void *hset_get(hset_t *set, const void *key){
+    size_t i = _hset_find(set, key, set->hash(key));
+    return i == set->length ? NULL : set->keys[i];
+}
+
+void *hset_remove(hset_t *set, const void *key){
+    size_t i = _hset_find(set, key, set->hash(key));
+    if(i == set->length){
+        return NULL;
+    }
+    void *ret = set->keys[i];
+
+    /* Keys and their cached hashes move together; an empty slot is a NULL
+     * key. */
+    size_t mask = set->length - 1;
+    for(size_t j = (i + 1) & mask; set->keys[j] != NULL; j = (j + 1) & mask){
+        size_t home = km_mix32((uint32_t)set->hashes[j]) & mask;
+        if(km_probe_can_fill(i, j, home, mask)){
+            set->keys[i] = set->keys[j];
+            set->hashes[i] = set->hashes[j];
+            i = j;
+        }
+    }
+    set->keys[i] = NULL;
+    set->load = set->load - 1;
+
+    /* Check the size. Should we be using a smaller table? */
+    if(set->load < set->length * DICTHT_MIN_LOAD && !(set->flags & DICTHT_NO_SHRINK)
+        && set->length > HSET_MINIMUM_SIZE){
+
+        _hset_resize(set, set->length / DICTHT_GROW_FACTOR);
+    }
+    return ret;
+}
+
+int32_t hset_union(hset_t *rop, hset_t *lhs, hset_t *rhs){
+    hset_init(rop, (size_t)lhs->load + rhs->load, lhs->hash, lhs->eq, lhs->flags);
+    if(rop->keys == NULL){
+        return -1;
+    }
+    for(size_t i = 0; i < lhs->length; i++){
+        if(lhs->keys[i] != NULL){
+            _hset_insert(rop, lhs->keys[i], lhs->hashes[i]);
+        }
+    }
+    for(size_t i = 0; i < rhs->length; i++){
+        if(rhs->keys[i] != NULL
+            && _hset_find(rop, rhs->keys[i], rhs->hashes[i]) == rop->length){
+
+            _hset_insert(rop, rhs->keys[i], rhs->hashes[i]);
+        }
+    }
+    return 0;
+}
+
+int32_t hset_intersection(hset_t *rop, hset_t *lhs, hset_t *rhs){
+    /* Scan the smaller set and probe the bigger one. */
+    int32_t scan_lhs = lhs->load <= rhs->load;
+    hset_t *scan = scan_lhs ? lhs : rhs;
+    hset_t *probe = scan_lhs ? rhs : lhs;
+
+    hset_init(rop, (size_t)scan->load, lhs->hash, lhs->eq, lhs->flags);
+    if(rop->keys == NULL){
+        return -1;
+    }
+    for(size_t i = 0; i < scan->length; i++){
+        if(scan->keys[i] == NULL){
+            continue;
+        }
+        size_t j = _hset_find(probe, scan->keys[i], scan->hashes[i]);
+        if(j != probe->length){
+            _hset_insert(rop, scan_lhs ? scan->keys[i] : probe->keys[j], scan->hashes[i]);
+        }
+    }
+    return 0;
+}
+
+int32_t hset_difference(hset_t *rop, hset_t *lhs, hset_t *rhs){
+    hset_init(rop, (size_t)lhs->load, lhs->hash, lhs->eq, lhs->flags);
+    if(rop->keys == NULL){
+        return -1;
+    }
+    for(size_t i = 0; i < lhs->length; i++){
+        if(lhs->keys[i] != NULL
+            && _hset_find(rhs, lhs->keys[i], lhs->hashes[i]) == rhs->length){
+
+            _hset_insert(rop, lhs->keys[i], lhs->hashes[i]);
+        }
+    }
+    return 0;
+}
+
+void hset_clear(hset_t *set, int32_t options){
+    for(size_t i = 0; (options & DICTHT_FREE_KEYS) && i < set->length; i++){
+        free(set->keys[i]);
+    }
+    free(set->keys);
+    free(set->hashes);
+    set->keys = NULL;
+    set->hashes = NULL;
+    set->length = 0;
+    set->load = 0;
+    set->hash = NULL;
+    set->eq = NULL;
+}
+
+void hset_print(FILE *output, hset_t *set, void (*disp_key)(FILE *, const void *)){
+    fprintf(output, "{ ");
+    int32_t count = 0;
+    for(size_t i = 0; i < set->length; i++){
+        if(set->keys[i] != NULL){
+            disp_key(output, set->keys[i]);
+            if(++count < set->load){
+                fprintf(output, ", ");
+            }
+        }
+    }
+    fprintf(output, "} ");
+}
+
+void hset_key_set(list_t *rop, hset_t *set){
+    for(size_t i = 0; i < set->length; i++){
+        if(set->keys[i] != NULL){
+            list_addlast(rop, set->keys[i]);
+        }
+    }
+}
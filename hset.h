@@ -0,0 +1,92 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Hash sets.
+ *
+ * hset_t holds keys only, where a dict_t used as a set would carry a NULL
+ * data pointer and a malloc'd bucket per key. It's a power of two table of
+ * key pointers, probed linearly from km_mix32(hash), with the keys' hashes
+ * kept in a parallel array. That's 12 bytes a slot, and never more than
+ * 32 bytes a key at the lowest load a table shrinks to. Keeping the hashes
+ * means eq only gets called on real candidates, and resizes and the set
+ * operations never call the hash function. Removes shift later keys of the
+ * probe run back instead of leaving tombstones.
+ *
+ * Keys can't be NULL, which marks an empty slot. Hash and eq callbacks and
+ * options are the same as dict_t's.
+ */
+
+#ifndef KMDATA_HSET_H
+#define KMDATA_HSET_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+
+/* Constants for internal use. */
+#define HSET_MINIMUM_SIZE   16
+
+typedef struct {
+    void **keys;
+    int32_t *hashes;
+    int32_t (*hash)(const void *);
+    int32_t (*eq)(const void *, const void *);
+    size_t length;
+    int32_t load;
+    int32_t flags;
+} hset_t;
+
+/* PRIVATE FUNCTIONS */
+int32_t _hset_resize(hset_t *set, size_t new_size);
+
+size_t _hset_find(hset_t *set, const void *key, int32_t hash);
+
+int32_t _hset_insert(hset_t *set, void *key, int32_t hash);
+
+int32_t _hset_add(hset_t *set, void *key, int32_t hash);
+
+size_t _hset_length_for(size_t size);
+
+/* PUBLIC API */
+
+/* Initialize a new set with room for size keys. Takes the same arguments
+ * and options as dict_init. A set can't hold more keys than it has slots,
+ * so DICTHT_NO_GROW only holds off growth until it's full. */
+void hset_init(hset_t *set, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options);
+
+/* Adds key to the set. Returns 1 if it was added, 0 if an equal key was
+ * already there (which is kept), or -1 if there's no memory. */
+int32_t hset_add(hset_t *set, void *key);
+
+int32_t hset_contains(hset_t *set, const void *key);
+
+/* Returns the key in the set equal to key, or NULL if there isn't one. */
+void *hset_get(hset_t *set, const void *key);
+
+/* Takes the key equal to key out of the set and returns it, or returns NULL
+ * if there isn't one. */
+void *hset_remove(hset_t *set, const void *key);
+
+/* These initialize rop as a new set holding lhs | rhs, lhs & rhs, or
+ * lhs - rhs. lhs and rhs have to use the same hash and eq, which rop gets
+ * too. The keys are shared with lhs and rhs, not copied, and where both
+ * hold equal keys rop gets lhs's. Each is a scan of one or both sets, in
+ * time linear in their sizes, with rop sized up front. Return 0, or -1 if
+ * there's no memory, leaving rop empty. */
+int32_t hset_union(hset_t *rop, hset_t *lhs, hset_t *rhs);
+
+int32_t hset_intersection(hset_t *rop, hset_t *lhs, hset_t *rhs);
+
+int32_t hset_difference(hset_t *rop, hset_t *lhs, hset_t *rhs);
+
+/* Clear memory belonging to this set. DICTHT_FREE_KEYS frees the keys. */
+void hset_clear(hset_t *set, int32_t options);
+
+void hset_print(FILE *output, hset_t *set, void (*disp_key)(FILE *, const void *));
+
+void hset_key_set(list_t *rop, hset_t *set);
+
+#endif
@@ -0,0 +1,99 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * String interning. */
+
+#include "intern.h"
+
+int32_t _intern_eq(const void *lhs, const void *rhs){
+    /* lhs is a string being looked up, rhs an atom already in the pool. */
+    return lhs == rhs || !strcmp((const char *)lhs, (const char *)rhs);
+}
+
+void intern_init(intern_t *pool, size_t size){
+    hset_init(&pool->atoms, size, oat_string_hash, _intern_eq, DICTHT_DEFAULTS);
+    pool->chunks = NULL;
+    pool->bytes = 0;
+}
+
+atom_t *_intern_alloc(intern_t *pool, size_t size){
+    /* Carves size bytes, rounded up to a multiple of 8, out of the newest
+     * chunk. Strings too big to share a chunk get one to themselves, put
+     * behind the newest so its free space isn't lost. */
+    size = (size + 7) & ~(size_t)7;
+    ichunk_t *chunk = pool->chunks;
+    if(chunk != NULL && chunk->size - chunk->used >= size){
+        atom_t *atom = (atom_t *)(chunk->data + chunk->used);
+        chunk->used += size;
+        return atom;
+    }
+
+    size_t chunk_size = size > INTERN_CHUNK_SIZE / 4 ? size : INTERN_CHUNK_SIZE;
+    ichunk_t *fresh = malloc(sizeof(ichunk_t) + chunk_size);
+    if(fresh == NULL){
+        return NULL;
+    }
+    fresh->used = size;
+    fresh->size = chunk_size;
+    if(chunk != NULL && chunk_size == size){
+        fresh->next = chunk->next;
+        chunk->next = fresh;
+    }else{
+        fresh->next = chunk;
+        pool->chunks = fresh;
+    }
+    pool->bytes += chunk_size;
+    return (atom_t *)fresh->data;
+}
+
+char *intern_str(intern_t *pool, const char *str){
+    size_t length = strlen(str);
+    int32_t hash = oat_hash(str, length);
+    size_t i = _hset_find(&pool->atoms, str, hash);
+    if(i != pool->atoms.length){
+        return pool->atoms.keys[i];
+    }
+
+    atom_t *atom = _intern_alloc(pool, sizeof(atom_t) + length + 1);
+    if(atom == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return NULL;
+    }
+    atom->hash = hash;
+    atom->length = (uint32_t)length;
+    memcpy(atom->str, str, length + 1);
+    if(_hset_add(&pool->atoms, atom->str, hash) < 0){
+        /* The space stays in the chunk; it's only lost until intern_clear. */
+        return NULL;
+    }
+    return atom->str;
+}
+
+char *intern_find(intern_t *pool, const char *str){
+    return hset_get(&pool->atoms, str);
+}
+
+void intern_clear(intern_t *pool){
+    hset_clear(&pool->atoms, 0);
+    while(pool->chunks != NULL){
+        ichunk_t *next = pool->chunks->next;
+        free(pool->chunks);
+        pool->chunks = next;
+    }
+    pool->bytes = 0;
+}
+
+int32_t atom_hash(const void *atom){
+    return ATOM_HEADER(atom)->hash;
+}
+
+int32_t atom_eq(const void *lhs, const void *rhs){
+    return lhs == rhs;
+}
+
+int32_t atom_cmp(const void *lhs, const void *rhs){
+    return ((uintptr_t)lhs > (uintptr_t)rhs) - ((uintptr_t)lhs < (uintptr_t)rhs);
+}
+
+size_t atom_length(const void *atom){
+    return ATOM_HEADER(atom)->length;
+}
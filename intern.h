@@ -0,0 +1,90 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * String interning.
+ *
+ * An intern_t pool hands out one canonical copy, an atom, for each distinct
+ * string it sees. Atoms are plain C strings, but each one has its hash and
+ * length stored just in front of it, and two atoms from the same pool are
+ * equal exactly when they're the same pointer. A dict_t or rbtree_t keyed
+ * by atoms can use atom_hash, atom_eq and atom_cmp, which never look at the
+ * string at all, in place of oat_string_hash and strcmp. Keys repeated
+ * across many dicts are stored once.
+ *
+ * The pool is an hset_t of atoms, which are carved out of big chunks of
+ * memory rather than malloc'd one at a time. Atoms can't be freed on their
+ * own; they all go away together with intern_clear. Don't clear tables
+ * keyed by atoms with DICTHT_FREE_KEYS or RBTREE_FREE_KEYS.
+ */
+
+#ifndef KMDATA_INTERN_H
+#define KMDATA_INTERN_H
+
+#include<stddef.h>
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "hset.h"
+#include "oat.h"
+
+/* Constants for internal use. */
+#define INTERN_CHUNK_SIZE   65536
+
+typedef struct {
+    int32_t hash;           /* oat_string_hash of str */
+    uint32_t length;
+    char str[];
+} atom_t;
+
+/* The atom_t behind an atom. */
+#define ATOM_HEADER(atom) ((atom_t *)((char *)(atom) - offsetof(atom_t, str)))
+
+typedef struct _intern_chunk {
+    struct _intern_chunk *next;
+    size_t used;
+    size_t size;
+    char data[];
+} ichunk_t;
+
+typedef struct {
+    hset_t atoms;
+    ichunk_t *chunks;
+    size_t bytes;           /* total size of the chunks */
+} intern_t;
+
+/* PRIVATE FUNCTIONS */
+int32_t _intern_eq(const void *lhs, const void *rhs);
+
+atom_t *_intern_alloc(intern_t *pool, size_t size);
+
+/* PUBLIC API */
+
+/* Initialize a new pool with room for size strings. */
+void intern_init(intern_t *pool, size_t size);
+
+/* Returns the pool's atom for str, copying str into the pool the first time
+ * it's seen. Returns NULL if there's no memory. The atom must not be
+ * written to. */
+char *intern_str(intern_t *pool, const char *str);
+
+/* Returns the pool's atom for str, or NULL if str was never interned. Use
+ * this to turn a string into a key for a table keyed by atoms. */
+char *intern_find(intern_t *pool, const char *str);
+
+/* Clear memory belonging to this pool, which frees every atom in it. */
+void intern_clear(intern_t *pool);
+
+/* Callbacks for dicts and rbtrees keyed by atoms from one pool. atom_hash
+ * gives the same hash as oat_string_hash. atom_cmp orders atoms by address,
+ * which is stable but not alphabetical. Atoms are still C strings, so use
+ * strcmp where the order matters. */
+int32_t atom_hash(const void *atom);
+
+int32_t atom_eq(const void *lhs, const void *rhs);
+
+int32_t atom_cmp(const void *lhs, const void *rhs);
+
+size_t atom_length(const void *atom);
+
+#endif
@@ -1,6 +1,9 @@
 /* Ken Sheedlo
  * Simple circularly linked list implementation */
 
+#ifndef KMDATA_LIST_H
+#define KMDATA_LIST_H
+
 #include "tuple.h"
 #include "error_handling.h"
 
@@ -49,3 +52,4 @@ void list_zip(list_t *rop, list_t *op1, list_t *op2);
 void list_zipwith(list_t *rop, list_t *op1, list_t *op2,
     void *(*zip)(const void *, const void *));
 
+#endif
@@ -0,0 +1,152 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Length prefixed keys. */
+
+#include "lkey.h"
+
+#ifdef __SSE2__
+#include<emmintrin.h>
+#endif
+
+static inline uint64_t _lkey_load64(const char *p){
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+static inline uint32_t _lkey_load32(const char *p){
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+#ifdef __SSE2__
+static inline uint32_t _lkey_diff16(const char *lhs, const char *rhs){
+    /* A bit set for each of the 16 bytes that differ. */
+    __m128i a = _mm_loadu_si128((const __m128i *)lhs);
+    __m128i b = _mm_loadu_si128((const __m128i *)rhs);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^ 0xFFFF;
+}
+#endif
+
+int32_t _lkey_bytes_eq(const char *lhs, const char *rhs, size_t length){
+    /* The last load of each size is lined up with the end of the keys, and
+     * may overlap bytes already checked, so there's no byte by byte tail. */
+    if(length >= 16){
+        size_t i = 0;
+#ifdef __SSE2__
+        for(; i + 16 < length; i += 16){
+            if(_lkey_diff16(lhs + i, rhs + i)){
+                return 0;
+            }
+        }
+        return !_lkey_diff16(lhs + length - 16, rhs + length - 16);
+#else
+        for(; i + 8 < length; i += 8){
+            if(_lkey_load64(lhs + i) != _lkey_load64(rhs + i)){
+                return 0;
+            }
+        }
+        return _lkey_load64(lhs + length - 8) == _lkey_load64(rhs + length - 8);
+#endif
+    }
+    if(length >= 8){
+        return _lkey_load64(lhs) == _lkey_load64(rhs)
+            && _lkey_load64(lhs + length - 8) == _lkey_load64(rhs + length - 8);
+    }
+    if(length >= 4){
+        return _lkey_load32(lhs) == _lkey_load32(rhs)
+            && _lkey_load32(lhs + length - 4) == _lkey_load32(rhs + length - 4);
+    }
+    /* 0 to 3 bytes: these three cover every position. */
+    return length == 0 || (lhs[0] == rhs[0] && lhs[length / 2] == rhs[length / 2]
+        && lhs[length - 1] == rhs[length - 1]);
+}
+
+int32_t _lkey_bytes_cmp(const char *lhs, const char *rhs, size_t length){
+    /* memcmp's answer, as -1, 0 or 1. */
+    size_t i = 0;
+#ifdef __SSE2__
+    for(; i + 16 <= length; i += 16){
+        uint32_t diff = _lkey_diff16(lhs + i, rhs + i);
+        if(diff){
+            i += __builtin_ctz(diff);
+            return (uint8_t)lhs[i] < (uint8_t)rhs[i] ? -1 : 1;
+        }
+    }
+#endif
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Byte swapped, the first differing byte is the most significant. */
+    for(; i + 8 <= length; i += 8){
+        uint64_t a = _lkey_load64(lhs + i);
+        uint64_t b = _lkey_load64(rhs + i);
+        if(a != b){
+            return __builtin_bswap64(a) < __builtin_bswap64(b) ? -1 : 1;
+        }
+    }
+#endif
+    for(; i < length; i++){
+        if(lhs[i] != rhs[i]){
+            return (uint8_t)lhs[i] < (uint8_t)rhs[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+void lkey_init(lkey_t *key, const void *bytes, size_t length){
+    key->bytes = bytes;
+    key->length = length;
+    key->hash = 0;
+    key->flags = 0;
+}
+
+lkey_t *lkey_new(const void *bytes, size_t length){
+    lkey_t *key = malloc(sizeof(lkey_t) + length + 1);
+    if(key == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return NULL;
+    }
+    char *copy = (char *)(key + 1);
+    memcpy(copy, bytes, length);
+    copy[length] = '\0';
+    lkey_init(key, copy, length);
+    key->flags = LKEY_INLINE;
+    return key;
+}
+
+lkey_t *lkey_str(const char *str){
+    return lkey_new(str, strlen(str));
+}
+
+int32_t lkey_hash(const void *key){
+    lkey_t *k = (lkey_t *)key;
+    if(!(k->flags & LKEY_HASHED)){
+        k->hash = oat_hash(k->bytes, k->length);
+        k->flags |= LKEY_HASHED;
+    }
+    return k->hash;
+}
+
+int32_t lkey_eq(const void *lhs, const void *rhs){
+    const lkey_t *a = lhs, *b = rhs;
+    if(a->length != b->length
+        || ((a->flags & b->flags & LKEY_HASHED) && a->hash != b->hash)){
+        return 0;
+    }
+    return a == b || _lkey_bytes_eq(_lkey_bytes(a), _lkey_bytes(b), a->length);
+}
+
+int32_t lkey_cmp(const void *lhs, const void *rhs){
+    const lkey_t *a = lhs, *b = rhs;
+    size_t shorter = a->length < b->length ? a->length : b->length;
+    int32_t diff = _lkey_bytes_cmp(_lkey_bytes(a), _lkey_bytes(b), shorter);
+    if(diff){
+        return diff;
+    }
+    return (a->length > b->length) - (a->length < b->length);
+}
+
+void lkey_disp(FILE *output, const void *key){
+    const lkey_t *k = key;
+    fwrite(k->bytes, 1, k->length, output);
+}
@@ -0,0 +1,80 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Length prefixed keys.
+ *
+ * An lkey_t is a run of bytes with its length, plus its hash, worked out
+ * the first time something asks for it and kept. lkey_hash, lkey_eq and
+ * lkey_cmp are drop in callbacks for a dict_t or rbtree_t keyed by lkeys,
+ * in place of oat_string_hash, strcmp and friends. They never call strlen,
+ * they hash a key at most once, and eq turns down keys of different
+ * lengths, or with different cached hashes, before looking at any bytes.
+ * Bytes are compared 16 at a time with SSE2 where it's there, and 8 at a
+ * time otherwise.
+ *
+ * lkey_hash gives the same hash as oat_hash over the bytes, which for a
+ * string is oat_string_hash. lkey_cmp orders keys the way memcmp does, with
+ * a key that's a prefix of another first, so strings sort as with strcmp.
+ *
+ * Keys that go in a table come from lkey_new, one malloc'd block that
+ * DICTHT_FREE_KEYS and RBTREE_FREE_KEYS can free. Keys to look up with can
+ * be set up anywhere with lkey_init, which doesn't copy. Caching the hash
+ * writes to the key, so get a key's hash once with lkey_hash before sharing
+ * it between threads.
+ */
+
+#ifndef KMDATA_LKEY_H
+#define KMDATA_LKEY_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "oat.h"
+
+/* Flags for internal use. */
+#define LKEY_HASHED     1   /* hash has been worked out */
+#define LKEY_INLINE     2   /* bytes sit right behind the lkey_t */
+
+typedef struct {
+    const char *bytes;
+    size_t length;
+    int32_t hash;
+    int32_t flags;
+} lkey_t;
+
+static inline const char *_lkey_bytes(const lkey_t *key){
+    /* Keys from lkey_new keep their bytes right behind them. Going by the
+     * flag, rather than always loading key->bytes, lets the CPU guess the
+     * address and start on the bytes before the pointer comes in, which is
+     * most of the cost of a compare in a tree walk. */
+    return (key->flags & LKEY_INLINE) ? (const char *)(key + 1) : key->bytes;
+}
+
+/* PRIVATE FUNCTIONS */
+int32_t _lkey_bytes_eq(const char *lhs, const char *rhs, size_t length);
+
+int32_t _lkey_bytes_cmp(const char *lhs, const char *rhs, size_t length);
+
+/* PUBLIC API */
+
+/* Points key at length bytes, which are not copied and have to outlive it. */
+void lkey_init(lkey_t *key, const void *bytes, size_t length);
+
+/* Returns a new key holding a copy of length bytes, with a NUL after them,
+ * in a single block to free when done. Returns NULL if there's no memory. */
+lkey_t *lkey_new(const void *bytes, size_t length);
+
+/* lkey_new for a C string, without its NUL. */
+lkey_t *lkey_str(const char *str);
+
+/* Callbacks for dicts and rbtrees keyed by lkey_t pointers. */
+int32_t lkey_hash(const void *key);
+
+int32_t lkey_eq(const void *lhs, const void *rhs);
+
+int32_t lkey_cmp(const void *lhs, const void *rhs);
+
+void lkey_disp(FILE *output, const void *key);
+
+#endif
@@ -29,46 +29,43 @@ void *network_add_vx(network_t *network, void *key, void *data, bucket_t *result
     return result->data;
 }
 
-void *network_add_edge(network_t *network, void *akey, void *bkey, 
-    void *edge_data, bucket_t *result){
-    
-    /* If the edge is already there, and we overwrite it's data, the old data
-     * ptr is returned in result->data. */
-    bucket_t _result;
-    gvx_t *vxa;
-
-    /* Check that there are valid edges under akey and bkey, If not, create them */
-    if((vxa = (gvx_t *)dict_get(network, akey)) == NULL){
-        
+gvx_t *_network_vx_upsert(network_t *network, void *key){
+    /* Finds the vertex under key, creating an empty one if there isn't one
+     * yet. Only hashes and probes once either way. */
+    int32_t inserted;
+    bucket_t *bucket = dict_upsert(network, key, &inserted);
+    if(bucket == NULL){
+        return NULL;
+    }
+    if(inserted){
         gvx_t *new_vx = malloc(sizeof(*new_vx));
         if(!new_vx){
             fprintf(stderr, "Memory allocation failure.\n");
-            result->data = NULL;
-            result->key = NULL;
+            bucket_t _result;
+            dict_remove(network, key, &_result);
             return NULL;
         }
         new_vx->data = NULL;
         new_vx->edges = NULL;
         new_vx->vx_info = 0;
-
-        dict_add(network, akey, new_vx, &_result);
-        vxa = new_vx;
+        bucket->data = new_vx;
     }
+    return (gvx_t *)bucket->data;
+}
 
-    if(dict_get(network, bkey) == NULL){
-
-        gvx_t *new_vx = malloc(sizeof(*new_vx));
-        if(!new_vx){
-            fprintf(stderr, "Memory allocation failure.\n");
-            result->data = NULL;
-            result->key = NULL;
-            return NULL;
-        }
-        new_vx->data = NULL;
-        new_vx->edges = NULL;
-        new_vx->vx_info = 0;
+void *network_add_edge(network_t *network, void *akey, void *bkey, 
+    void *edge_data, bucket_t *result){
+    
+    /* If the edge is already there, and we overwrite it's data, the old data
+     * ptr is returned in result->data. */
+    gvx_t *vxa;
 
-        dict_add(network, bkey, new_vx, &_result);
+    /* Check that there are valid edges under akey and bkey, If not, create them */
+    if((vxa = _network_vx_upsert(network, akey)) == NULL
+        || _network_vx_upsert(network, bkey) == NULL){
+        result->data = NULL;
+        result->key = NULL;
+        return NULL;
     }
 
     /* Scan down vxa's edge set to make sure bkey is not already there */
@@ -2,6 +2,9 @@
  * kmdata Data Structures Library
  * Network implementation based on adjacency list. */
 
+#ifndef KMDATA_NETWORK_H
+#define KMDATA_NETWORK_H
+
 #include<stdint.h>
 #include<stdio.h>
 #include<stdlib.h>
@@ -32,6 +35,9 @@ typedef struct _gvx {
  * only, please. */
 typedef dict_t network_t;
 
+/* PRIVATE FUNCTIONS */
+gvx_t *_network_vx_upsert(network_t *network, void *key);
+
 void network_init(network_t *network, size_t size, int32_t (*hash)(const void *),
     int32_t (*eq)(const void *, const void *));
 
@@ -63,3 +69,5 @@ void network_print(FILE *output, network_t *network,
     void (*disp_edge)(FILE *output, const void *data));
 
 void network_clear(network_t *network, int32_t options);
+
+#endif
@@ -0,0 +1,328 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Open addressing dict with SSE2 control byte probing. */
+
+#include "oadict.h"
+
+#ifdef __SSE2__
+#include<emmintrin.h>
+#endif
+
+/* Group scanning. Each helper returns a bitmask with bit i set if control byte
+ * i of the 16 byte group passes the test. */
+#ifdef __SSE2__
+static inline uint32_t _oadict_match(const int8_t *group, int8_t h2){
+    __m128i ctrl = _mm_load_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+
+static inline uint32_t _oadict_match_empty(const int8_t *group){
+    return _oadict_match(group, OADICT_EMPTY);
+}
+
+static inline uint32_t _oadict_match_free(const int8_t *group){
+    /* Empty and deleted bytes are the only ones with the sign bit set. */
+    return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i *)group));
+}
+#else
+static inline uint32_t _oadict_match(const int8_t *group, int8_t h2){
+    uint32_t mask = 0;
+    for(int i = 0; i < OADICT_GROUP_WIDTH; i++){
+        mask |= (uint32_t)(group[i] == h2) << i;
+    }
+    return mask;
+}
+
+static inline uint32_t _oadict_match_empty(const int8_t *group){
+    return _oadict_match(group, OADICT_EMPTY);
+}
+
+static inline uint32_t _oadict_match_free(const int8_t *group){
+    uint32_t mask = 0;
+    for(int i = 0; i < OADICT_GROUP_WIDTH; i++){
+        mask |= (uint32_t)(group[i] < 0) << i;
+    }
+    return mask;
+}
+#endif
+
+static inline uint64_t _oadict_mix(int32_t hash){
+    /* Spread the user's 32 bit hash out. The low 7 bits become the control
+     * byte and the bits above them pick the starting group. */
+    uint64_t x = (uint64_t)(uint32_t)hash * 0x9E3779B97F4A7C15ULL;
+    return x ^ (x >> 32);
+}
+
+static inline size_t _oadict_capacity(oadict_t *dict){
+    if(dict->flags & DICTHT_NO_GROW){
+        return dict->length - 1;
+    }
+    return (size_t)(dict->length * OADICT_MAX_LOAD);
+}
+
+static size_t _oadict_find_free(const int8_t *ctrl, size_t length, uint64_t h){
+    /* Triangular probing over groups visits every group exactly once when
+     * the group count is a power of two. */
+    size_t mask = length / OADICT_GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & mask;
+    for(size_t step = 1; ; step++){
+        uint32_t free_mask = _oadict_match_free(ctrl + group * OADICT_GROUP_WIDTH);
+        if(free_mask){
+            return group * OADICT_GROUP_WIDTH + __builtin_ctz(free_mask);
+        }
+        group = (group + step) & mask;
+    }
+}
+
+static int32_t _oadict_alloc(int8_t **ctrl, oaslot_t **slots, size_t length){
+    void *block;
+    if(posix_memalign(&block, OADICT_GROUP_WIDTH, length)){
+        return -1;
+    }
+    *slots = malloc(length * sizeof(oaslot_t));
+    if(*slots == NULL){
+        free(block);
+        return -1;
+    }
+    *ctrl = block;
+    memset(*ctrl, OADICT_EMPTY, length);
+    return 0;
+}
+
+void oadict_init(oadict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options){
+    size_t length = OADICT_MINIMUM_SIZE;
+    while(length < size){
+        length <<= 1;
+    }
+
+    if(_oadict_alloc(&dict->ctrl, &dict->slots, length)){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return;
+    }
+
+    dict->hash = hash;
+    dict->eq = eq;
+    dict->length = length;
+    dict->load = 0;
+    dict->used = 0;
+    dict->flags = options;
+}
+
+size_t _oadict_find(oadict_t *dict, void *key, int32_t hash){
+    /* Returns the slot index holding key, or dict->length if it's not there. */
+    uint64_t h = _oadict_mix(hash);
+    int8_t h2 = (int8_t)(h & 0x7F);
+    size_t mask = dict->length / OADICT_GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & mask;
+
+    for(size_t step = 1; ; step++){
+        const int8_t *ctrl = dict->ctrl + group * OADICT_GROUP_WIDTH;
+        for(uint32_t m = _oadict_match(ctrl, h2); m != 0; m &= m - 1){
+            size_t index = group * OADICT_GROUP_WIDTH + __builtin_ctz(m);
+            if(dict->eq(key, dict->slots[index].key)){
+                return index;
+            }
+        }
+        if(_oadict_match_empty(ctrl)){
+            return dict->length;
+        }
+        group = (group + step) & mask;
+    }
+}
+
+void *oadict_get(oadict_t *dict, void *key){
+    size_t index = _oadict_find(dict, key, dict->hash(key));
+    if(index == dict->length){
+        return NULL;
+    }
+    return dict->slots[index].data;
+}
+
+int32_t oadict_add(oadict_t *dict, void *key, void *data, bucket_t *result){
+    int32_t hash = dict->hash(key);
+    uint64_t h = _oadict_mix(hash);
+    int8_t h2 = (int8_t)(h & 0x7F);
+    size_t mask = dict->length / OADICT_GROUP_WIDTH - 1;
+    size_t group = (size_t)(h >> 7) & mask;
+    size_t target = dict->length;
+
+    /* Probe once, looking for the key and remembering the first free slot on
+     * the way in case it isn't there. */
+    for(size_t step = 1; ; step++){
+        const int8_t *ctrl = dict->ctrl + group * OADICT_GROUP_WIDTH;
+        for(uint32_t m = _oadict_match(ctrl, h2); m != 0; m &= m - 1){
+            oaslot_t *slot = dict->slots + group * OADICT_GROUP_WIDTH + __builtin_ctz(m);
+            if(dict->eq(key, slot->key)){
+                result->key = slot->key;
+                result->data = slot->data;
+                slot->key = key;
+                slot->data = data;
+                return hash;
+            }
+        }
+        if(target == dict->length){
+            uint32_t free_mask = _oadict_match_free(ctrl);
+            if(free_mask){
+                target = group * OADICT_GROUP_WIDTH + __builtin_ctz(free_mask);
+            }
+        }
+        if(_oadict_match_empty(ctrl)){
+            break;
+        }
+        group = (group + step) & mask;
+    }
+
+    /* Taking an empty slot uses up capacity, reusing a deleted one doesn't.
+     * If we're out, either grow or just rehash in place to flush out the
+     * deleted slots. */
+    if(dict->ctrl[target] == OADICT_EMPTY && (size_t)(dict->used + 1) > _oadict_capacity(dict)){
+        size_t capacity = _oadict_capacity(dict);
+        size_t new_size = dict->length;
+        if(dict->flags & DICTHT_NO_GROW){
+            if((size_t)(dict->load + 1) > capacity){
+                new_size = dict->length * DICTHT_GROW_FACTOR;
+            }
+        }else if((size_t)(dict->load + 1) > capacity / 2){
+            new_size = dict->length * DICTHT_GROW_FACTOR;
+        }
+        _oadict_resize(dict, new_size);
+        target = _oadict_find_free(dict->ctrl, dict->length, h);
+    }
+
+    if(dict->ctrl[target] == OADICT_EMPTY){
+        dict->used = dict->used + 1;
+    }
+    dict->ctrl[target] = h2;
+    dict->slots[target].key = key;
+    dict->slots[target].data = data;
+    dict->load = dict->load + 1;
+
+    result->key = key;
+    result->data = data;
+    return hash;
+}
+
+void *oadict_remove(oadict_t *dict, void *key, bucket_t *result){
+    /* Check the size. Should we be using a smaller table? */
+    if((((double)(dict->load - 1)) / dict->length) < DICTHT_MIN_LOAD
+        && !(dict->flags & DICTHT_NO_SHRINK) && (dict->length > OADICT_MINIMUM_SIZE)){
+
+        size_t new_size = MAX((size_t)(dict->length / DICTHT_GROW_FACTOR),
+                            OADICT_MINIMUM_SIZE);
+
+        _oadict_resize(dict, new_size);
+    }
+    /* Assume no match is found initially */
+    result->key = NULL;
+    result->data = NULL;
+
+    size_t index = _oadict_find(dict, key, dict->hash(key));
+    if(index == dict->length){
+        return NULL; /* no such entry in the table */
+    }
+
+    oaslot_t *slot = dict->slots + index;
+    void *ret = slot->data;
+    result->key = slot->key;
+    result->data = ret;
+
+    /* If the slot's group still has an empty byte, no probe sequence has ever
+     * gone past it, so the slot can go straight back to empty. Otherwise leave
+     * a tombstone so later keys in the sequence can still be found. */
+    const int8_t *group = dict->ctrl + (index & ~(size_t)(OADICT_GROUP_WIDTH - 1));
+    if(_oadict_match_empty(group)){
+        dict->ctrl[index] = OADICT_EMPTY;
+        dict->used = dict->used - 1;
+    }else{
+        dict->ctrl[index] = OADICT_DELETED;
+    }
+    dict->load = dict->load - 1;
+    return ret;
+}
+
+void oadict_clear(oadict_t *dict, int32_t options){
+    int32_t free_keys = options & DICTHT_FREE_KEYS;
+    int32_t free_values = options & DICTHT_FREE_VALUES;
+
+    if(free_keys || free_values){
+        for(size_t i = 0; i < dict->length; i++){
+            if(dict->ctrl[i] >= 0){
+                if(free_keys){
+                    free(dict->slots[i].key);
+                }
+                if(free_values){
+                    free(dict->slots[i].data);
+                }
+            }
+        }
+    }
+    free(dict->ctrl);
+    free(dict->slots);
+    dict->ctrl = NULL;
+    dict->slots = NULL;
+    dict->load = 0;
+    dict->used = 0;
+    dict->length = 0;
+    dict->hash = NULL;
+    dict->eq = NULL;
+}
+
+void oadict_print(FILE *output, oadict_t *dict, void (*disp_key)(FILE *, const void *),
+    void (*disp_value)(FILE *, const void *)){
+
+    fprintf(output, "{ ");
+    int32_t count = 0;
+    for(size_t i = 0; i < dict->length; i++){
+        if(dict->ctrl[i] >= 0){
+            disp_key(output, dict->slots[i].key);
+            fprintf(output, ": ");
+            disp_value(output, dict->slots[i].data);
+            if(++count < dict->load){
+                fprintf(output, ", ");
+            }
+        }
+    }
+    fprintf(output, "} ");
+}
+
+void _oadict_resize(oadict_t *dict, size_t new_size){
+    int8_t *new_ctrl;
+    oaslot_t *new_slots;
+    if(_oadict_alloc(&new_ctrl, &new_slots, new_size)){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return;
+    }
+
+    for(size_t i = 0; i < dict->length; i++){
+        if(dict->ctrl[i] >= 0){
+            uint64_t h = _oadict_mix(dict->hash(dict->slots[i].key));
+            size_t index = _oadict_find_free(new_ctrl, new_size, h);
+            new_ctrl[index] = (int8_t)(h & 0x7F);
+            new_slots[index] = dict->slots[i];
+        }
+    }
+
+    free(dict->ctrl);
+    free(dict->slots);
+    dict->ctrl = new_ctrl;
+    dict->slots = new_slots;
+    dict->length = new_size;
+    dict->used = dict->load;
+}
+
+void oadict_key_set(list_t *rop, oadict_t *dict){
+    for(size_t i = 0; i < dict->length; i++){
+        if(dict->ctrl[i] >= 0){
+            list_addlast(rop, dict->slots[i].key);
+        }
+    }
+}
+
+void oadict_value_set(list_t *rop, oadict_t *dict){
+    for(size_t i = 0; i < dict->length; i++){
+        if(dict->ctrl[i] >= 0){
+            list_addlast(rop, dict->slots[i].data);
+        }
+    }
+}
@@ -0,0 +1,82 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Open addressing dict with SSE2 control byte probing.
+ *
+ * oadict_t is a drop-in alternative to dict_t for lookup heavy code. Keys and
+ * values live in one flat slot array, and a parallel array of control bytes
+ * records whether each slot is empty, deleted, or full (in which case the
+ * byte holds 7 bits of the key's hash). Lookups scan the control bytes of a
+ * 16 slot group at once and only call eq on slots whose byte matches, so a
+ * hit usually costs one control byte load and one slot load, and no mallocs
+ * happen on add. Options and result semantics are the same as dict_t.
+ */
+
+#ifndef KMDATA_OADICT_H
+#define KMDATA_OADICT_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+
+/* Constants for internal use. */
+#define OADICT_GROUP_WIDTH  16
+#define OADICT_MINIMUM_SIZE 16
+#define OADICT_MAX_LOAD     0.875
+
+/* Control byte states. Full slots store the low 7 bits of the hash, so they
+ * are always non-negative. */
+#define OADICT_EMPTY        ((int8_t)-128)
+#define OADICT_DELETED      ((int8_t)-2)
+
+typedef struct {
+    void *key;
+    void *data;
+} oaslot_t;
+
+typedef struct {
+    int8_t *ctrl;
+    oaslot_t *slots;
+    int32_t (*hash)(const void *);
+    int32_t (*eq)(const void *, const void *);
+    size_t length;
+    int32_t load;
+    int32_t used;   /* load plus deleted slots */
+    int32_t flags;
+} oadict_t;
+
+/* PRIVATE FUNCTIONS */
+void _oadict_resize(oadict_t *dict, size_t new_size);
+
+size_t _oadict_find(oadict_t *dict, void *key, int32_t hash);
+
+/* PUBLIC API */
+
+/* Initialize a new dict. Takes the same arguments and options as dict_init.
+ * Since an open addressing table can't hold more keys than it has slots,
+ * DICTHT_NO_GROW only holds off growth until the table is actually full. */
+void oadict_init(oadict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options);
+
+/* Adds the value with the specified key to the dict. If the key is already
+ * in the dict, return its old K-V pair in result. */
+int32_t oadict_add(oadict_t *dict, void *key, void *data, bucket_t *result);
+
+/* Retrieves the data value associated with the given key from the dict. */
+void *oadict_get(oadict_t *dict, void *key);
+
+void *oadict_remove(oadict_t *dict, void *key, bucket_t *result);
+
+/* Clear memory belonging to this dict. */
+void oadict_clear(oadict_t *dict, int32_t options);
+
+void oadict_print(FILE *output, oadict_t *dict, void (*disp_key)(FILE *, const void *),
+    void (*disp_value)(FILE *, const void *));
+
+void oadict_key_set(list_t *rop, oadict_t *dict);
+
+void oadict_value_set(list_t *rop, oadict_t *dict);
+
+#endif
@@ -10,20 +10,7 @@
 #include "oat.h"
 
 int32_t oat_hash(const void *key, size_t len){
-    const uint8_t *p = key;
-    int32_t hash = 0;
-    
-    for(int i = 0; i < len; i++){
-        hash += p[i];
-        hash += (hash << 10);
-        hash ^= (hash >> 6);
-    }
-
-    hash += (hash << 3);
-    hash ^= (hash >> 11);
-    hash += (hash << 15);
-
-    return hash;
+    return oat_hash_inline(key, len);
 }
 
 int32_t oat_string_hash(const void *str){
@@ -31,3 +18,175 @@ int32_t oat_string_hash(const void *str){
     size_t len = strlen((const char *)str);
     return oat_hash(str, len);
 }
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define OAT_X86
+#include<immintrin.h>
+#endif
+
+/* The vector versions keep one hash per 32 bit lane. Each lane's key is
+ * read 4 bytes at a time with a gather, then the 4 bytes go through the OAT
+ * steps one after another, lanes whose key has run out keeping their old
+ * hash. Keys of different lengths can share a group that way; it runs as
+ * long as its longest key. Near the end of a key, the 4 bytes read are the
+ * last 4, shifted down so the next byte is at the bottom, so no read goes
+ * past the end. That needs keys of at least 4 bytes. */
+
+#ifdef OAT_X86
+__attribute__((target("avx2")))
+void _oat_hash8_avx2(const uint8_t **keys, const size_t *lens, int32_t *hashes){
+    int32_t lens32[8];
+    size_t longest = 0;
+    for(int32_t l = 0; l < 8; l++){
+        lens32[l] = (int32_t)lens[l];
+        longest = lens[l] > longest ? lens[l] : longest;
+    }
+
+    const __m256i bytemask = _mm256_set1_epi32(0xFF);
+    const __m256i lenv = _mm256_loadu_si256((const __m256i *)lens32);
+    const __m256i last = _mm256_sub_epi32(lenv, _mm256_set1_epi32(4));
+    const __m256i lo = _mm256_loadu_si256((const __m256i *)keys);
+    const __m256i hi = _mm256_loadu_si256((const __m256i *)(keys + 4));
+    __m256i h = _mm256_setzero_si256();
+    for(size_t i = 0; i < longest; i += 4){
+        __m256i iv = _mm256_set1_epi32((int32_t)i);
+        __m256i off = _mm256_min_epi32(iv, last);
+        __m128i wlo = _mm256_i64gather_epi32(NULL, _mm256_add_epi64(lo,
+            _mm256_cvtepi32_epi64(_mm256_castsi256_si128(off))), 1);
+        __m128i whi = _mm256_i64gather_epi32(NULL, _mm256_add_epi64(hi,
+            _mm256_cvtepi32_epi64(_mm256_extracti128_si256(off, 1))), 1);
+        __m256i w = _mm256_inserti128_si256(_mm256_castsi128_si256(wlo), whi, 1);
+        w = _mm256_srlv_epi32(w, _mm256_slli_epi32(_mm256_sub_epi32(iv, off), 3));
+        for(int32_t b = 0; b < 4 && i + b < longest; b++){
+            __m256i live = _mm256_cmpgt_epi32(lenv, _mm256_set1_epi32((int32_t)(i + b)));
+            __m256i next = _mm256_add_epi32(h, _mm256_and_si256(w, bytemask));
+            next = _mm256_add_epi32(next, _mm256_slli_epi32(next, 10));
+            next = _mm256_xor_si256(next, _mm256_srai_epi32(next, 6));
+            h = _mm256_blendv_epi8(h, next, live);
+            w = _mm256_srli_epi32(w, 8);
+        }
+    }
+    h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 3));
+    h = _mm256_xor_si256(h, _mm256_srai_epi32(h, 11));
+    h = _mm256_add_epi32(h, _mm256_slli_epi32(h, 15));
+    _mm256_storeu_si256((__m256i *)hashes, h);
+}
+
+__attribute__((target("avx512f")))
+void _oat_hash16_avx512(const uint8_t **keys, const size_t *lens, int32_t *hashes){
+    int32_t lens32[16];
+    size_t longest = 0;
+    for(int32_t l = 0; l < 16; l++){
+        lens32[l] = (int32_t)lens[l];
+        longest = lens[l] > longest ? lens[l] : longest;
+    }
+
+    const __m512i bytemask = _mm512_set1_epi32(0xFF);
+    const __m512i lenv = _mm512_loadu_si512(lens32);
+    const __m512i last = _mm512_sub_epi32(lenv, _mm512_set1_epi32(4));
+    const __m512i lo = _mm512_loadu_si512(keys);
+    const __m512i hi = _mm512_loadu_si512(keys + 8);
+    __m512i h = _mm512_setzero_si512();
+    for(size_t i = 0; i < longest; i += 4){
+        __m512i iv = _mm512_set1_epi32((int32_t)i);
+        __m512i off = _mm512_min_epi32(iv, last);
+        __m256i wlo = _mm512_i64gather_epi32(_mm512_add_epi64(lo,
+            _mm512_cvtepi32_epi64(_mm512_castsi512_si256(off))), NULL, 1);
+        __m256i whi = _mm512_i64gather_epi32(_mm512_add_epi64(hi,
+            _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(off, 1))), NULL, 1);
+        __m512i w = _mm512_inserti64x4(_mm512_castsi256_si512(wlo), whi, 1);
+        w = _mm512_srlv_epi32(w, _mm512_slli_epi32(_mm512_sub_epi32(iv, off), 3));
+        for(int32_t b = 0; b < 4 && i + b < longest; b++){
+            __mmask16 live = _mm512_cmpgt_epi32_mask(lenv, _mm512_set1_epi32((int32_t)(i + b)));
+            __m512i next = _mm512_add_epi32(h, _mm512_and_si512(w, bytemask));
+            next = _mm512_add_epi32(next, _mm512_slli_epi32(next, 10));
+            next = _mm512_xor_si512(next, _mm512_srai_epi32(next, 6));
+            h = _mm512_mask_mov_epi32(h, live, next);
+            w = _mm512_srli_epi32(w, 8);
+        }
+    }
+    h = _mm512_add_epi32(h, _mm512_slli_epi32(h, 3));
+    h = _mm512_xor_si512(h, _mm512_srai_epi32(h, 11));
+    h = _mm512_add_epi32(h, _mm512_slli_epi32(h, 15));
+    _mm512_storeu_si512(hashes, h);
+}
+#endif
+
+int32_t oat_lanes(){
+#ifdef OAT_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")){
+        return 16;
+    }
+    if(__builtin_cpu_supports("avx2")){
+        return 8;
+    }
+#endif
+    return 1;
+}
+
+void _oat_hash_lanes(void **keys, const size_t *lens, int32_t *hashes, size_t n,
+    int32_t lanes){
+
+    /* Hashes whole groups of lanes keys with the vector code, and whatever
+     * is left one at a time, as are groups with a key under 4 bytes or over
+     * 2 GB, which doesn't fit a lane's length. */
+    size_t i = 0;
+#ifdef OAT_X86
+    for(; lanes > 1 && i + lanes <= n; i += lanes){
+        int32_t fits = 1;
+        for(int32_t l = 0; l < lanes; l++){
+            fits = fits && lens[i + l] >= 4 && lens[i + l] <= INT32_MAX;
+        }
+        if(!fits){
+            for(int32_t l = 0; l < lanes; l++){
+                hashes[i + l] = oat_hash(keys[i + l], lens[i + l]);
+            }
+        }else if(lanes == 16){
+            _oat_hash16_avx512((const uint8_t **)keys + i, lens + i, hashes + i);
+        }else{
+            _oat_hash8_avx2((const uint8_t **)keys + i, lens + i, hashes + i);
+        }
+    }
+#endif
+    for(; i < n; i++){
+        hashes[i] = oat_hash(keys[i], lens[i]);
+    }
+}
+
+/* Set on first use; 0 until then. */
+static int32_t _oat_best_lanes = 0;
+
+static inline int32_t _oat_cached_lanes(){
+    int32_t lanes = __atomic_load_n(&_oat_best_lanes, __ATOMIC_RELAXED);
+    if(lanes == 0){
+        lanes = oat_lanes();
+        __atomic_store_n(&_oat_best_lanes, lanes, __ATOMIC_RELAXED);
+    }
+    return lanes;
+}
+
+void oat_hash_many(void **keys, size_t len, int32_t *hashes, size_t n){
+    size_t lens[16];
+    int32_t lanes = _oat_cached_lanes();
+    for(size_t l = 0; l < 16; l++){
+        lens[l] = len;
+    }
+    /* A group at a time, so one lens array covers everything. */
+    for(size_t i = 0; i < n; i += 16){
+        size_t count = n - i < 16 ? n - i : 16;
+        _oat_hash_lanes(keys + i, lens, hashes + i, count, lanes);
+    }
+}
+
+void oat_string_hash_many(void **strs, int32_t *hashes, size_t n){
+    size_t lens[16];
+    int32_t lanes = _oat_cached_lanes();
+    for(size_t i = 0; i < n; i += 16){
+        size_t count = n - i < 16 ? n - i : 16;
+        for(size_t l = 0; l < count; l++){
+            lens[l] = strlen((const char *)strs[i + l]);
+        }
+        _oat_hash_lanes(strs + i, lens, hashes + i, count, lanes);
+    }
+}
@@ -1,6 +1,9 @@
 /* Ken Sheedlo
  * Generic adaptation of Bob Jenkins' One-at-a-Time hash for kmdata. */
 
+#ifndef KMDATA_OAT_H
+#define KMDATA_OAT_H
+
 #include<stdint.h>
 #include<stdlib.h>
 #include<string.h>
@@ -12,3 +15,67 @@ int32_t oat_hash(const void *key, size_t len);
  * a valid C string. */
 int32_t oat_string_hash(const void *str);
 
+/* Hashes a key that comes in pieces, such as the fields of a record, with
+ * no buffer to put it back together in. After oat_init, oat_update with
+ * each piece in turn, then oat_final. The answer is what oat_hash gives for
+ * all the pieces laid end to end. */
+typedef struct {
+    uint32_t hash;
+} oat_state_t;
+
+/* The adds and left shifts are done unsigned, where they wrap, and the
+ * right shifts on a signed copy, so they fill with the sign bit as they
+ * always have. */
+static inline void oat_init(oat_state_t *state){
+    state->hash = 0;
+}
+
+static inline void oat_update(oat_state_t *state, const void *key, size_t len){
+    const uint8_t *p = key;
+    uint32_t hash = state->hash;
+    for(size_t i = 0; i < len; i++){
+        hash += p[i];
+        hash += (hash << 10);
+        hash ^= (uint32_t)((int32_t)hash >> 6);
+    }
+    state->hash = hash;
+}
+
+static inline int32_t oat_final(const oat_state_t *state){
+    uint32_t hash = state->hash;
+    hash += (hash << 3);
+    hash ^= (uint32_t)((int32_t)hash >> 11);
+    hash += (hash << 15);
+    return (int32_t)hash;
+}
+
+/* Inline versions of the above, for code that wants the compiler to see the
+ * hash, such as tables generated with KM_DICT_DEFINE. Same results. */
+static inline int32_t oat_hash_inline(const void *key, size_t len){
+    oat_state_t state;
+    oat_init(&state);
+    oat_update(&state, key, len);
+    return oat_final(&state);
+}
+
+static inline int32_t oat_string_hash_inline(const void *str){
+    return oat_hash_inline(str, strlen((const char *)str));
+}
+
+/* Hashes n keys at a time, each len bytes long or a C string, storing the
+ * results in hashes. The answers are the same as oat_hash and
+ * oat_string_hash would give, but where the CPU has AVX2 or AVX-512, 8 or
+ * 16 keys go through the byte loop at once, one per vector lane. */
+void oat_hash_many(void **keys, size_t len, int32_t *hashes, size_t n);
+
+void oat_string_hash_many(void **strs, int32_t *hashes, size_t n);
+
+/* How many keys the _many functions hash at once: 16, 8, or 1 without
+ * vector support. */
+int32_t oat_lanes();
+
+/* PRIVATE FUNCTIONS */
+void _oat_hash_lanes(void **keys, const size_t *lens, int32_t *hashes, size_t n,
+    int32_t lanes);
+
+#endif
@@ -0,0 +1,239 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Insertion ordered compact dict. */
+
+#include "odict.h"
+
+/* Marks holes left by removes. Only its address matters. */
+char _odict_deleted;
+
+int32_t _odict_capacity(size_t length){
+    /* Keeping the index at most 2/3 full keeps probe runs short. */
+    return (int32_t)(length * 2 / 3);
+}
+
+void odict_init(odict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options){
+    size_t length = ODICT_MINIMUM_SIZE;
+    while((size_t)_odict_capacity(length) < size){
+        length <<= 1;
+    }
+
+    dict->index = NULL;
+    dict->entries = NULL;
+    dict->hash = hash;
+    dict->eq = eq;
+    dict->length = 0;
+    dict->used = 0;
+    dict->load = 0;
+    dict->flags = options;
+    if(_odict_resize(dict, length)){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+    }
+}
+
+size_t _odict_find(odict_t *dict, void *key, int32_t hash){
+    /* Returns the index slot pointing at key's pair, or dict->length if it's
+     * not there. */
+    size_t mask = dict->length - 1;
+    for(size_t i = km_mix32((uint32_t)hash) & mask; dict->index[i] != ODICT_EMPTY;
+        i = (i + 1) & mask){
+
+        odentry_t *entry = dict->entries + dict->index[i];
+        if(entry->hash == hash && dict->eq(key, entry->key)){
+            return i;
+        }
+    }
+    return dict->length;
+}
+
+void *odict_get(odict_t *dict, void *key){
+    size_t i = _odict_find(dict, key, dict->hash(key));
+    if(i == dict->length){
+        return NULL;
+    }
+    return dict->entries[dict->index[i]].data;
+}
+
+int32_t odict_add(odict_t *dict, void *key, void *data, bucket_t *result){
+    int32_t hash = dict->hash(key);
+    size_t i = _odict_find(dict, key, hash);
+    if(i != dict->length){
+        odentry_t *entry = dict->entries + dict->index[i];
+        result->key = entry->key;
+        result->data = entry->data;
+        entry->key = key;
+        entry->data = data;
+        return hash;
+    }
+
+    if(dict->used == _odict_capacity(dict->length)){
+        /* Out of room at the end of the array. If removes left enough holes,
+         * squeezing them out at the same size is enough. With DICTHT_NO_GROW
+         * any hole at all is enough. */
+        size_t new_size = dict->length;
+        int32_t room = (dict->flags & DICTHT_NO_GROW) ? dict->used : dict->used / 2;
+        if(dict->load + 1 > room){
+            new_size = dict->length * DICTHT_GROW_FACTOR;
+        }
+        if(_odict_resize(dict, new_size)){
+            fprintf(stderr, "%s\n", "Memory allocation failure.");
+            result->key = NULL;
+            return -1;
+        }
+    }
+
+    size_t mask = dict->length - 1;
+    for(i = km_mix32((uint32_t)hash) & mask; dict->index[i] != ODICT_EMPTY;
+        i = (i + 1) & mask);
+
+    odentry_t *entry = dict->entries + dict->used;
+    entry->key = key;
+    entry->data = data;
+    entry->hash = hash;
+    dict->index[i] = dict->used;
+    dict->used = dict->used + 1;
+    dict->load = dict->load + 1;
+
+    result->key = key;
+    result->data = data;
+    return hash;
+}
+
+void *odict_remove(odict_t *dict, void *key, bucket_t *result){
+    /* Check the size. Should we be using a smaller table? */
+    if((((double)(dict->load - 1)) / _odict_capacity(dict->length)) < DICTHT_MIN_LOAD
+        && !(dict->flags & DICTHT_NO_SHRINK) && (dict->length > ODICT_MINIMUM_SIZE)){
+
+        _odict_resize(dict, dict->length / DICTHT_GROW_FACTOR);
+    }
+    /* Assume no match is found initially */
+    result->key = NULL;
+    result->data = NULL;
+
+    size_t i = _odict_find(dict, key, dict->hash(key));
+    if(i == dict->length){
+        return NULL; /* no such entry in the table */
+    }
+
+    odentry_t *entry = dict->entries + dict->index[i];
+    void *ret = entry->data;
+    result->key = entry->key;
+    result->data = ret;
+    entry->key = &_odict_deleted;
+    entry->data = NULL;
+
+    /* The entry stays behind as a hole so the order holds; only the index
+     * closes up. Offsets move, and each one's home comes from the hash
+     * kept in its entry. */
+    size_t mask = dict->length - 1;
+    for(size_t j = (i + 1) & mask; dict->index[j] != ODICT_EMPTY; j = (j + 1) & mask){
+        size_t home = km_mix32((uint32_t)dict->entries[dict->index[j]].hash) & mask;
+        if(km_probe_can_fill(i, j, home, mask)){
+            dict->index[i] = dict->index[j];
+            i = j;
+        }
+    }
+    dict->index[i] = ODICT_EMPTY;
+    dict->load = dict->load - 1;
+    return ret;
+}
+
+int32_t _odict_resize(odict_t *dict, size_t new_size){
+    /* Packs the pairs down to the front of a new array, dropping holes, and
+     * rebuilds the index over them. Returns -1 with the dict untouched if
+     * there's no memory. */
+    int32_t *index = malloc(new_size * sizeof(int32_t));
+    odentry_t *entries = malloc(_odict_capacity(new_size) * sizeof(odentry_t));
+    if(index == NULL || entries == NULL){
+        free(index);
+        free(entries);
+        return -1;
+    }
+    memset(index, 0xFF, new_size * sizeof(int32_t));
+
+    size_t mask = new_size - 1;
+    int32_t used = 0;
+    for(int32_t e = 0; e < dict->used; e++){
+        odentry_t *entry = dict->entries + e;
+        if(ODICT_IS_DELETED(entry)){
+            continue;
+        }
+        size_t i = km_mix32((uint32_t)entry->hash) & mask;
+        while(index[i] != ODICT_EMPTY){
+            i = (i + 1) & mask;
+        }
+        index[i] = used;
+        entries[used++] = *entry;
+    }
+
+    free(dict->index);
+    free(dict->entries);
+    dict->index = index;
+    dict->entries = entries;
+    dict->length = new_size;
+    dict->used = used;
+    return 0;
+}
+
+void odict_clear(odict_t *dict, int32_t options){
+    int32_t free_keys = options & DICTHT_FREE_KEYS;
+    int32_t free_values = options & DICTHT_FREE_VALUES;
+
+    for(int32_t e = 0; (free_keys || free_values) && e < dict->used; e++){
+        odentry_t *entry = dict->entries + e;
+        if(ODICT_IS_DELETED(entry)){
+            continue;
+        }
+        if(free_keys){
+            free(entry->key);
+        }
+        if(free_values){
+            free(entry->data);
+        }
+    }
+    free(dict->index);
+    free(dict->entries);
+    dict->index = NULL;
+    dict->entries = NULL;
+    dict->length = 0;
+    dict->used = 0;
+    dict->load = 0;
+    dict->hash = NULL;
+    dict->eq = NULL;
+}
+
+void odict_print(FILE *output, odict_t *dict, void (*disp_key)(FILE *, const void *),
+    void (*disp_value)(FILE *, const void *)){
+
+    fprintf(output, "{ ");
+    int32_t count = 0;
+    for(int32_t e = 0; e < dict->used; e++){
+        odentry_t *entry = dict->entries + e;
+        if(!ODICT_IS_DELETED(entry)){
+            disp_key(output, entry->key);
+            fprintf(output, ": ");
+            disp_value(output, entry->data);
+            if(++count < dict->load){
+                fprintf(output, ", ");
+            }
+        }
+    }
+    fprintf(output, "} ");
+}
+
+void odict_key_set(list_t *rop, odict_t *dict){
+    for(int32_t e = 0; e < dict->used; e++){
+        if(!ODICT_IS_DELETED(dict->entries + e)){
+            list_addlast(rop, dict->entries[e].key);
+        }
+    }
+}
+
+void odict_value_set(list_t *rop, odict_t *dict){
+    for(int32_t e = 0; e < dict->used; e++){
+        if(!ODICT_IS_DELETED(dict->entries + e)){
+            list_addlast(rop, dict->entries[e].data);
+        }
+    }
+}
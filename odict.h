@@ -0,0 +1,96 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Insertion ordered compact dict.
+ *
+ * odict_t keeps its pairs in one dense array, in the order they were first
+ * added, with a separate power of two index table of int32_t offsets into
+ * it. The index is probed linearly and is the only part with empty slots, so
+ * a pair costs 24 bytes in the array plus 6 to 12 bytes of index, against a
+ * malloc'd 32 byte bucket plus its slot in dict_t. Iteration (odict_print,
+ * odict_key_set, odict_value_set) is a scan of the pair array in insertion
+ * order.
+ *
+ * Removing a pair leaves a hole in the array, so order is kept without
+ * moving anything. Holes are squeezed out the next time the index is
+ * rebuilt. Overwriting a key keeps its place. Options and result semantics
+ * are the same as dict_t.
+ */
+
+#ifndef KMDATA_ODICT_H
+#define KMDATA_ODICT_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+
+/* Constants for internal use. */
+#define ODICT_MINIMUM_SIZE  8
+
+/* Index slot states. Anything else is an offset into entries. */
+#define ODICT_EMPTY         (-1)
+
+typedef struct {
+    void *key;
+    void *data;
+    int32_t hash;
+} odentry_t;
+
+/* Removed pairs have their key set to &_odict_deleted. */
+extern char _odict_deleted;
+
+#define ODICT_IS_DELETED(entry) ((entry)->key == (void *)&_odict_deleted)
+
+typedef struct {
+    int32_t *index;
+    odentry_t *entries;
+    int32_t (*hash)(const void *);
+    int32_t (*eq)(const void *, const void *);
+    size_t length;      /* index slots */
+    int32_t used;       /* entries filled in, holes included */
+    int32_t load;
+    int32_t flags;
+} odict_t;
+
+/* PRIVATE FUNCTIONS */
+int32_t _odict_capacity(size_t length);
+
+int32_t _odict_resize(odict_t *dict, size_t new_size);
+
+size_t _odict_find(odict_t *dict, void *key, int32_t hash);
+
+/* PUBLIC API */
+
+/* Initialize a new dict. Takes the same arguments and options as dict_init.
+ * When the pair array runs out of room, removed pairs are squeezed out at
+ * the same size if that frees up at least half of it, and it grows if not.
+ * With DICTHT_NO_GROW it's squeezed as long as any pair has been removed,
+ * and only grows once every place holds a live pair. */
+void odict_init(odict_t *dict, size_t size, int32_t (*hash)(const void *),
+    int32_t (*eq)(const void *, const void *), int32_t options);
+
+/* Adds the value with the specified key to the dict. If the key is already
+ * in the dict, return its old K-V pair in result. The key keeps its place in
+ * the order. */
+int32_t odict_add(odict_t *dict, void *key, void *data, bucket_t *result);
+
+/* Retrieves the data value associated with the given key from the dict. */
+void *odict_get(odict_t *dict, void *key);
+
+void *odict_remove(odict_t *dict, void *key, bucket_t *result);
+
+/* Clear memory belonging to this dict. */
+void odict_clear(odict_t *dict, int32_t options);
+
+void odict_print(FILE *output, odict_t *dict, void (*disp_key)(FILE *, const void *),
+    void (*disp_value)(FILE *, const void *));
+
+/* Appends the keys to rop in insertion order. */
+void odict_key_set(list_t *rop, odict_t *dict);
+
+/* Appends the values to rop in insertion order. */
+void odict_value_set(list_t *rop, odict_t *dict);
+
+#endif
@@ -2,6 +2,9 @@
  * kmdata Data Structures Library
  * Parallel Mapping List */
 
+#ifndef KMDATA_PLIST_H
+#define KMDATA_PLIST_H
+
 #include "tuple.h"
 
 #define PL_ALLOW_IMBALANCE      1
@@ -62,3 +65,4 @@ void *plist_reduce(plist_t *op, void *(*rfunc)(const void *, const void *),
 
 void plist_to_list(list_t *rop, plist_t *op);
 
+#endif
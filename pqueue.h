@@ -2,6 +2,9 @@
  * kmdata Data Structures Library
  * Priority Queue implementation */
 
+#ifndef KMDATA_PQUEUE_H
+#define KMDATA_PQUEUE_H
+
 #include<stdio.h>
 #include<stdint.h>
 #include<stdlib.h>
@@ -21,3 +24,4 @@ void *pqueue_deletemin(pqueue_t *queue);
 
 void *pqueue_findmin(pqueue_t *queue);
 
+#endif
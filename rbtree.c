@@ -10,32 +10,31 @@ void rbt_init(rbtree_t *tree, int32_t (*cmp)(const void *, const void *)){
 }
 
 void rbt_clear(rbtree_t *tree, int32_t options){
-    /* Do a recursive clear in post order */
-    _rbt_rclear(tree->root, options);
+    /* Frees nodes with no left child as they come up, rotating the left
+     * child up in place of any that have one. Every rotation puts one more
+     * node on the right spine for good, so this is O(n) with no stack. */
+    rbnode_t *node = tree->root;
+    while(node != NULL){
+        rbnode_t *save = _rbnode_child(node, LEFT);
+        if(save == NULL){
+            save = _rbnode_child(node, RIGHT);
+            if(options & RBTREE_FREE_KEYS){
+                free(node->key);
+            }
+            if(options & RBTREE_FREE_VALUES){
+                free(node->data);
+            }
+            free(node);
+        }else{
+            _rbnode_set_child(node, LEFT, _rbnode_child(save, RIGHT));
+            _rbnode_set_child(save, RIGHT, node);
+        }
+        node = save;
+    }
     tree->root = NULL;
     tree->size = 0;
 }
 
-void _rbt_rclear(rbnode_t *node, int32_t options){
-    if(node == NULL){
-        return;
-    }
-
-    _rbt_rclear(node->child[LEFT], options);
-    _rbt_rclear(node->child[RIGHT], options);
-
-    int32_t free_keys = options & RBTREE_FREE_KEYS, 
-        free_values = options & RBTREE_FREE_VALUES;
-
-    if(free_keys){
-        free(node->key);
-    }
-    if(free_values){
-        free(node->data);
-    }
-    free(node);
-}
-
 rbnode_t *rbt_getnode(rbtree_t *tree, void *key){
     /* Looks up key in the tree and returns the node containing it, or NULL if
      * no such node is an elt of the tree */
@@ -45,7 +44,7 @@ rbnode_t *rbt_getnode(rbtree_t *tree, void *key){
         if(diff == 0){
             return node;
         }
-        node = node->child[(diff > 0)]; /* RIGHT if greater, LEFT otherwise */
+        node = _rbnode_child(node, (diff > 0)); /* RIGHT if greater, LEFT otherwise */
     }
     return NULL;
 }
@@ -54,65 +53,89 @@ uint8_t rbt_color(rbnode_t *node){
     if(node == NULL){
         return BLACK;
     }
-    return node->color;
+    return _rbnode_color(node);
 }
 
-rbnode_t *_rbt_insert_r(rbnode_t *root, rbtree_t *tree, void *key, 
-                            void *data, rbnode_t *result){
-    if(root == NULL){
-        root = malloc(sizeof(rbnode_t));
-        if(root == NULL){
-            fprintf(stderr, "%s\n", "Memory allocation failure.");
-            return NULL;
-        }
+rbnode_t *_rbt_node_new(rbtree_t *tree, void *key, void *data){
+    rbnode_t *node = malloc(sizeof(rbnode_t));
+    if(node == NULL){
+        fprintf(stderr, "%s\n", "Memory allocation failure.");
+        return NULL;
+    }
+    node->key = key;
+    node->data = data;
+    node->child[LEFT] = node->child[RIGHT] = 0;
+    _rbnode_set_color(node, RED);
+    tree->size = tree->size + 1;
+    return node;
+}
 
-        root->key = key;
-        root->data = data;
-        root->tree = tree;
-        tree->size = tree->size + 1;
-        root->color = RED;
-        root->child[LEFT] = root->child[RIGHT] = NULL;
-
-        result->key = key;
-        result->data = data;
-    }else{
-        /* Keys match. Overwrite and store the old K,V pair */
-        int32_t diff = tree->cmp(root->key, key);
-        int32_t dir;
-        if(diff == 0){
-            result->key = root->key;
-            result->data = root->data;
-            root->key = key;
-            root->data = data;
-            return root;
-        }else{
-            dir = diff < 0;
-        }
+void *rbt_insert(rbtree_t *tree, void *key, void *data, rbnode_t *result){
+    /* Top down, in one pass: on the way to the key, any node with two red
+     * children gets a color flip, and a red node under a red parent gets
+     * rotated up past its grandparent. By the time the key is found or its
+     * node hung off the bottom, nothing is left to fix on the way back up.
+     * head stands in for the root's parent. */
+    rbnode_t head = {{0, 0}};
+    rbnode_t *t = &head, *g = NULL, *p = NULL, *q = tree->root;
+    int32_t dir = RIGHT, last = RIGHT, inserted = 0;
 
-        root->child[dir] = _rbt_insert_r(root->child[dir], tree, key, data, result);
+    result->key = NULL;
+    result->data = NULL;
+    _rbnode_set_child(&head, RIGHT, q);
+    for(;;){
+        if(q == NULL){
+            q = _rbt_node_new(tree, key, data);
+            if(q == NULL){
+                break;
+            }
+            _rbnode_set_child(p == NULL ? &head : p, dir, q);
+            inserted = 1;
+        }else if(rbt_color(_rbnode_child(q, LEFT)) == RED
+            && rbt_color(_rbnode_child(q, RIGHT)) == RED){
+            _rbnode_set_color(q, RED);
+            _rbnode_set_color(_rbnode_child(q, LEFT), BLACK);
+            _rbnode_set_color(_rbnode_child(q, RIGHT), BLACK);
+        }
 
-        if(rbt_color(root->child[dir]) == RED){
-            if(rbt_color(root->child[!dir]) == RED){
-                root->color = RED;
-                root->child[LEFT]->color = BLACK;
-                root->child[RIGHT]->color = BLACK;
+        if(rbt_color(q) == RED && rbt_color(p) == RED){
+            int32_t dir2 = _rbnode_child(t, RIGHT) == g;
+            if(q == _rbnode_child(p, last)){
+                _rbnode_set_child(t, dir2, _rbt_rotates(g, !last));
             }else{
-                if(rbt_color(root->child[dir]->child[dir]) == RED){
-                    root = _rbt_rotates(root, !dir);
-                }else if(rbt_color(root->child[dir]->child[!dir]) == RED){
-                    root = _rbt_rotated(root, !dir);
-                }
+                _rbnode_set_child(t, dir2, _rbt_rotated(g, !last));
             }
         }
+
+        if(inserted){
+            result->key = key;
+            result->data = data;
+            break;
+        }
+        int32_t diff = tree->cmp(q->key, key);
+        if(diff == 0){
+            /* Keys match. Overwrite and store the old K,V pair */
+            result->key = q->key;
+            result->data = q->data;
+            q->key = key;
+            q->data = data;
+            break;
+        }
+
+        last = dir;
+        dir = diff < 0;
+        if(g != NULL){
+            t = g;
+        }
+        g = p;
+        p = q;
+        q = _rbnode_child(q, dir);
     }
-    return root;
-}
 
-void *rbt_insert(rbtree_t *tree, void *key, void *data, rbnode_t *result){
-    result->key = NULL;
-    result->data = NULL;
-    tree->root = _rbt_insert_r(tree->root, tree, key, data, result);
-    tree->root->color = BLACK;
+    tree->root = _rbnode_child(&head, RIGHT);
+    if(tree->root != NULL){
+        _rbnode_set_color(tree->root, BLACK);
+    }
     return result->data;
 }
 
@@ -126,29 +149,94 @@ void *rbt_get(rbtree_t *tree, void *key){
 }
 
 void *rbt_remove(rbtree_t *tree, void *key, rbnode_t *result){
+    /* Top down, in one pass: a red node is pushed down ahead of the search,
+     * by color flips and rotations, so the node that finally comes out is
+     * red, or has a red child, and taking it out breaks nothing. The search
+     * keeps going past a match to its in order predecessor, whose pair is
+     * moved into the match before the predecessor's node is unlinked. */
+    rbnode_t head = {{0, 0}};
+    rbnode_t *q = &head, *p = NULL, *g = NULL, *found = NULL;
+    int32_t dir = RIGHT;
+
     result->data = NULL;
     result->key = NULL;
-    result->color = WORKING;
+    _rbnode_set_child(&head, RIGHT, tree->root);
+    while(_rbnode_child(q, dir) != NULL){
+        int32_t last = dir;
+        g = p;
+        p = q;
+        q = _rbnode_child(q, dir);
+
+        int32_t diff = tree->cmp(q->key, key);
+        if(diff == 0){
+            found = q;
+        }
+        dir = diff < 0;
+
+        if(rbt_color(q) == RED || rbt_color(_rbnode_child(q, dir)) == RED){
+            continue;
+        }
+        if(rbt_color(_rbnode_child(q, !dir)) == RED){
+            _rbnode_set_child(p, last, _rbt_rotates(q, dir));
+            p = _rbnode_child(p, last);
+            continue;
+        }
 
-    tree->root = _rbt_remove_r(tree->root, key, result);
-    if(result->data != NULL){
+        rbnode_t *s = _rbnode_child(p, !last);
+        if(s == NULL){
+            continue;
+        }
+        if(rbt_color(_rbnode_child(s, LEFT)) == BLACK
+            && rbt_color(_rbnode_child(s, RIGHT)) == BLACK){
+            _rbnode_set_color(p, BLACK);
+            _rbnode_set_color(s, RED);
+            _rbnode_set_color(q, RED);
+        }else{
+            int32_t dir2 = _rbnode_child(g, RIGHT) == p;
+            if(rbt_color(_rbnode_child(s, last)) == RED){
+                _rbnode_set_child(g, dir2, _rbt_rotated(p, last));
+            }else{
+                _rbnode_set_child(g, dir2, _rbt_rotates(p, last));
+            }
+            rbnode_t *top = _rbnode_child(g, dir2);
+            _rbnode_set_color(q, RED);
+            _rbnode_set_color(top, RED);
+            _rbnode_set_color(_rbnode_child(top, LEFT), BLACK);
+            _rbnode_set_color(_rbnode_child(top, RIGHT), BLACK);
+        }
+    }
+
+    if(found != NULL){
+        result->key = found->key;
+        result->data = found->data;
+        found->key = q->key;
+        found->data = q->data;
+        _rbnode_set_child(p, _rbnode_child(p, RIGHT) == q,
+            _rbnode_child(q, _rbnode_child(q, LEFT) == NULL));
+        free(q);
         tree->size = tree->size - 1;
     }
+
+    tree->root = _rbnode_child(&head, RIGHT);
     if(tree->root != NULL){
-        tree->root->color = BLACK;
+        _rbnode_set_color(tree->root, BLACK);
     }
-
     return result->data;
 }
 
-int32_t _rbnode_assert(rbnode_t *node){
+int32_t _rbnode_assert(rbtree_t *tree, rbnode_t *node){
     int32_t lh, rh;
 
     if(node == NULL){
         return 1;
     }
-    rbtree_t *tree = node->tree;
-    rbnode_t *lnode = node->child[LEFT], *rnode = node->child[RIGHT];
+    rbnode_t *lnode = _rbnode_child(node, LEFT), *rnode = _rbnode_child(node, RIGHT);
+
+    /* Only the left link carries a color */
+    if(node->child[RIGHT] & RBNODE_COLOR){
+        fprintf(stderr, "Link violation\n");
+        return 0;
+    }
 
     /* Consecutive red links test */
     if(rbt_color(node) == RED){
@@ -158,8 +246,8 @@ int32_t _rbnode_assert(rbnode_t *node){
         }
     }
 
-    lh = _rbnode_assert(lnode);
-    rh = _rbnode_assert(rnode);
+    lh = _rbnode_assert(tree, lnode);
+    rh = _rbnode_assert(tree, rnode);
 
     /* Check to make sure this is a valid BST */
     if((lnode != NULL && tree->cmp(lnode->key, node->key) > 0)
@@ -167,7 +255,7 @@ int32_t _rbnode_assert(rbnode_t *node){
         fprintf(stderr, "Binary tree violation\n");
         return 0;
     }
-    
+
     /* Check for a black height mismatch */
     if(lh != 0 && rh != 0 && lh != rh){
         fprintf(stderr, "Black violation\n");
@@ -182,134 +270,35 @@ int32_t _rbnode_assert(rbnode_t *node){
 
 int32_t rbt_assert(rbtree_t *tree){
     /* Perform node assertions on the root of the tree recursively */
-    return _rbnode_assert(tree->root);
+    return _rbnode_assert(tree, tree->root);
 }
 
 rbnode_t *_rbt_rotates(rbnode_t *root, int32_t dir){
     /* Single rotation around the root, in the requested direction. */
-    rbnode_t *save = root->child[!dir];
-    
-    root->child[!dir] = save->child[dir];
-    save->child[dir] = root;
+    rbnode_t *save = _rbnode_child(root, !dir);
+
+    _rbnode_set_child(root, !dir, _rbnode_child(save, dir));
+    _rbnode_set_child(save, dir, root);
 
-    root->color = RED;
-    save->color = BLACK;
+    _rbnode_set_color(root, RED);
+    _rbnode_set_color(save, BLACK);
 
     return save;
 }
 
 rbnode_t *_rbt_rotated(rbnode_t *root, int32_t dir){
     /* Same as _rbt_rotates, but now a double rotation. */
-    root->child[!dir] = _rbt_rotates(root->child[!dir], !dir);
+    _rbnode_set_child(root, !dir, _rbt_rotates(_rbnode_child(root, !dir), !dir));
     return _rbt_rotates(root, dir);
 }
 
-rbnode_t *_rbt_remove_r(rbnode_t *root, void *key, rbnode_t *result){
-    void *save_key = NULL, *save_data = NULL;
-    int32_t data_saved = 0;
-
-    if(root == NULL){
-        result->color = DONE;
-    }else{
-        int32_t dir;
-        int32_t diff = root->tree->cmp(root->key, key);
-
-        if(diff == 0){
-            save_data = root->data;
-            save_key = root->key;
-            data_saved = 1;
-            if(root->child[LEFT] == NULL || root->child[RIGHT] == NULL){
-                rbnode_t *save = root->child[(root->child[0] == NULL)];
-                
-                if(rbt_color(root) == RED){
-                    result->color = DONE;
-                }else if(rbt_color(save) == RED){
-                    save->color = BLACK;
-                    result->color = DONE;
-                }
-
-                free(root);
-                result->key = save_key;
-                result->data = save_data;
-                return save;
-            }else{
-                rbnode_t *heir = root->child[LEFT];
-
-                while(heir->child[RIGHT] != NULL){
-                    heir = heir->child[RIGHT];
-                }
-                
-                root->data = heir->data;
-                root->key = heir->key;
-                key = heir->key;
-            }
-        }
-
-        dir = root->tree->cmp(root->key, key) < 0;
-        root->child[dir] = _rbt_remove_r(root->child[dir], key, result);
-
-        if(!rbt_color(result) == DONE){
-            root = _rbt_remove_balance(root, dir, result);
-        }
-    }
-
-    if(data_saved){
-        result->key = save_key;
-        result->data = save_data;
-    }
-    return root;
-}
-
-rbnode_t *_rbt_remove_balance(rbnode_t *root, int32_t dir, rbnode_t *result){
-    rbnode_t *p = root;
-    rbnode_t *s = root->child[!dir];
-
-    if(rbt_color(s) == RED){
-        root = _rbt_rotates(root, dir);
-        s = p->child[!dir];
-    }
-
-    if(s != NULL){
-        if(rbt_color(s->child[LEFT]) == BLACK && rbt_color(s->child[RIGHT]) == BLACK){
-            if(rbt_color(p) == RED){
-                result->color = DONE;
-            }
-            p->color = BLACK;
-            s->color = RED;
-        }else{
-            uint8_t save = p->color;
-            int32_t new_root = (root == p);
-
-            if(rbt_color(s->child[!dir]) == RED){
-                p = _rbt_rotates(p, dir);
-            }else{
-                p = _rbt_rotated(p, dir);
-            }
-
-            p->color = save;
-            p->child[LEFT]->color = BLACK;
-            p->child[RIGHT]->color = BLACK;
-
-            if(new_root){
-                root = p;
-            }else{
-                root->child[dir] = p;
-            }
-
-            result->color = DONE;
-        }
-    }
-
-    return root;
-}
-
 void _rbt_print_r(FILE *output, rbnode_t *node, void (*disp_key)(FILE *, const void *),
                     void (*disp_value)(FILE *, const void *)){
-    /* Parent nodes are responsible for suffixing their print statements with 
+    /* Parent nodes are responsible for suffixing their print statements with
      * commas if there will be more K-V pairs to print. The pairs will be printed
      * inorder. */
-    if(node->child[LEFT] != NULL){
-        _rbt_print_r(output, node->child[LEFT], disp_key, disp_value);
+    if(_rbnode_child(node, LEFT) != NULL){
+        _rbt_print_r(output, _rbnode_child(node, LEFT), disp_key, disp_value);
         /* Since the left child printed, we need a separator */
         fprintf(output, ", ");
     }
@@ -318,9 +307,9 @@ void _rbt_print_r(FILE *output, rbnode_t *node, void (*disp_key)(FILE *, const v
     fprintf(output, ": ");
     disp_value(output, node->data);
 
-    if(node->child[RIGHT] != NULL){
+    if(_rbnode_child(node, RIGHT) != NULL){
         fprintf(output, ", ");
-        _rbt_print_r(output, node->child[RIGHT], disp_key, disp_value);
+        _rbt_print_r(output, _rbnode_child(node, RIGHT), disp_key, disp_value);
     }
 }
 
@@ -339,14 +328,14 @@ int32_t _rbt_maxn_r(list_t *rop, rbnode_t *node, int32_t n, int32_t dir){
     }
 
     int32_t r0;
-    if((r0 = _rbt_maxn_r(rop, node->child[dir], n, dir)) == n){
+    if((r0 = _rbt_maxn_r(rop, _rbnode_child(node, dir), n, dir)) == n){
         return n;
     }
-    
+
     list_addlast(rop, node);
 
     if(++r0 < n){
-        r0 += _rbt_maxn_r(rop, node->child[!dir], n - r0, dir);
+        r0 += _rbt_maxn_r(rop, _rbnode_child(node, !dir), n - r0, dir);
     }
     return r0;
 }
@@ -6,6 +6,9 @@
  * without his awesome tutorials on red-black trees.
  */
 
+#ifndef KMDATA_RBTREE_H
+#define KMDATA_RBTREE_H
+
 #include<stdint.h>
 #include<stdio.h>
 #include<stdlib.h>
@@ -18,21 +21,21 @@
 /* Colors -- users shouldn't concern themselves with these */
 #define LEFT 0
 #define RIGHT 1
-#define DONE 2 /* internal constant for one of the remove routines */
-#define WORKING 3
 
 /* Flags for tree manipulation */
 #define RBTREE_FREE_KEYS 1
 #define RBTREE_FREE_VALUES 2
 
-struct _rbt; /*Forward declaration */
+/* Nodes are 32 bytes on 64 bit machines. Children are kept as integers so
+ * the color can ride in the low bit of the left one, which is always clear
+ * in a pointer from malloc; the right one never has it set. Get at them
+ * with _rbnode_child and _rbnode_set_child, never directly. */
+#define RBNODE_COLOR ((uintptr_t)1)
 
 typedef struct _rbt_node {
-    struct _rbt_node *child[2];
+    uintptr_t child[2];
     void *data;
     void *key;
-    struct _rbt *tree;
-    uint8_t color;
 } rbnode_t;
 
 typedef struct _rbt {
@@ -41,13 +44,28 @@ typedef struct _rbt {
     size_t size;
 } rbtree_t;
 
+static inline rbnode_t *_rbnode_child(const rbnode_t *node, int32_t dir){
+    return (rbnode_t *)(node->child[dir] & ~RBNODE_COLOR);
+}
+
+static inline void _rbnode_set_child(rbnode_t *node, int32_t dir, rbnode_t *child){
+    node->child[dir] = (uintptr_t)child | (node->child[dir] & RBNODE_COLOR);
+}
+
+static inline uint8_t _rbnode_color(const rbnode_t *node){
+    return (uint8_t)(node->child[LEFT] & RBNODE_COLOR);
+}
+
+static inline void _rbnode_set_color(rbnode_t *node, uint8_t color){
+    node->child[LEFT] = (node->child[LEFT] & ~RBNODE_COLOR) | color;
+}
+
 /*Node helper functions. */
 rbnode_t *rbt_getnode(rbtree_t *tree, void *key);
 
 uint8_t rbt_color(rbnode_t *node);
 
-rbnode_t *_rbt_insert_r(rbnode_t *root, rbtree_t *tree, void *key, 
-                            void *data, rbnode_t *result);
+rbnode_t *_rbt_node_new(rbtree_t *tree, void *key, void *data);
 
 /* Implementation for a dictionary abstract data type. */
 void rbt_init(rbtree_t *tree, int32_t (*cmp)(const void *, const void *));
@@ -68,7 +86,7 @@ void rbt_minn(list_t *rop, rbtree_t *tree, int32_t n);
 /* Returns: key's data entry if it was found and removed, NULL otherwise */
 void *rbt_remove(rbtree_t *tree, void *key, rbnode_t *result);
 
-int32_t _rbnode_assert(rbnode_t *node);
+int32_t _rbnode_assert(rbtree_t *tree, rbnode_t *node);
 
 int32_t rbt_assert(rbtree_t *tree);
 
@@ -76,13 +94,9 @@ rbnode_t *_rbt_rotates(rbnode_t *root, int32_t dir);
 
 rbnode_t *_rbt_rotated(rbnode_t *root, int32_t dir);
 
-rbnode_t *_rbt_remove_r(rbnode_t *root, void *key, rbnode_t *result);
-
-rbnode_t *_rbt_remove_balance(rbnode_t *root, int32_t dir, rbnode_t *result);
-
-void _rbt_rclear(rbnode_t *node, int32_t options);
-
 void _rbt_print_r(FILE *output, rbnode_t *node, void (*disp_key)(FILE *, const void *),
                     void (*disp_value)(FILE *, const void *));
 
 int32_t _rbt_maxn_r(list_t *rop, rbnode_t *node, int32_t n, int32_t dir);
+
+#endif
@@ -0,0 +1,235 @@
+/* Ken Sheedlo
+ * kmdata Data Structures Library
+ * Type specialized dicts, generated at compile time.
+ *
+ * dict_t stores void * keys and values and goes through the hash and eq
+ * function pointers on every operation. KM_DICT_DEFINE instead writes out a
+ * whole table for one key and value type, with hash_fn and eq_fn called
+ * directly so the compiler can inline them. Keys and values are stored by
+ * value. For example,
+ *
+ * KM_DICT_DEFINE(intdict, intptr_t, intptr_t, km_intptr_hash, km_intptr_eq)
+ *
+ * intdict_t dict;
+ * intdict_entry_t result;
+ * intdict_init(&dict, 0, DICTHT_DEFAULTS);
+ * intdict_add(&dict, 42, 0xF00, &result);
+ * intptr_t *value = intdict_get(&dict, 42);
+ * intdict_clear(&dict);
+ *
+ * hash_fn takes a key_type and returns a 32 bit hash, eq_fn takes two and
+ * returns nonzero if they're equal. Either can be a function or a macro. The
+ * table is linear probing over a power of two number of slots, with a mixed
+ * copy of each hash stored beside the slots so probes only call eq_fn on
+ * real candidates, and removes shift entries back instead of leaving
+ * tombstones. Options are the same as dict_init's.
+ */
+
+#ifndef KMDATA_TDICT_H
+#define KMDATA_TDICT_H
+
+#include<stdio.h>
+#include<stdint.h>
+#include<stdlib.h>
+#include<string.h>
+
+#include "dict.h"
+#include "oat.h"
+
+#define KM_DICT_MINIMUM_SIZE    16
+
+/* Ready made hash and eq functions for common key types. */
+static inline int32_t km_intptr_hash(intptr_t key){
+    uint64_t k = (uint64_t)key;
+    return (int32_t)(k ^ (k >> 32));
+}
+
+static inline int32_t km_intptr_eq(intptr_t lhs, intptr_t rhs){
+    return lhs == rhs;
+}
+
+static inline int32_t km_string_eq(const char *lhs, const char *rhs){
+    return lhs == rhs || !strcmp(lhs, rhs);
+}
+
+#define KM_DICT_DEFINE(name, key_type, value_type, hash_fn, eq_fn)              \
+typedef struct {                                                                \
+    key_type key;                                                               \
+    value_type data;                                                            \
+} name##_entry_t;                                                               \
+                                                                                \
+typedef struct {                                                                \
+    uint32_t *hashes;   /* 0 for an empty slot */                               \
+    name##_entry_t *slots;                                                      \
+    size_t length;                                                              \
+    int32_t load;                                                               \
+    int32_t flags;                                                              \
+} name##_t;                                                                     \
+                                                                                \
+static inline uint32_t _##name##_hash(key_type key){                            \
+    uint32_t h = km_mix32((uint32_t)(hash_fn(key)));                            \
+    return h != 0 ? h : 1;                                                      \
+}                                                                               \
+                                                                                \
+static inline int32_t _##name##_resize(name##_t *dict, size_t new_size){        \
+    uint32_t *hashes = calloc(new_size, sizeof(uint32_t));                      \
+    name##_entry_t *slots = malloc(new_size * sizeof(name##_entry_t));          \
+    if(hashes == NULL || slots == NULL){                                        \
+        fprintf(stderr, "%s\n", "Memory allocation failure.");                  \
+        free(hashes);                                                           \
+        free(slots);                                                            \
+        return -1;                                                              \
+    }                                                                           \
+                                                                                \
+    size_t mask = new_size - 1;                                                 \
+    for(size_t i = 0; i < dict->length; i++){                                   \
+        uint32_t h = dict->hashes[i];                                           \
+        if(h != 0){                                                             \
+            size_t j = h & mask;                                                \
+            while(hashes[j] != 0){                                              \
+                j = (j + 1) & mask;                                             \
+            }                                                                   \
+            hashes[j] = h;                                                      \
+            slots[j] = dict->slots[i];                                          \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    free(dict->hashes);                                                         \
+    free(dict->slots);                                                          \
+    dict->hashes = hashes;                                                      \
+    dict->slots = slots;                                                        \
+    dict->length = new_size;                                                    \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+static inline size_t _##name##_find(name##_t *dict, key_type key, uint32_t h){  \
+    /* Returns the slot holding key, or dict->length if it isn't there. */      \
+    if(dict->length == 0){                                                      \
+        return 0;                                                               \
+    }                                                                           \
+    size_t mask = dict->length - 1;                                             \
+    for(size_t i = h & mask; dict->hashes[i] != 0; i = (i + 1) & mask){         \
+        if(dict->hashes[i] == h && eq_fn(key, dict->slots[i].key)){             \
+            return i;                                                           \
+        }                                                                       \
+    }                                                                           \
+    return dict->length;                                                        \
+}                                                                               \
+                                                                                \
+/* Returns 0, or -1 if there's no memory for the table, which leaves the dict  \
+ * empty, with every add failing until it's cleared and initialized again. */  \
+static inline int32_t name##_init(name##_t *dict, size_t size, int32_t options){\
+    size_t length = KM_DICT_MINIMUM_SIZE;                                       \
+    while(length < size){                                                       \
+        length <<= 1;                                                           \
+    }                                                                           \
+                                                                                \
+    dict->hashes = NULL;                                                        \
+    dict->slots = NULL;                                                         \
+    dict->length = 0;                                                           \
+    dict->load = 0;                                                             \
+    dict->flags = options;                                                      \
+    return _##name##_resize(dict, length);                                      \
+}                                                                               \
+                                                                                \
+/* Adds data under key. If key was already there, its old pair goes in        \
+ * result and 1 is returned, otherwise result gets the new pair and 0 is       \
+ * returned. Returns -1 if the table couldn't grow, or has none. */             \
+static inline int32_t name##_add(name##_t *dict, key_type key, value_type data, \
+    name##_entry_t *result){                                                    \
+    if(dict->length == 0){                                                      \
+        return -1;                                                              \
+    }                                                                           \
+    if(((double)(dict->load + 1)) / dict->length > DICTHT_MAX_LOAD              \
+        && (!(dict->flags & DICTHT_NO_GROW) || dict->load + 1 >= dict->length)){\
+                                                                                \
+        if(_##name##_resize(dict, dict->length * DICTHT_GROW_FACTOR)){          \
+            return -1;                                                          \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    uint32_t h = _##name##_hash(key);                                           \
+    size_t mask = dict->length - 1;                                             \
+    size_t i = h & mask;                                                        \
+    for(; dict->hashes[i] != 0; i = (i + 1) & mask){                            \
+        if(dict->hashes[i] == h && eq_fn(key, dict->slots[i].key)){             \
+            *result = dict->slots[i];                                           \
+            dict->slots[i].key = key;                                           \
+            dict->slots[i].data = data;                                         \
+            return 1;                                                           \
+        }                                                                       \
+    }                                                                           \
+                                                                                \
+    dict->hashes[i] = h;                                                        \
+    dict->slots[i].key = key;                                                   \
+    dict->slots[i].data = data;                                                 \
+    dict->load = dict->load + 1;                                                \
+    *result = dict->slots[i];                                                   \
+    return 0;                                                                   \
+}                                                                               \
+                                                                                \
+/* Returns a pointer to the value stored under key, or NULL if there isn't     \
+ * one. The pointer is good until the next add or remove. */                   \
+static inline value_type *name##_get(name##_t *dict, key_type key){             \
+    size_t i = _##name##_find(dict, key, _##name##_hash(key));                  \
+    if(i == dict->length){                                                      \
+        return NULL;                                                            \
+    }                                                                           \
+    return &dict->slots[i].data;                                                \
+}                                                                               \
+                                                                                \
+/* Removes key. Returns 1 and puts the removed pair in result if it was        \
+ * there, 0 otherwise. */                                                      \
+static inline int32_t name##_remove(name##_t *dict, key_type key,               \
+    name##_entry_t *result){                                                    \
+    if((((double)(dict->load - 1)) / dict->length) < DICTHT_MIN_LOAD            \
+        && !(dict->flags & DICTHT_NO_SHRINK)                                    \
+        && dict->length > KM_DICT_MINIMUM_SIZE){                                \
+                                                                                \
+        _##name##_resize(dict, dict->length / DICTHT_GROW_FACTOR);              \
+    }                                                                           \
+                                                                                \
+    size_t i = _##name##_find(dict, key, _##name##_hash(key));                  \
+    if(i == dict->length){                                                      \
+        return 0;                                                               \
+    }                                                                           \
+    *result = dict->slots[i];                                                   \
+                                                                                \
+    /* Stored hashes are already mixed, so they give the home slot as is,  \
+     * and a 0 hash marks the slot that ends the cluster. */                   \
+    size_t mask = dict->length - 1;                                             \
+    for(size_t j = (i + 1) & mask; dict->hashes[j] != 0; j = (j + 1) & mask){   \
+        size_t home = dict->hashes[j] & mask;                                   \
+        if(km_probe_can_fill(i, j, home, mask)){                                \
+            dict->hashes[i] = dict->hashes[j];                                  \
+            dict->slots[i] = dict->slots[j];                                    \
+            i = j;                                                              \
+        }                                                                       \
+    }                                                                           \
+    dict->hashes[i] = 0;                                                        \
+    dict->load = dict->load - 1;                                                \
+    return 1;                                                                   \
+}                                                                               \
+                                                                                \
+/* Calls func on every pair in the dict, in no particular order. */             \
+static inline void name##_foreach(name##_t *dict,                               \
+    void (*func)(key_type, value_type, void *), void *arg){                     \
+    for(size_t i = 0; i < dict->length; i++){                                   \
+        if(dict->hashes[i] != 0){                                               \
+            func(dict->slots[i].key, dict->slots[i].data, arg);                 \
+        }                                                                       \
+    }                                                                           \
+}                                                                               \
+                                                                                \
+/* Frees the table. Keys and values are stored by value, so anything they     \
+ * point to is the caller's to free first, e.g. with name##_foreach. */        \
+static inline void name##_clear(name##_t *dict){                                \
+    free(dict->hashes);                                                         \
+    free(dict->slots);                                                          \
+    dict->hashes = NULL;                                                        \
+    dict->slots = NULL;                                                         \
+    dict->length = 0;                                                           \
+    dict->load = 0;                                                             \
+}
+
+#endif
@@ -2,6 +2,7 @@
  * Simple tuple implementation */
 
 #include "tuple.h"
+#include "oat.h"
 
 void tuple_init(tuple_t *tuple, void *first, void *second){
     tuple->fst = first;
@@ -38,3 +39,41 @@ int32_t tuple_equal(tuple_t *lhs,
     /* Tests two tuples for equality. */
     return leq(lhs->fst, rhs->fst) && req(lhs->snd, rhs->snd);
 }
+
+int32_t tuple_intptr_hash(const void *tuple){
+    const tuple_t *t = tuple;
+    oat_state_t state;
+    oat_init(&state);
+    oat_update(&state, &t->fst, sizeof(t->fst));
+    oat_update(&state, &t->snd, sizeof(t->snd));
+    return oat_final(&state);
+}
+
+int32_t tuple_intptr_eq(const void *lhs, const void *rhs){
+    const tuple_t *l = lhs, *r = rhs;
+    return l->fst == r->fst && l->snd == r->snd;
+}
+
+int32_t tuple_string_hash(const void *tuple){
+    const tuple_t *t = tuple;
+    oat_state_t state;
+    oat_init(&state);
+    oat_update(&state, t->fst, strlen((const char *)t->fst) + 1);
+    oat_update(&state, t->snd, strlen((const char *)t->snd) + 1);
+    return oat_final(&state);
+}
+
+int32_t tuple_string_eq(const void *lhs, const void *rhs){
+    const tuple_t *l = lhs, *r = rhs;
+    return !strcmp((const char *)l->fst, (const char *)r->fst)
+        && !strcmp((const char *)l->snd, (const char *)r->snd);
+}
+
+int32_t tuple_hash(const tuple_t *tuple, int32_t (*lhash)(const void *),
+                int32_t (*rhash)(const void *)){
+    int32_t hashes[2] = {lhash(tuple->fst), rhash(tuple->snd)};
+    oat_state_t state;
+    oat_init(&state);
+    oat_update(&state, hashes, sizeof(hashes));
+    return oat_final(&state);
+}
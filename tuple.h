@@ -1,9 +1,13 @@
 /* Ken Sheedlo
  * Simple tuple implementation in C. */
 
+#ifndef KMDATA_TUPLE_H
+#define KMDATA_TUPLE_H
+
 #include<stdint.h>
 #include<stdio.h>
 #include<stdlib.h>
+#include<string.h>
 
 typedef struct {
     void *fst;
@@ -24,3 +28,23 @@ int32_t tuple_equal(tuple_t *lhs,
                 int32_t (*leq)(const void *, const void *),
                 int32_t (*req)(const void *, const void *));
 
+/* Hash and eq callbacks for dicts keyed by tuple_t pointers, hashing the
+ * fields in place with oat_update, so a lookup can use a tuple_t on the
+ * stack and nothing gets copied. The _intptr pair is for fields that are
+ * integers stored in the pointers, and the _string pair for fields that are
+ * C strings. A string's NUL goes into the hash too, so ("ab", "c") and
+ * ("a", "bc") hash differently. */
+int32_t tuple_intptr_hash(const void *tuple);
+
+int32_t tuple_intptr_eq(const void *lhs, const void *rhs);
+
+int32_t tuple_string_hash(const void *tuple);
+
+int32_t tuple_string_eq(const void *lhs, const void *rhs);
+
+/* For other field types, combines the fields' own hashes. Wrap it with the
+ * right hash functions to get a dict callback, and tuple_equal to get eq. */
+int32_t tuple_hash(const tuple_t *tuple, int32_t (*lhash)(const void *),
+                int32_t (*rhash)(const void *));
+
+#endif
@@ -436,10 +436,1729 @@ int32_t test_dict_resize(){
     return 1;
 }
 
+int32_t test_dict_incremental(){
+    char buf[12];
+    dict_t dict;
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_INCREMENTAL);
+    bucket_t result;
+    int32_t saw_rehash = 0;
+
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        dict_add(&dict, strdup(buf), (void *)i, &result);
+        if(strcmp(result.key, buf) || (intptr_t)result.data != i){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+        saw_rehash = saw_rehash || dict.old_table != NULL;
+
+        if(dict.old_table != NULL){
+            /* Everything added so far has to be reachable mid-resize. */
+            for(intptr_t j = 11; j <= i; j++){
+                alpha26(buf, j);
+                if((intptr_t)dict_get(&dict, buf) != j){
+                    dict_clear(&dict, DICTHT_FREE_KEYS);
+                    return 0;
+                }
+            }
+        }
+    }
+
+    assert(saw_rehash);
+    assert(dict.load == 4082);
+
+    /* Overwrites have to find keys in whichever table they're in. */
+    alpha26(buf, 42);
+    dict_add(&dict, buf, (void *)0xF00, &result);
+    if((intptr_t)result.data != 42 || (intptr_t)dict_get(&dict, buf) != 0xF00
+        || dict.load != 4082){
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+        return 0;
+    }
+    free(result.key);
+    alpha26(buf, 42);
+    dict_add(&dict, strdup(buf), (void *)42, &result);
+
+    for(intptr_t i = 500; i < 4093; i++){
+        alpha26(buf, i);
+        intptr_t r0 = (intptr_t)dict_remove(&dict, buf, &result);
+        if(r0 != i || strcmp(result.key, buf)){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+        free(result.key);
+    }
+
+    for(intptr_t i = 11; i < 500; i++){
+        alpha26(buf, i);
+        if((intptr_t)dict_get(&dict, buf) != i){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+    }
+
+    list_t keys;
+    list_init(&keys);
+    dict_key_set(&keys, &dict);
+    assert(keys.length == 489);
+    list_clear(&keys, 0);
+
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    return 1;
+}
+
+int32_t string_hash_calls = 0, string_eq_calls = 0;
+
+int32_t counting_string_hash(const void *str){
+    string_hash_calls++;
+    return oat_string_hash(str);
+}
+
+int32_t counting_string_eq(const void *lhs, const void *rhs){
+    string_eq_calls++;
+    return generic_string_eq(lhs, rhs);
+}
+
+int32_t test_dict_stored_hash(){
+    /* Resizes shouldn't call the hash function, and lookups shouldn't call eq
+     * on buckets whose hash doesn't match. */
+    char buf[12];
+    dict_t dict;
+    dict_init(&dict, 0, counting_string_hash, counting_string_eq, DICTHT_DEFAULTS);
+    bucket_t result;
+
+    string_hash_calls = string_eq_calls = 0;
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        dict_add(&dict, strdup(buf), (void *)i, &result);
+    }
+    assert(dict.length != 2039);
+    if(string_hash_calls != 4082 || string_eq_calls != 0){
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+        return 0;
+    }
+
+    string_eq_calls = 0;
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        if((intptr_t)dict_get(&dict, buf) != i){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+    }
+    if(string_eq_calls != 4082){
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+        return 0;
+    }
+
+    string_hash_calls = 0;
+    for(intptr_t i = 500; i < 4093; i++){
+        alpha26(buf, i);
+        dict_remove(&dict, buf, &result);
+        free(result.key);
+    }
+    if(string_hash_calls != 3593){
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+        return 0;
+    }
+
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    return 1;
+}
+
+int32_t test_dict_get_many(){
+    char buf[12];
+    char *queries[300];
+    void *values[300];
+    bucket_t result;
+    int32_t options[] = {DICTHT_DEFAULTS, DICTHT_INCREMENTAL};
+
+    for(int32_t k = 0; k < 2; k++){
+        dict_t dict;
+        dict_init(&dict, 0, oat_string_hash, generic_string_eq, options[k]);
+
+        /* Stop while an incremental resize is still running. */
+        for(intptr_t i = 11; i < 1600; i++){
+            alpha26(buf, i);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+        }
+        assert(k == 0 || DICTHT_REHASHING(&dict));
+
+        /* Every third query misses. */
+        for(intptr_t i = 0; i < 300; i++){
+            alpha26(buf, i % 3 ? 11 + i * 5 : 5000 + i);
+            queries[i] = strdup(buf);
+        }
+
+        size_t found = dict_get_many(&dict, (void **)queries, values, 300);
+        int32_t ok = found == 200;
+        for(intptr_t i = 0; i < 300; i++){
+            ok = ok && values[i] == dict_get(&dict, queries[i]);
+            ok = ok && (i % 3 ? (intptr_t)values[i] == 11 + i * 5 : values[i] == NULL);
+            free(queries[i]);
+        }
+
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+        if(!ok){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int32_t weak_string_hash(const void *str){
+    /* Piles everything into a handful of slots. */
+    return ((const char *)str)[0] & 3;
+}
+
+int32_t test_dict_treeify(){
+    char buf[12];
+    bucket_t result;
+    int32_t options[] = {DICTHT_TREEIFY, DICTHT_TREEIFY | DICTHT_INCREMENTAL};
+
+    for(int32_t k = 0; k < 2; k++){
+        dict_t dict;
+        dict_init(&dict, 0, weak_string_hash, generic_string_eq, options[k]);
+        dict_set_cmp(&dict, generic_strcmp);
+
+        /* Enough keys to resize at least once. */
+        for(intptr_t i = 0; i < 2000; i++){
+            alpha26(buf, i);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+        }
+        while(DICTHT_REHASHING(&dict)){
+            _dict_rehash_step(&dict, DICTHT_REHASH_STEPS);
+        }
+        if(dict.load != 2000 || dict.length == DICTHT_MINIMUM_SIZE){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+
+        int32_t trees = 0;
+        for(size_t i = 0; i < dict.length; i++){
+            trees += dict.table[i] != NULL && DICTHT_IS_TREEBIN(dict.table[i]);
+        }
+        if(trees == 0){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+
+        for(intptr_t i = 0; i < 2000; i++){
+            alpha26(buf, i);
+            if((intptr_t)dict_get(&dict, buf) != i){
+                dict_clear(&dict, DICTHT_FREE_KEYS);
+                return 0;
+            }
+        }
+        if(dict_get(&dict, "notakey") != NULL){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+
+        /* Overwrite a key living in a tree. */
+        alpha26(buf, 1000);
+        char *key = strdup(buf);
+        dict_add(&dict, key, (void *)0xF00, &result);
+        free(result.key);
+        if(dict.load != 2000 || dict_get(&dict, buf) != (void *)0xF00){
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+        list_t keys;
+        list_init(&keys);
+        dict_key_set(&keys, &dict);
+        if(keys.length != 2000){
+            list_clear(&keys, 0);
+            dict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+        list_clear(&keys, 0);
+
+        /* Removing nearly everything turns the trees back into chains. */
+        for(intptr_t i = 0; i < 1995; i++){
+            alpha26(buf, i);
+            if(dict_remove(&dict, buf, &result) != (i == 1000 ? (void *)0xF00 : (void *)i)){
+                dict_clear(&dict, DICTHT_FREE_KEYS);
+                return 0;
+            }
+            free(result.key);
+        }
+        while(DICTHT_REHASHING(&dict)){
+            _dict_rehash_step(&dict, DICTHT_REHASH_STEPS);
+        }
+        for(size_t i = 0; i < dict.length; i++){
+            if(dict.table[i] != NULL && DICTHT_IS_TREEBIN(dict.table[i])){
+                dict_clear(&dict, DICTHT_FREE_KEYS);
+                return 0;
+            }
+        }
+        for(intptr_t i = 1995; i < 2000; i++){
+            alpha26(buf, i);
+            if((intptr_t)dict_get(&dict, buf) != i){
+                dict_clear(&dict, DICTHT_FREE_KEYS);
+                return 0;
+            }
+        }
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+    }
+    return 1;
+}
+
+int32_t bang_string_hash(const void *str){
+    /* Every key starting with '!' gets the same hash. */
+    return ((const char *)str)[0] == '!' ? 7 : oat_string_hash(str);
+}
+
+int32_t test_dict_treeify_incremental(){
+    /* A tree bin moved to the new table a chain at a time should come out
+     * a tree bin again, as it does when the resize is all at once. */
+    char buf[13];
+    bucket_t result;
+    int32_t options[] = {DICTHT_TREEIFY, DICTHT_TREEIFY | DICTHT_INCREMENTAL};
+    int32_t ok = 1;
+
+    for(int32_t k = 0; ok && k < 2; k++){
+        dict_t dict;
+        dict_init(&dict, 0, bang_string_hash, generic_string_eq, options[k]);
+        dict_set_cmp(&dict, generic_strcmp);
+        buf[0] = '!';
+        for(intptr_t i = 0; i < 50; i++){
+            alpha26(buf + 1, i + 1);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+        }
+        size_t length = dict.length;
+        for(intptr_t i = 0; i < 20000; i++){
+            alpha26(buf, i + 1);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+        }
+        while(DICTHT_REHASHING(&dict)){
+            _dict_rehash_step(&dict, DICTHT_REHASH_STEPS);
+        }
+        bucket_t *bin = dict.table[_dict_index(&dict, 7, dict.length)];
+        ok = dict.length > length && dict.load == 20050
+            && bin != NULL && DICTHT_IS_TREEBIN(bin)
+            && ((rbtree_t *)bin->data)->size >= 50;
+        buf[0] = '!';
+        for(intptr_t i = 0; ok && i < 50; i++){
+            alpha26(buf + 1, i + 1);
+            ok = dict_get(&dict, buf) == (void *)i;
+        }
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+    }
+    return ok;
+}
+
+int32_t intptr_hash(const void *key){
+    return (int32_t)(intptr_t)key;
+}
+
+int32_t intptr_eq(const void *lhs, const void *rhs){
+    return lhs == rhs;
+}
+
+int32_t test_dict_pow2(){
+    bucket_t result;
+    int32_t options[] = {DICTHT_POW2, DICTHT_POW2 | DICTHT_INCREMENTAL};
+
+    for(int32_t k = 0; k < 2; k++){
+        dict_t dict;
+        dict_init(&dict, 3000, intptr_hash, intptr_eq, options[k]);
+        if(dict.length != 4096){
+            return 0;
+        }
+
+        /* Keys that only differ above the bits a mask would keep. */
+        for(intptr_t i = 1; i <= 20000; i++){
+            dict_add(&dict, (void *)(i << 16), (void *)i, &result);
+        }
+        while(DICTHT_REHASHING(&dict)){
+            _dict_rehash_step(&dict, DICTHT_REHASH_STEPS);
+        }
+        if(dict.load != 20000 || (dict.length & (dict.length - 1)) != 0){
+            return 0;
+        }
+
+        size_t longest = 0;
+        for(size_t i = 0; i < dict.length; i++){
+            size_t chain_length = 0;
+            for(bucket_t *bucket = dict.table[i]; bucket != NULL; bucket = bucket->next){
+                chain_length++;
+            }
+            longest = MAX(longest, chain_length);
+        }
+        if(longest > 8){
+            return 0;
+        }
+
+        for(intptr_t i = 1; i <= 20000; i++){
+            if((intptr_t)dict_get(&dict, (void *)(i << 16)) != i){
+                return 0;
+            }
+        }
+        for(intptr_t i = 1; i <= 19990; i++){
+            if((intptr_t)dict_remove(&dict, (void *)(i << 16), &result) != i){
+                return 0;
+            }
+        }
+        while(DICTHT_REHASHING(&dict)){
+            _dict_rehash_step(&dict, DICTHT_REHASH_STEPS);
+        }
+        if(dict.length != DICTHT_POW2_MINIMUM_SIZE
+            || dict_get(&dict, (void *)(20000 << 16)) != (void *)20000){
+            return 0;
+        }
+        dict_clear(&dict, 0);
+    }
+    return 1;
+}
+
+int32_t test_dict_small(){
+    char buf[12];
+    char *keys[DICTHT_SMALL_SIZE + 1];
+    void *values[DICTHT_SMALL_SIZE + 1];
+    bucket_t result;
+    dict_t dict;
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    if(!DICTHT_IS_SMALL(&dict) || dict.small != NULL){
+        return 0;
+    }
+
+    for(intptr_t i = 0; i < DICTHT_SMALL_SIZE; i++){
+        alpha26(buf, i);
+        keys[i] = strdup(buf);
+        dict_add(&dict, keys[i], (void *)i, &result);
+    }
+    if(!DICTHT_IS_SMALL(&dict) || dict.load != DICTHT_SMALL_SIZE){
+        return 0;
+    }
+
+    /* Overwrite one, then remove one from the middle. */
+    dict_add(&dict, keys[2], (void *)0xF00, &result);
+    if((intptr_t)result.data != 2 || dict_get(&dict, "c") != (void *)0xF00){
+        return 0;
+    }
+    if(dict_remove(&dict, "d", &result) != (void *)3 || dict.load != DICTHT_SMALL_SIZE - 1){
+        return 0;
+    }
+    free(result.key);
+    if(dict_get(&dict, "d") != NULL || dict_get(&dict, keys[DICTHT_SMALL_SIZE - 1])
+        != (void *)(DICTHT_SMALL_SIZE - 1)){
+        return 0;
+    }
+    keys[3] = strdup("d");
+    dict_add(&dict, keys[3], (void *)3, &result);
+
+    list_t key_set;
+    list_init(&key_set);
+    dict_key_set(&key_set, &dict);
+    if(key_set.length != DICTHT_SMALL_SIZE){
+        return 0;
+    }
+    list_clear(&key_set, 0);
+
+    /* One more makes it a real table. */
+    keys[DICTHT_SMALL_SIZE] = strdup("zz");
+    dict_add(&dict, keys[DICTHT_SMALL_SIZE], (void *)42, &result);
+    if(DICTHT_IS_SMALL(&dict) || dict.small != NULL || dict.length != DICTHT_MINIMUM_SIZE){
+        return 0;
+    }
+    size_t found = dict_get_many(&dict, (void **)keys, values, DICTHT_SMALL_SIZE + 1);
+    if(found != DICTHT_SMALL_SIZE + 1 || values[2] != (void *)0xF00
+        || values[3] != (void *)3 || values[DICTHT_SMALL_SIZE] != (void *)42){
+        return 0;
+    }
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    return 1;
+}
+
+int32_t test_dict_upsert(){
+    char buf[12];
+    int32_t options[] = {DICTHT_DEFAULTS, DICTHT_INCREMENTAL, DICTHT_TREEIFY};
+    int32_t (*hashes[])(const void *) = {counting_string_hash, counting_string_hash,
+                                            weak_string_hash};
+
+    for(int32_t k = 0; k < 3; k++){
+        dict_t dict;
+        int32_t inserted;
+        dict_init(&dict, 0, hashes[k], generic_string_eq, options[k]);
+        dict_set_cmp(&dict, generic_strcmp);
+
+        /* Count 3000 words, each seen twice in a different order. */
+        string_hash_calls = 0;
+        for(intptr_t i = 0; i < 6000; i++){
+            alpha26(buf, i < 3000 ? i : i * 7 % 3000);
+            bucket_t *count = dict_upsert(&dict, buf, &inserted);
+            if(count == NULL){
+                return 0;
+            }
+            if(inserted){
+                if(count->data != NULL){
+                    return 0;
+                }
+                dict_rekey(&dict, count, strdup(buf));
+            }
+            count->data = (void *)((intptr_t)count->data + 1);
+        }
+        if(dict.load != 3000 || (k < 2 && string_hash_calls != 6000)){
+            return 0;
+        }
+
+        intptr_t total = 0;
+        for(intptr_t i = 0; i < 3000; i++){
+            alpha26(buf, i);
+            total += (intptr_t)dict_get(&dict, buf);
+        }
+        if(total != 6000 || dict_get(&dict, "b") != (void *)2){
+            return 0;
+        }
+
+        /* dict_add still swaps in the new key, tree bins included. */
+        bucket_t result;
+        char *key = strdup("c");
+        dict_add(&dict, key, (void *)0xF00, &result);
+        free(result.key);
+        if(dict_get(&dict, "c") != (void *)0xF00 || dict.load != 3000){
+            return 0;
+        }
+        dict_clear(&dict, DICTHT_FREE_KEYS);
+    }
+    return 1;
+}
+
+int32_t test_cdict_basic(){
+    cdict_t dict;
+    bucket_t result;
+    cdict_init(&dict, 0, intptr_hash, intptr_eq, DICTHT_DEFAULTS);
+
+    for(intptr_t i = 1; i <= 10000; i++){
+        cdict_add(&dict, (void *)i, (void *)(i * 2), &result);
+    }
+    if(cdict_load(&dict) != 10000 || dict.table->length <= CDICT_MINIMUM_SIZE){
+        return 0;
+    }
+
+    cdict_add(&dict, (void *)42, (void *)0xF00, &result);
+    if((intptr_t)result.data != 84 || cdict_get(&dict, (void *)42) != (void *)0xF00){
+        return 0;
+    }
+
+    for(intptr_t i = 1; i <= 10000; i++){
+        void *expected = i == 42 ? (void *)0xF00 : (void *)(i * 2);
+        if(cdict_get(&dict, (void *)i) != expected){
+            return 0;
+        }
+    }
+    if(cdict_get(&dict, (void *)20000) != NULL){
+        return 0;
+    }
+
+    for(intptr_t i = 1; i <= 9990; i++){
+        cdict_remove(&dict, (void *)i, &result);
+        if((intptr_t)result.key != i){
+            return 0;
+        }
+    }
+    int32_t ok = cdict_load(&dict) == 10
+        && dict.table->length == CDICT_MINIMUM_SIZE
+        && cdict_get(&dict, (void *)10000) == (void *)20000
+        && cdict_remove(&dict, (void *)1, &result) == NULL;
+    cdict_clear(&dict, 0);
+    return ok;
+}
+
+int32_t test_cdict_resize(){
+    /* The table only grows once it's really DICTHT_MAX_LOAD full, and
+     * churn near a steady size doesn't resize it at all. */
+    cdict_t dict;
+    bucket_t result;
+    cdict_init(&dict, 0, intptr_hash, intptr_eq, DICTHT_DEFAULTS);
+
+    int32_t ok = 1;
+    for(intptr_t i = 1; ok && i <= 700; i++){
+        cdict_add(&dict, (void *)i, (void *)i, &result);
+        ok = dict.table->length == CDICT_MINIMUM_SIZE;
+    }
+    cdtable_t *table = dict.table;
+    for(intptr_t i = 1; ok && i <= 20000; i++){
+        cdict_add(&dict, (void *)(i + 1000), (void *)i, &result);
+        cdict_remove(&dict, (void *)(i + 1000), &result);
+        ok = dict.table == table;
+    }
+    for(intptr_t i = 701; ok && i <= 1000; i++){
+        cdict_add(&dict, (void *)i, (void *)i, &result);
+    }
+    ok = ok && dict.table->length == 2 * CDICT_MINIMUM_SIZE && cdict_load(&dict) == 1000;
+    cdict_clear(&dict, 0);
+    return ok;
+}
+
+typedef struct {
+    cdict_t *dict;
+    intptr_t start;
+    int32_t *done;
+    int32_t ok;
+} cdict_thread_arg_t;
+
+void *cdict_writer(void *arg){
+    /* Adds 10000 keys, and removes every other one again. */
+    cdict_thread_arg_t *targ = (cdict_thread_arg_t *)arg;
+    bucket_t result;
+    for(intptr_t i = targ->start; i < targ->start + 10000; i++){
+        cdict_add(targ->dict, (void *)i, (void *)(i * 2), &result);
+    }
+    for(intptr_t i = targ->start; i < targ->start + 10000; i += 2){
+        cdict_remove(targ->dict, (void *)i, &result);
+    }
+    return NULL;
+}
+
+void *cdict_reader(void *arg){
+    /* Whatever is found has to be the right value. */
+    cdict_thread_arg_t *targ = (cdict_thread_arg_t *)arg;
+    while(!__atomic_load_n(targ->done, __ATOMIC_ACQUIRE)){
+        for(intptr_t i = 1; i < 40001; i += 7){
+            void *data = cdict_get(targ->dict, (void *)i);
+            if(data != NULL && data != (void *)(i * 2)){
+                targ->ok = 0;
+            }
+        }
+    }
+    return NULL;
+}
+
+int32_t test_cdict_threads(){
+    cdict_t dict;
+    pthread_t writers[4], readers[2];
+    cdict_thread_arg_t writer_args[4], reader_args[2];
+    int32_t done = 0;
+    cdict_init(&dict, 0, intptr_hash, intptr_eq, DICTHT_DEFAULTS);
+
+    for(int32_t i = 0; i < 2; i++){
+        reader_args[i] = (cdict_thread_arg_t){&dict, 0, &done, 1};
+        pthread_create(readers + i, NULL, cdict_reader, reader_args + i);
+    }
+    for(int32_t i = 0; i < 4; i++){
+        writer_args[i] = (cdict_thread_arg_t){&dict, 1 + i * 10000, &done, 1};
+        pthread_create(writers + i, NULL, cdict_writer, writer_args + i);
+    }
+    for(int32_t i = 0; i < 4; i++){
+        pthread_join(writers[i], NULL);
+    }
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+
+    int32_t ok = 1;
+    for(int32_t i = 0; i < 2; i++){
+        pthread_join(readers[i], NULL);
+        ok = ok && reader_args[i].ok;
+    }
+
+    ok = ok && cdict_load(&dict) == 20000;
+    for(intptr_t i = 1; i < 40001; i++){
+        void *expected = i % 2 ? NULL : (void *)(i * 2);
+        ok = ok && cdict_get(&dict, (void *)i) == expected;
+    }
+    cdict_clear(&dict, 0);
+    return ok;
+}
+
+int32_t test_odict_order(){
+    odict_t dict;
+    bucket_t result;
+    list_t keys;
+    odict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+
+    odict_add(&dict, "foo", (void *)1, &result);
+    odict_add(&dict, "bar", (void *)2, &result);
+    odict_add(&dict, "baz", (void *)3, &result);
+    odict_add(&dict, "qux", (void *)4, &result);
+
+    /* Overwrites keep their place, removes leave a gap. */
+    odict_add(&dict, "bar", (void *)0xF00, &result);
+    if(strcmp((char *)result.key, "bar") || (intptr_t)result.data != 2){
+        return 0;
+    }
+    if(odict_remove(&dict, "foo", &result) != (void *)1 || dict.load != 3){
+        return 0;
+    }
+    odict_add(&dict, "foo", (void *)5, &result);
+
+    const char *expected[] = {"bar", "baz", "qux", "foo"};
+    list_init(&keys);
+    odict_key_set(&keys, &dict);
+    int32_t ok = keys.length == 4;
+    node_t *node = keys.head->next;
+    for(int32_t i = 0; ok && i < 4; i++, node = node->next){
+        ok = !strcmp((char *)node->data, expected[i]);
+    }
+    list_clear(&keys, 0);
+
+    ok = ok && odict_get(&dict, "bar") == (void *)0xF00
+        && odict_get(&dict, "foo") == (void *)5
+        && odict_get(&dict, "nope") == NULL
+        && odict_remove(&dict, "nope", &result) == NULL;
+    odict_clear(&dict, 0);
+    return ok;
+}
+
+int32_t test_odict_resize(){
+    char buf[12];
+    odict_t dict;
+    bucket_t result;
+    list_t values;
+    odict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+
+    for(intptr_t i = 0; i < 5000; i++){
+        alpha26(buf, i);
+        odict_add(&dict, strdup(buf), (void *)i, &result);
+    }
+    if(dict.load != 5000 || dict.length <= ODICT_MINIMUM_SIZE){
+        return 0;
+    }
+    size_t grow_size = dict.length;
+
+    /* Take out everything but every tenth key. */
+    for(intptr_t i = 0; i < 5000; i++){
+        if(i % 10){
+            alpha26(buf, i);
+            odict_remove(&dict, buf, &result);
+            free(result.key);
+        }
+    }
+    if(dict.load != 500 || dict.length >= grow_size
+        || dict.used > _odict_capacity(dict.length)){
+        return 0;
+    }
+
+    list_init(&values);
+    odict_value_set(&values, &dict);
+    int32_t ok = values.length == 500;
+    intptr_t i = 0;
+    for(node_t *node = values.head->next; ok && node != values.head; node = node->next){
+        ok = (intptr_t)node->data == i;
+        i += 10;
+    }
+    list_clear(&values, 0);
+
+    for(i = 0; ok && i < 5000; i++){
+        alpha26(buf, i);
+        ok = odict_get(&dict, buf) == (i % 10 ? NULL : (void *)i);
+    }
+    odict_clear(&dict, DICTHT_FREE_KEYS);
+
+    /* With DICTHT_NO_GROW, a full array with a few holes in it gets
+     * squeezed at the same size, and only grows once it has none. */
+    odict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_NO_GROW);
+    size_t length = dict.length;
+    int32_t capacity = _odict_capacity(length);
+    for(i = 0; i < capacity; i++){
+        alpha26(buf, i);
+        odict_add(&dict, strdup(buf), (void *)i, &result);
+    }
+    alpha26(buf, 0);
+    odict_remove(&dict, buf, &result);
+    free(result.key);
+    alpha26(buf, capacity);
+    odict_add(&dict, strdup(buf), (void *)i, &result);
+    ok = ok && dict.length == length && dict.load == capacity && dict.used == capacity;
+    alpha26(buf, capacity + 1);
+    odict_add(&dict, strdup(buf), (void *)i, &result);
+    ok = ok && dict.length > length && dict.load == capacity + 1;
+    odict_clear(&dict, DICTHT_FREE_KEYS);
+    return ok;
+}
+
+int32_t test_dict_build(){
+    /* Every key shows up twice, so the later value has to win. */
+    const size_t n = 20000;
+    void **keys = malloc(n * sizeof(void *));
+    void **values = malloc(n * sizeof(void *));
+    char buf[12];
+    for(size_t i = 0; i < n; i++){
+        alpha26(buf, (intptr_t)(i % (n / 2)));
+        keys[i] = strdup(buf);
+        values[i] = (void *)i;
+    }
+
+    int32_t ok = 1;
+    int32_t threads[] = {1, 3, 8};
+    for(int32_t k = 0; ok && k < 4; k++){
+        dict_t dict;
+        if(k < 3){
+            dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+        }else{
+            /* Every key in a handful of chains, which have to be treeified. */
+            dict_init(&dict, 0, weak_string_hash, generic_string_eq, DICTHT_TREEIFY);
+            dict_set_cmp(&dict, (int32_t (*)(const void *, const void *))strcmp);
+        }
+        ok = !dict_build(&dict, keys, values, n, k < 3 ? threads[k] : 4)
+            && dict.load == (int32_t)(n / 2) && (size_t)dict.load <= dict.length;
+        for(size_t i = 0; ok && i < n / 2; i++){
+            bucket_t result;
+            ok = dict_get(&dict, keys[i]) == (void *)(i + n / 2)
+                && dict_remove(&dict, keys[i + n / 2], &result) == (void *)(i + n / 2)
+                && result.key == keys[i + n / 2];
+        }
+        ok = ok && dict.load == 0;
+        dict_clear(&dict, 0);
+    }
+
+    /* Too few pairs for a table: the dict stays small. */
+    dict_t dict;
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    ok = ok && !dict_build(&dict, keys, values, 4, 4) && DICTHT_IS_SMALL(&dict)
+        && dict.load == 4 && dict_get(&dict, keys[3]) == (void *)3;
+    dict_clear(&dict, 0);
+
+    for(size_t i = 0; i < n; i++){
+        free(keys[i]);
+    }
+    free(keys);
+    free(values);
+    return ok;
+}
+
+void sum_values(void *key, void *data, void *acc){
+    *(intptr_t *)acc += (intptr_t)data;
+}
+
+int32_t test_dict_parallel(){
+    char buf[12];
+    dict_t dict;
+    bucket_t result;
+    intptr_t sums[4];
+    void *accs[4] = {sums, sums + 1, sums + 2, sums + 3};
+    int32_t ok = 1;
+
+    /* Incremental, so some scans catch a resize in the middle, and weakly
+     * hashed into tree bins, which have to be skipped. */
+    for(int32_t k = 0; ok && k < 2; k++){
+        dict_init(&dict, 0, k ? weak_string_hash : oat_string_hash, generic_string_eq,
+            k ? DICTHT_TREEIFY : DICTHT_INCREMENTAL);
+        dict_set_cmp(&dict, (int32_t (*)(const void *, const void *))strcmp);
+        intptr_t expected = 0;
+        for(intptr_t i = 0; ok && i < 5000; i++){
+            alpha26(buf, i);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+            expected += i;
+            if(i % 997 == 0 || i == 4999){
+                memset(sums, 0, sizeof(sums));
+                dict_parallel_for_each(&dict, 4, sum_values, accs);
+                ok = sums[0] + sums[1] + sums[2] + sums[3] == expected;
+            }
+        }
+        /* A thread count below 1 means one thread. */
+        memset(sums, 0, sizeof(sums));
+        dict_parallel_for_each(&dict, -1, sum_values, accs);
+        ok = ok && sums[0] == expected;
+        dict_parallel_clear(&dict, DICTHT_FREE_KEYS, 3);
+        ok = ok && dict.load == 0 && dict.table == NULL;
+    }
+
+    /* Small dicts get scanned on the calling thread. */
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    dict_add(&dict, "foo", (void *)1, &result);
+    dict_add(&dict, "bar", (void *)2, &result);
+    sums[0] = 0;
+    dict_parallel_for_each(&dict, 4, sum_values, accs);
+    ok = ok && sums[0] == 3;
+    dict_parallel_clear(&dict, 0, 4);
+    return ok;
+}
+
+int32_t test_fdict(){
+    char buf[12];
+    dict_t dict;
+    fdict_t frozen;
+    bucket_t result;
+    int32_t ok = 1;
+
+    /* Sizes around the small dict limit, and a weak hash that puts most
+     * keys in the overflow dict. */
+    size_t sizes[] = {0, 1, 8, 9, 5000, 5000};
+    for(int32_t k = 0; ok && k < 6; k++){
+        dict_init(&dict, 0, k == 5 ? weak_string_hash : oat_string_hash,
+            generic_string_eq, DICTHT_DEFAULTS);
+        for(intptr_t i = 0; i < (intptr_t)sizes[k]; i++){
+            alpha26(buf, i + 1);
+            dict_add(&dict, strdup(buf), (void *)i, &result);
+        }
+        ok = !fdict_freeze(&frozen, &dict) && frozen.load == (int32_t)sizes[k];
+        dict_clear(&dict, 0);
+
+        for(intptr_t i = 0; ok && i < (intptr_t)sizes[k]; i++){
+            alpha26(buf, i + 1);
+            ok = fdict_get(&frozen, buf) == (void *)i;
+        }
+        ok = ok && fdict_get(&frozen, "") == NULL
+            && fdict_get(&frozen, "not a key") == NULL
+            && (k < 5 || frozen.overflow.load == (int32_t)sizes[k] - 4);
+        fdict_clear(&frozen, DICTHT_FREE_KEYS);
+    }
+    return ok;
+}
+
+int32_t test_hset_add(){
+    char buf[12];
+    hset_t set;
+    hset_init(&set, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+
+    int32_t ok = 1;
+    for(intptr_t i = 0; ok && i < 5000; i++){
+        alpha26(buf, i + 1);
+        char *key = strdup(buf);
+        ok = hset_add(&set, key) == 1 && hset_add(&set, buf) == 0
+            && hset_get(&set, buf) == key;
+    }
+    ok = ok && set.load == 5000 && set.load <= set.length * DICTHT_MAX_LOAD;
+    size_t grow_size = set.length;
+
+    /* Take out everything but every tenth key, then check nothing got lost
+     * by the shifting. */
+    for(intptr_t i = 0; ok && i < 5000; i++){
+        if(i % 10){
+            alpha26(buf, i + 1);
+            char *key = hset_remove(&set, buf);
+            ok = key != NULL && !strcmp(key, buf) && hset_remove(&set, buf) == NULL;
+            free(key);
+        }
+    }
+    ok = ok && set.load == 500 && set.length < grow_size;
+    for(intptr_t i = 0; ok && i < 5000; i++){
+        alpha26(buf, i + 1);
+        ok = hset_contains(&set, buf) == !(i % 10);
+    }
+    hset_clear(&set, DICTHT_FREE_KEYS);
+    return ok;
+}
+
+int32_t test_hset_algebra(){
+    /* Multiples of 2 from 0 to 398 against multiples of 3 from 0 to 597. */
+    hset_t twos, threes, rop;
+    char *keys[600];
+    char buf[12];
+    hset_init(&twos, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    hset_init(&threes, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    for(intptr_t i = 0; i < 600; i++){
+        alpha26(buf, i + 1);
+        keys[i] = strdup(buf);
+        if(i < 400 && i % 2 == 0){
+            hset_add(&twos, keys[i]);
+        }
+        if(i % 3 == 0){
+            hset_add(&threes, keys[i]);
+        }
+    }
+
+    int32_t ok = 1;
+    for(int32_t op = 0; ok && op < 3; op++){
+        int32_t ret = op == 0 ? hset_union(&rop, &twos, &threes)
+            : op == 1 ? hset_intersection(&rop, &twos, &threes)
+            : hset_difference(&rop, &twos, &threes);
+        int32_t count = 0;
+        for(intptr_t i = 0; ok && i < 600; i++){
+            int32_t in_twos = i < 400 && i % 2 == 0;
+            int32_t in_threes = i % 3 == 0;
+            int32_t expected = op == 0 ? in_twos || in_threes
+                : op == 1 ? in_twos && in_threes : in_twos && !in_threes;
+            /* Shared keys, not copies. */
+            ok = (hset_get(&rop, keys[i]) == (expected ? keys[i] : NULL));
+            count += expected;
+        }
+        ok = ok && !ret && rop.load == count;
+        hset_clear(&rop, 0);
+    }
+
+    hset_clear(&twos, 0);
+    hset_clear(&threes, 0);
+    for(intptr_t i = 0; i < 600; i++){
+        free(keys[i]);
+    }
+    return ok;
+}
+
+int32_t test_intern(){
+    char buf[12];
+    char *atoms[3000];
+    intern_t pool;
+    intern_init(&pool, 0);
+
+    int32_t ok = 1;
+    for(intptr_t i = 0; ok && i < 3000; i++){
+        alpha26(buf, i + 1);
+        atoms[i] = intern_str(&pool, buf);
+        ok = atoms[i] != NULL && atoms[i] != buf && !strcmp(atoms[i], buf)
+            && atom_length(atoms[i]) == strlen(buf)
+            && atom_hash(atoms[i]) == oat_string_hash(buf);
+    }
+
+    /* A string bigger than a chunk, then the same strings again. */
+    char *big = malloc(INTERN_CHUNK_SIZE + 1);
+    memset(big, 'k', INTERN_CHUNK_SIZE);
+    big[INTERN_CHUNK_SIZE] = '\0';
+    char *big_atom = intern_str(&pool, big);
+    ok = ok && big_atom != NULL && atom_length(big_atom) == INTERN_CHUNK_SIZE
+        && intern_find(&pool, big) == big_atom;
+    free(big);
+    for(intptr_t i = 0; ok && i < 3000; i++){
+        alpha26(buf, i + 1);
+        ok = intern_str(&pool, buf) == atoms[i] && intern_find(&pool, buf) == atoms[i];
+    }
+    ok = ok && pool.atoms.load == 3001 && intern_find(&pool, "not an atom") == NULL;
+
+    /* Tables keyed by atoms. */
+    dict_t dict;
+    rbtree_t tree;
+    bucket_t result;
+    rbnode_t node;
+    dict_init(&dict, 0, atom_hash, atom_eq, DICTHT_DEFAULTS);
+    rbt_init(&tree, atom_cmp);
+    for(intptr_t i = 0; i < 3000; i++){
+        dict_add(&dict, atoms[i], (void *)i, &result);
+        rbt_insert(&tree, atoms[i], (void *)i, &node);
+    }
+    ok = ok && rbt_assert(&tree);
+    for(intptr_t i = 0; ok && i < 3000; i++){
+        alpha26(buf, i + 1);
+        char *key = intern_find(&pool, buf);
+        ok = dict_get(&dict, key) == (void *)i && rbt_get(&tree, key) == (void *)i;
+    }
+    dict_clear(&dict, 0);
+    rbt_clear(&tree, 0);
+    intern_clear(&pool);
+    return ok && pool.chunks == NULL;
+}
+
+int32_t test_lkey(){
+    /* Keys of every length up to 40 over a small alphabet, so there are
+     * plenty of shared prefixes, checked against memcmp. */
+    char bytes[400][41];
+    lkey_t *keys[400];
+    uint32_t state = 12345;
+    int32_t ok = 1;
+    for(int32_t i = 0; i < 400; i++){
+        size_t length = i % 41;
+        for(size_t j = 0; j < length; j++){
+            state = state * 1103515245 + 12345;
+            bytes[i][j] = (state >> 16) % 3 ? 'a' : (char)(0x80 + i % 2);
+        }
+        keys[i] = lkey_new(bytes[i], length);
+        ok = ok && keys[i]->bytes[length] == '\0'
+            && lkey_hash(keys[i]) == oat_hash(bytes[i], length);
+    }
+    for(int32_t i = 0; ok && i < 400; i++){
+        for(int32_t j = 0; ok && j < 400; j++){
+            size_t li = keys[i]->length, lj = keys[j]->length;
+            int32_t expected = memcmp(bytes[i], bytes[j], li < lj ? li : lj);
+            if(expected == 0){
+                expected = (li > lj) - (li < lj);
+            }
+            int32_t cmp = lkey_cmp(keys[i], keys[j]);
+            ok = (cmp > 0) == (expected > 0) && (cmp < 0) == (expected < 0)
+                && lkey_eq(keys[i], keys[j]) == (expected == 0);
+        }
+    }
+
+    /* Embedded NULs count, and strings hash like oat_string_hash. */
+    lkey_t a, b;
+    lkey_init(&a, "ab\0c", 4);
+    lkey_init(&b, "ab\0d", 4);
+    ok = ok && !lkey_eq(&a, &b) && lkey_cmp(&a, &b) < 0;
+    lkey_t *str = lkey_str("foo");
+    ok = ok && str->length == 3 && lkey_hash(str) == oat_string_hash("foo");
+    free(str);
+
+    /* As dict and rbtree keys, looked up with keys on the stack. */
+    char buf[12];
+    dict_t dict;
+    rbtree_t tree;
+    bucket_t result;
+    rbnode_t node;
+    dict_init(&dict, 0, lkey_hash, lkey_eq, DICTHT_DEFAULTS);
+    rbt_init(&tree, lkey_cmp);
+    for(intptr_t i = 0; i < 2000; i++){
+        alpha26(buf, i + 1);
+        dict_add(&dict, lkey_str(buf), (void *)i, &result);
+        rbt_insert(&tree, lkey_str(buf), (void *)i, &node);
+    }
+    ok = ok && rbt_assert(&tree);
+    for(intptr_t i = 0; ok && i < 4000; i++){
+        alpha26(buf, i + 1);
+        lkey_t probe;
+        lkey_init(&probe, buf, strlen(buf));
+        void *expected = i < 2000 ? (void *)i : NULL;
+        ok = dict_get(&dict, &probe) == expected && rbt_get(&tree, &probe) == expected;
+    }
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    rbt_clear(&tree, RBTREE_FREE_KEYS);
+    for(int32_t i = 0; i < 400; i++){
+        free(keys[i]);
+    }
+    return ok;
+}
+
+int32_t uint64_cmp(const void *lhs, const void *rhs){
+    uint64_t l = *(const uint64_t *)lhs, r = *(const uint64_t *)rhs;
+    return (l > r) - (l < r);
+}
+
+int32_t test_hash64(){
+    /* XXH64's published answers. */
+    int32_t ok = hash64_with(HASH64_PORTABLE, "", 0, 0) == 0xEF46DB3751D8E999ULL
+        && hash64_with(HASH64_PORTABLE, "abc", 3, 0) == 0x44BC2CF5AD770999ULL;
+
+    /* Every supported variant, over every length up to 200 and with one bit
+     * flipped anywhere in a 100 byte key, should give no repeats. */
+    uint8_t bytes[200];
+    for(int32_t i = 0; i < 200; i++){
+        bytes[i] = (uint8_t)(i * 37 + 11);
+    }
+    for(int32_t variant = 0; ok && variant < HASH64_VARIANTS; variant++){
+        if(!hash64_supported(variant)){
+            continue;
+        }
+        uint64_t seen[1001];
+        int32_t count = 0;
+        for(size_t len = 0; len <= 200; len++){
+            seen[count++] = hash64_with(variant, bytes, len, 0);
+        }
+        for(int32_t bit = 0; bit < 800; bit++){
+            bytes[bit / 8] ^= 1 << (bit % 8);
+            seen[count++] = hash64_with(variant, bytes, 100, 0);
+            bytes[bit / 8] ^= 1 << (bit % 8);
+        }
+        for(int32_t i = 0; ok && i < count; i++){
+            for(int32_t j = i + 1; ok && j < count; j++){
+                ok = seen[i] != seen[j];
+            }
+        }
+        ok = ok && hash64_with(variant, bytes, 50, 1) != hash64_with(variant, bytes, 50, 2);
+    }
+
+    /* 2^18 distinct 8 byte keys. 64 bits of hash should have no repeats
+     * among them, where 32 bits would be expected to have about 8. */
+    size_t nkeys = 1 << 18;
+    uint64_t *hashes = malloc(nkeys * sizeof(uint64_t));
+    for(int32_t variant = 0; ok && hashes != NULL && variant < HASH64_VARIANTS; variant++){
+        if(!hash64_supported(variant)){
+            continue;
+        }
+        for(size_t i = 0; i < nkeys; i++){
+            uint64_t key = i * 0x9E3779B97F4A7C15ULL;
+            hashes[i] = hash64_with(variant, &key, sizeof(key), 0);
+        }
+        qsort(hashes, nkeys, sizeof(uint64_t), uint64_cmp);
+        for(size_t i = 1; ok && i < nkeys; i++){
+            ok = hashes[i - 1] != hashes[i];
+        }
+    }
+    ok = ok && hashes != NULL;
+    free(hashes);
+    ok = ok && hash64_supported(hash64_variant())
+        && hash64(bytes, 77, 5) == hash64_with(hash64_variant(), bytes, 77, 5);
+
+    /* As a dict_t hash. */
+    char buf[12];
+    dict_t dict;
+    bucket_t result;
+    dict_init(&dict, 0, hash64_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    for(intptr_t i = 0; i < 2000; i++){
+        alpha26(buf, i + 1);
+        dict_add(&dict, strdup(buf), (void *)i, &result);
+    }
+    for(intptr_t i = 0; ok && i < 2000; i++){
+        alpha26(buf, i + 1);
+        ok = dict_get(&dict, buf) == (void *)i;
+    }
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    return ok;
+}
+
+int32_t test_oat_stream(){
+    /* Streaming in pieces, split at every point, against oat_hash of the
+     * whole. Then dicts keyed by tuples, looked up with tuples on the stack
+     * holding different pointers to equal strings. */
+    uint8_t bytes[40];
+    uint32_t seed = 99;
+    for(int32_t j = 0; j < 40; j++){
+        seed = seed * 1103515245 + 12345;
+        bytes[j] = (uint8_t)(seed >> 16);
+    }
+    int32_t ok = 1;
+    for(size_t len = 0; ok && len <= 40; len++){
+        for(size_t split = 0; ok && split <= len; split++){
+            oat_state_t state;
+            oat_init(&state);
+            oat_update(&state, bytes, split);
+            oat_update(&state, bytes + split, 0);
+            oat_update(&state, bytes + split, len - split);
+            ok = oat_final(&state) == oat_hash(bytes, len);
+        }
+    }
+
+    dict_t dict;
+    bucket_t result;
+    tuple_t pairs[3];
+    char *names[][2] = {{"ab", "c"}, {"a", "bc"}, {"", "abc"}};
+    dict_init(&dict, 0, tuple_string_hash, tuple_string_eq, DICTHT_DEFAULTS);
+    for(intptr_t i = 0; i < 3; i++){
+        tuple_init(pairs + i, names[i][0], names[i][1]);
+        dict_add(&dict, pairs + i, (void *)(i + 1), &result);
+    }
+    ok = ok && tuple_string_hash(pairs) != tuple_string_hash(pairs + 1);
+    char fst[] = "a", snd[] = "bc";
+    tuple_t probe;
+    tuple_init(&probe, fst, snd);
+    ok = ok && dict_get(&dict, &probe) == (void *)2;
+    tuple_init(&probe, fst, fst);
+    ok = ok && dict_get(&dict, &probe) == NULL;
+    dict_clear(&dict, 0);
+
+    dict_init(&dict, 0, tuple_intptr_hash, tuple_intptr_eq, DICTHT_DEFAULTS);
+    for(intptr_t i = 0; i < 3; i++){
+        tuple_init(pairs + i, (void *)i, (void *)(i * i));
+        dict_add(&dict, pairs + i, (void *)(i + 1), &result);
+    }
+    tuple_init(&probe, (void *)2, (void *)4);
+    ok = ok && dict_get(&dict, &probe) == (void *)3;
+    tuple_init(&probe, (void *)4, (void *)2);
+    ok = ok && dict_get(&dict, &probe) == NULL;
+    dict_clear(&dict, 0);
+
+    tuple_t other;
+    tuple_init(&probe, "ab", "c");
+    tuple_init(&other, "a", "bc");
+    ok = ok && tuple_hash(&probe, oat_string_hash, oat_string_hash)
+        != tuple_hash(&other, oat_string_hash, oat_string_hash);
+    return ok;
+}
+
+int32_t test_oat_many(){
+    /* Every lane count this CPU has, against oat_hash one key at a time:
+     * fixed widths up to 40 bytes, and strings of mixed lengths, with high
+     * bytes in both. 37 keys leaves a partial group. */
+    uint8_t bytes[37][41];
+    char strs[37][41];
+    void *keys[37], *strkeys[37];
+    size_t lens[37];
+    int32_t hashes[37];
+    uint32_t state = 777;
+    for(int32_t k = 0; k < 37; k++){
+        for(int32_t j = 0; j < 41; j++){
+            state = state * 1103515245 + 12345;
+            bytes[k][j] = (uint8_t)(state >> 16);
+            strs[k][j] = (char)(0x41 + (state >> 20) % 0xB0);
+        }
+        strs[k][(k * 7) % 41] = '\0';
+        keys[k] = bytes[k];
+        strkeys[k] = strs[k];
+    }
+
+    int32_t ok = 1;
+    int32_t lane_counts[] = {1, 8, 16};
+    for(int32_t c = 0; ok && c < 3 && lane_counts[c] <= oat_lanes(); c++){
+        int32_t lanes = lane_counts[c];
+        for(size_t len = 0; ok && len <= 40; len++){
+            for(int32_t k = 0; k < 37; k++){
+                lens[k] = len;
+            }
+            _oat_hash_lanes(keys, lens, hashes, 37, lanes);
+            for(int32_t k = 0; ok && k < 37; k++){
+                ok = hashes[k] == oat_hash(bytes[k], len);
+            }
+        }
+        for(int32_t k = 0; k < 37; k++){
+            lens[k] = strlen(strs[k]);
+        }
+        _oat_hash_lanes(strkeys, lens, hashes, 37, lanes);
+        for(int32_t k = 0; ok && k < 37; k++){
+            ok = hashes[k] == oat_string_hash(strs[k]);
+        }
+    }
+
+    oat_hash_many(keys, 13, hashes, 37);
+    for(int32_t k = 0; ok && k < 37; k++){
+        ok = hashes[k] == oat_hash(bytes[k], 13);
+    }
+    oat_string_hash_many(strkeys, hashes, 37);
+    for(int32_t k = 0; ok && k < 37; k++){
+        ok = hashes[k] == oat_string_hash(strs[k]);
+    }
+    return ok;
+}
+
+int32_t test_cfilter(){
+    cfilter_t filter;
+    if(cfilter_init(&filter, 10000)){
+        return 0;
+    }
+    size_t capacity = cfilter_capacity(&filter);
+    int32_t ok = capacity >= 10000;
+    for(int32_t i = 0; ok && i < (int32_t)capacity; i++){
+        ok = !cfilter_add(&filter, oat_hash(&i, sizeof(i)));
+    }
+
+    /* No false negatives, and few false positives. */
+    int32_t positives = 0;
+    for(int32_t i = 0; ok && i < (int32_t)capacity; i++){
+        ok = cfilter_contains(&filter, oat_hash(&i, sizeof(i)));
+    }
+    for(int32_t i = (int32_t)capacity; i < 2 * (int32_t)capacity; i++){
+        positives += cfilter_contains(&filter, oat_hash(&i, sizeof(i)));
+    }
+    ok = ok && positives < (int32_t)capacity / 100;
+
+    /* Take out the evens. */
+    for(int32_t i = 0; ok && i < (int32_t)capacity; i += 2){
+        ok = cfilter_remove(&filter, oat_hash(&i, sizeof(i)));
+    }
+    for(int32_t i = 1; ok && i < (int32_t)capacity; i += 2){
+        ok = cfilter_contains(&filter, oat_hash(&i, sizeof(i)));
+    }
+    ok = ok && filter.load == (int32_t)capacity / 2;
+
+    /* Overfilled, it has to refuse adds without losing any. */
+    int32_t i;
+    for(i = (int32_t)capacity; ok && !cfilter_add(&filter, oat_hash(&i, sizeof(i))); i++);
+    for(int32_t j = (int32_t)capacity; ok && j <= i; j++){
+        ok = cfilter_contains(&filter, oat_hash(&j, sizeof(j)));
+    }
+    cfilter_clear(&filter);
+    return ok;
+}
+
+int32_t test_dict_filter(){
+    char buf[12];
+    dict_t dict;
+    bucket_t result;
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_FILTER);
+
+    int32_t ok = dict.filter == NULL;
+    for(intptr_t i = 0; ok && i < 20000; i++){
+        alpha26(buf, i + 1);
+        dict_add(&dict, strdup(buf), (void *)i, &result);
+        ok = dict.filter == NULL ? i < DICTHT_SMALL_SIZE : dict.filter->load == dict.load;
+    }
+    for(intptr_t i = 0; ok && i < 40000; i++){
+        alpha26(buf, i + 1);
+        ok = dict_get(&dict, buf) == (i < 20000 ? (void *)i : NULL);
+    }
+    for(intptr_t i = 0; ok && i < 20000; i += 2){
+        alpha26(buf, i + 1);
+        ok = dict_remove(&dict, buf, &result) == (void *)i;
+        free(result.key);
+    }
+    ok = ok && dict.filter != NULL && dict.filter->load == dict.load;
+    for(intptr_t i = 0; ok && i < 20000; i++){
+        alpha26(buf, i + 1);
+        ok = dict_get(&dict, buf) == (i % 2 ? (void *)i : NULL);
+    }
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    ok = ok && dict.filter == NULL;
+
+    /* dict_build fills the filter in at the end. */
+    void *keys[3000];
+    for(intptr_t i = 0; i < 3000; i++){
+        alpha26(buf, i + 1);
+        keys[i] = strdup(buf);
+    }
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_FILTER);
+    ok = ok && !dict_build(&dict, keys, keys, 3000, 2) && dict.filter != NULL
+        && dict.filter->load == 3000 && dict_get(&dict, keys[1234]) == keys[1234]
+        && dict_get(&dict, "not a key") == NULL;
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+
+    /* Far more keys than slots for their four hashes: the filter is given up
+     * after a few tries, and the dict works on without it. */
+    dict_init(&dict, 0, weak_string_hash, generic_string_eq, DICTHT_FILTER);
+    for(intptr_t i = 0; i < 100; i++){
+        alpha26(buf, i + 1);
+        dict_add(&dict, strdup(buf), (void *)i, &result);
+    }
+    ok = ok && dict.filter == NULL && dict.load == 100;
+    for(intptr_t i = 0; ok && i < 200; i++){
+        alpha26(buf, i + 1);
+        ok = dict_get(&dict, buf) == (i < 100 ? (void *)i : NULL);
+    }
+    dict_clear(&dict, DICTHT_FREE_KEYS);
+    return ok;
+}
+
+const void *string_value_bytes(const void *value, size_t *length){
+    *length = strlen((const char *)value) + 1;
+    return value;
+}
+
+int32_t test_dsnap(){
+    /* A name of our own, so test runs side by side don't share a file. */
+    char path[] = "/tmp/kmdata_test.snap.XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0){
+        return 0;
+    }
+    close(fd);
+    char buf[12];
+    dict_t dict;
+    dsnap_t snap;
+    bucket_t result;
+    size_t length;
+
+    /* A small dict, with the values stored as the pointers themselves. */
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    dict_add(&dict, "foo", (void *)42, &result);
+    dict_add(&dict, "bar", (void *)0xF00, &result);
+    if(dsnap_write(path, &dict, NULL) || dsnap_open(&snap, path, oat_string_hash)){
+        dict_clear(&dict, 0);
+        remove(path);
+        return 0;
+    }
+    const intptr_t *value = dsnap_get(&snap, "bar", &length);
+    int32_t ok = snap.load == 2 && value != NULL && *value == 0xF00
+        && length == sizeof(void *) && *(const intptr_t *)dsnap_get(&snap, "foo", NULL) == 42
+        && dsnap_get(&snap, "baz", NULL) == NULL && dsnap_get(&snap, "", NULL) == NULL;
+    dsnap_close(&snap);
+    dict_clear(&dict, 0);
+
+    /* A big one with string values, including the empty key. */
+    dict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    for(intptr_t i = 0; i < 3000; i++){
+        alpha26(buf, i);
+        dict_add(&dict, strdup(buf), strdup(buf), &result);
+    }
+    ok = ok && !dsnap_write(path, &dict, string_value_bytes)
+        && !dsnap_open(&snap, path, oat_string_hash) && snap.load == 3000;
+    for(intptr_t i = 0; ok && i < 3000; i++){
+        alpha26(buf, i);
+        const char *data = dsnap_get(&snap, buf, &length);
+        ok = data != NULL && !strcmp(data, buf) && length == strlen(buf) + 1
+            && ((uintptr_t)data % DSNAP_ALIGN) == 0;
+    }
+    ok = ok && dsnap_get(&snap, "not a key", NULL) == NULL;
+    dsnap_close(&snap);
+    dict_clear(&dict, DICTHT_FREE_KEYS | DICTHT_FREE_VALUES);
+
+    /* Opening with some other hash function has to fail. */
+    ok = ok && dsnap_open(&snap, path, weak_string_hash) == -1;
+
+    /* A damaged file: every slot full, matching "foo", and pointing at a
+     * record that runs off the end. Lookups have to stay in bounds and
+     * give up. */
+    FILE *file = fopen(path, "r+b");
+    dsheader_t header;
+    memset(&header, 0, sizeof(dsheader_t));
+    ok = ok && file != NULL && fread(&header, sizeof(dsheader_t), 1, file) == 1
+        && !fseek(file, (long)header.slots_offset, SEEK_SET);
+    dsslot_t bad = { .hash = oat_string_hash("foo"), .key_length = 3,
+        .offset = header.file_size - 4 };
+    for(uint64_t i = 0; ok && i < header.length; i++){
+        ok = fwrite(&bad, sizeof(dsslot_t), 1, file) == 1;
+    }
+    if(file != NULL){
+        ok = !fclose(file) && ok;
+    }
+    ok = ok && !dsnap_open(&snap, path, oat_string_hash);
+    if(ok){
+        ok = dsnap_get(&snap, "foo", NULL) == NULL && dsnap_get(&snap, "baz", NULL) == NULL;
+        dsnap_close(&snap);
+    }
+    remove(path);
+    return ok;
+}
+
+int32_t test_oadict_add(){
+    oadict_t dict;
+    oadict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+
+    char *keys[] = {"foo", "bar", "baz", "quuuuuux"};
+    intptr_t values[] = {42, 0xF00, 1337, 31337};
+    bucket_t result;
+
+    for(int i = 0; i < 4; i++){
+        oadict_add(&dict, keys[i], (void *)values[i], &result);
+        if((char *)result.key != keys[i] || (intptr_t)result.data != values[i]){
+            oadict_clear(&dict, 0);
+            return 0;
+        }
+    }
+
+    oadict_add(&dict, "bar", (void *)0xdeadbeef, &result);
+    if(strcmp((char *)result.key, "bar") || (intptr_t)result.data != 0xF00){
+        oadict_clear(&dict, 0);
+        return 0;
+    }
+
+    intptr_t expected[] = {42, 0xdeadbeef, 1337, 31337};
+
+    for(int i = 0; i<4; i++){
+        intptr_t val = (intptr_t)oadict_get(&dict, keys[i]);
+        if(val != expected[i]){
+            oadict_clear(&dict, 0);
+            return 0;
+        }
+    }
+
+    if(oadict_get(&dict, "xyzzy") != NULL || dict.load != 4){
+        oadict_clear(&dict, 0);
+        return 0;
+    }
+
+    oadict_clear(&dict, 0);
+    return 1;
+}
+
+int32_t test_oadict_remove(){
+    oadict_t dict;
+    oadict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+
+    char *keys[] = {"foo", "bar", "baz", "quuuuuux"};
+    intptr_t values[] = {42, 0xF00, 1337, 31337};
+    bucket_t result;
+
+    for(int i = 0; i < 4; i++){
+        oadict_add(&dict, keys[i], (void *)values[i], &result);
+    }
+
+    intptr_t r0 = (intptr_t)oadict_remove(&dict, "foo", &result);
+    if(r0 != 42 || strcmp((char *)result.key, "foo")){
+        oadict_clear(&dict, 0);
+        return 0;
+    }
+
+    intptr_t r1 = (intptr_t)oadict_remove(&dict, "baz", &result);
+    if(r1 != 1337){
+        oadict_clear(&dict, 0);
+        return 0;
+    }
+
+    if(oadict_remove(&dict, "baz", &result) != NULL || result.key != NULL){
+        oadict_clear(&dict, 0);
+        return 0;
+    }
+
+    assert(dict.load == 2);
+    char *xkeys[] = {"bar", "quuuuuux"};
+    intptr_t xvals[] = {0xF00, 31337};
+
+    for(int i = 0; i < 2; i++){
+        intptr_t rt = (intptr_t)oadict_get(&dict, xkeys[i]);
+        if(rt != xvals[i]){
+            oadict_clear(&dict, 0);
+            return 0;
+        }
+    }
+
+    oadict_clear(&dict, 0);
+    return 1;
+}
+
+int32_t test_oadict_resize(){
+    char buf[12];
+    oadict_t dict;
+    oadict_init(&dict, 0, oat_string_hash, generic_string_eq, DICTHT_DEFAULTS);
+    bucket_t result;
+
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        oadict_add(&dict, strdup(buf), (void *)i, &result);
+        if(strcmp(result.key, buf) || (intptr_t)result.data != i){
+            oadict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+    }
+
+    assert(dict.load == 4082);
+    size_t grow_size = dict.length;
+
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        intptr_t r0 = (intptr_t)oadict_get(&dict, buf);
+        if(r0 != i){
+            oadict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+    }
+
+    for(intptr_t i = 500; i < 4093; i++){
+        alpha26(buf, i);
+        intptr_t r0 = (intptr_t)oadict_remove(&dict, buf, &result);
+        if(r0 != i || strcmp(result.key, buf)){
+            oadict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+        free(result.key); /* This was allocated with strdup */
+    }
+
+    assert(dict.length < grow_size);
+
+    for(intptr_t i = 11; i < 500; i++){
+        alpha26(buf, i);
+        if((intptr_t)oadict_get(&dict, buf) != i){
+            oadict_clear(&dict, DICTHT_FREE_KEYS);
+            return 0;
+        }
+    }
+
+    oadict_clear(&dict, DICTHT_FREE_KEYS);
+    return 1;
+}
+
+KM_DICT_DEFINE(intdict, intptr_t, intptr_t, km_intptr_hash, km_intptr_eq)
+
+KM_DICT_DEFINE(strdict, const char *, intptr_t, oat_string_hash_inline, km_string_eq)
+
+int32_t test_tdict_intptr(){
+    intdict_t dict;
+    intdict_entry_t result;
+    if(intdict_init(&dict, 0, DICTHT_DEFAULTS)){
+        return 0;
+    }
+
+    /* Enough keys to grow the table several times. */
+    for(intptr_t i = -2000; i < 2000; i++){
+        if(intdict_add(&dict, i * 7, i, &result) != 0 || result.data != i){
+            intdict_clear(&dict);
+            return 0;
+        }
+    }
+    assert(dict.load == 4000 && dict.length > KM_DICT_MINIMUM_SIZE);
+
+    if(intdict_add(&dict, 42 * 7, 0xF00, &result) != 1 || result.key != 42 * 7
+        || result.data != 42 || *intdict_get(&dict, 42 * 7) != 0xF00){
+        intdict_clear(&dict);
+        return 0;
+    }
+    *intdict_get(&dict, 42 * 7) = 42;
+
+    for(intptr_t i = -2000; i < 2000; i++){
+        intptr_t *value = intdict_get(&dict, i * 7);
+        if(value == NULL || *value != i || intdict_get(&dict, i * 7 + 1) != NULL){
+            intdict_clear(&dict);
+            return 0;
+        }
+    }
+
+    /* Removing every other key exercises the backward shift. */
+    for(intptr_t i = -2000; i < 2000; i += 2){
+        if(intdict_remove(&dict, i * 7, &result) != 1 || result.data != i){
+            intdict_clear(&dict);
+            return 0;
+        }
+    }
+    if(intdict_remove(&dict, -2000 * 7, &result) != 0 || dict.load != 2000){
+        intdict_clear(&dict);
+        return 0;
+    }
+
+    for(intptr_t i = -2000; i < 2000; i++){
+        intptr_t *value = intdict_get(&dict, i * 7);
+        if((i % 2 == 0) != (value == NULL) || (value != NULL && *value != i)){
+            intdict_clear(&dict);
+            return 0;
+        }
+    }
+
+    intdict_clear(&dict);
+
+    /* A dict with no table, as init leaves it with no memory, turns adds
+     * away instead of writing anywhere. */
+    return intdict_add(&dict, 7, 7, &result) == -1 && intdict_get(&dict, 7) == NULL
+        && intdict_remove(&dict, 7, &result) == 0 && dict.load == 0;
+}
+
+void tdict_free_key(const char *key, intptr_t value, void *arg){
+    free((char *)key);
+}
+
+int32_t test_tdict_string(){
+    char buf[12];
+    strdict_t dict;
+    strdict_entry_t result;
+    strdict_init(&dict, 0, DICTHT_DEFAULTS);
+
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        strdict_add(&dict, strdup(buf), i, &result);
+    }
+
+    for(intptr_t i = 500; i < 4093; i++){
+        alpha26(buf, i);
+        if(strdict_remove(&dict, buf, &result) != 1 || result.data != i
+            || strcmp(result.key, buf)){
+            strdict_foreach(&dict, tdict_free_key, NULL);
+            strdict_clear(&dict);
+            return 0;
+        }
+        free((char *)result.key);
+    }
+
+    for(intptr_t i = 11; i < 4093; i++){
+        alpha26(buf, i);
+        intptr_t *value = strdict_get(&dict, buf);
+        if((i < 500) != (value != NULL) || (value != NULL && *value != i)){
+            strdict_foreach(&dict, tdict_free_key, NULL);
+            strdict_clear(&dict);
+            return 0;
+        }
+    }
+
+    strdict_foreach(&dict, tdict_free_key, NULL);
+    strdict_clear(&dict);
+    return 1;
+}
+
 int32_t generic_strcmp(const void *lhs, const void *rhs){
     return strcmp((const char *)lhs, (const char *)rhs);
 }
 
+int32_t generic_intptr_cmp(const void *lhs, const void *rhs){
+    return ((intptr_t)lhs > (intptr_t)rhs) - ((intptr_t)lhs < (intptr_t)rhs);
+}
+
+int32_t test_rbt_churn(){
+    /* Random inserts and removes over a small key range, so both hit and
+     * miss often, checked against a plain array. Values are malloc'd, and
+     * whatever's left is freed by rbt_clear. */
+    rbtree_t tree;
+    rbt_init(&tree, generic_intptr_cmp);
+    rbnode_t result;
+    intptr_t *present[256] = {NULL};
+    size_t size = 0;
+    uint32_t state = 4242;
+    int32_t ok = 1;
+
+    for(int32_t i = 0; ok && i < 20000; i++){
+        state = state * 1103515245 + 12345;
+        intptr_t key = (state >> 16) % 256;
+        if((state >> 8) & 1){
+            intptr_t *value = malloc(sizeof(intptr_t));
+            *value = i;
+            void *old = rbt_insert(&tree, (void *)key, value, &result);
+            if(present[key] != NULL){
+                ok = old == present[key];
+                free(old);
+            }else{
+                ok = old == value;
+                size++;
+            }
+            present[key] = value;
+        }else{
+            void *old = rbt_remove(&tree, (void *)key, &result);
+            ok = old == present[key] && (old == NULL || result.key == (void *)key);
+            if(old != NULL){
+                free(old);
+                size--;
+            }
+            present[key] = NULL;
+        }
+        ok = ok && tree.size == size && (i % 64 || rbt_assert(&tree));
+    }
+    for(intptr_t key = 0; ok && key < 256; key++){
+        ok = rbt_get(&tree, (void *)key) == present[key];
+    }
+    ok = ok && rbt_assert(&tree);
+    rbt_clear(&tree, RBTREE_FREE_VALUES);
+    return ok && tree.root == NULL && tree.size == 0;
+}
+
 int32_t test_rbt_add(){
     rbtree_t tree;
     rbt_init(&tree, generic_strcmp);
@@ -818,6 +2537,37 @@ int main(int argc, char **argv){
         test_dict_add,
         test_dict_remove, 
         test_dict_resize,
+        test_dict_incremental,
+        test_dict_stored_hash,
+        test_dict_get_many,
+        test_dict_treeify,
+        test_dict_treeify_incremental,
+        test_dict_pow2,
+        test_dict_small,
+        test_dict_upsert,
+        test_dict_build,
+        test_dict_parallel,
+        test_cfilter,
+        test_dict_filter,
+        test_cdict_basic,
+        test_cdict_threads,
+        test_cdict_resize,
+        test_odict_order,
+        test_odict_resize,
+        test_dsnap,
+        test_fdict,
+        test_hset_add,
+        test_hset_algebra,
+        test_intern,
+        test_lkey,
+        test_hash64,
+        test_oat_many,
+        test_oat_stream,
+        test_oadict_add,
+        test_oadict_remove,
+        test_oadict_resize,
+        test_tdict_intptr,
+        test_tdict_string,
         test_rbt_add, 
         test_rbt_remove,
         test_rbt_get_miss,
@@ -825,6 +2575,7 @@ int main(int argc, char **argv){
         test_rbt_remove_empty,
         test_rbt_maxn,
         test_rbt_minn,
+        test_rbt_churn,
         test_vec_add,
         test_vec_remove,
         test_vec_set,
@@ -1,14 +1,28 @@
 /* kmdata Data Structures Library
  * Unit test program. */
 
+#ifndef KMDATA_UNITTEST_H
+#define KMDATA_UNITTEST_H
+
 #include<assert.h>
 #include<stdio.h>
 #include<stdlib.h>
 #include<stdint.h>
+#include<unistd.h>
 
+#include "cdict.h"
 #include "dict.h"
+#include "oadict.h"
+#include "odict.h"
+#include "dsnap.h"
+#include "fdict.h"
+#include "hash64.h"
+#include "hset.h"
+#include "intern.h"
+#include "lkey.h"
 #include "oat.h"
 #include "rbtree.h"
+#include "tdict.h"
 #include "vector.h"
 
 int32_t assert_intptr_lstcontents(list_t *lst, intptr_t *expect, int32_t len);
@@ -51,8 +65,96 @@ void alpha26(char *buf, intptr_t n);
 
 int32_t test_dict_resize();
 
+int32_t test_dict_incremental();
+
+int32_t counting_string_hash(const void *str);
+
+int32_t counting_string_eq(const void *lhs, const void *rhs);
+
+int32_t test_dict_stored_hash();
+
+int32_t test_dict_get_many();
+
+int32_t weak_string_hash(const void *str);
+
+int32_t test_dict_treeify();
+
+int32_t bang_string_hash(const void *str);
+
+int32_t test_dict_treeify_incremental();
+
+int32_t intptr_hash(const void *key);
+
+int32_t intptr_eq(const void *lhs, const void *rhs);
+
+int32_t test_dict_pow2();
+
+int32_t test_dict_small();
+
+int32_t test_dict_upsert();
+
+int32_t test_dict_build();
+
+void sum_values(void *key, void *data, void *acc);
+
+int32_t test_dict_parallel();
+
+int32_t test_cfilter();
+
+int32_t test_dict_filter();
+
+int32_t test_cdict_basic();
+
+void *cdict_writer(void *arg);
+
+void *cdict_reader(void *arg);
+
+int32_t test_cdict_threads();
+
+int32_t test_cdict_resize();
+
+int32_t test_odict_order();
+
+int32_t test_odict_resize();
+
+const void *string_value_bytes(const void *value, size_t *length);
+
+int32_t test_dsnap();
+
+int32_t test_fdict();
+
+int32_t test_hset_add();
+
+int32_t test_hset_algebra();
+
+int32_t test_intern();
+
+int32_t test_lkey();
+
+int32_t uint64_cmp(const void *lhs, const void *rhs);
+
+int32_t test_hash64();
+
+int32_t test_oat_many();
+
+int32_t test_oat_stream();
+
+int32_t test_oadict_add();
+
+int32_t test_oadict_remove();
+
+int32_t test_oadict_resize();
+
+int32_t test_tdict_intptr();
+
+void tdict_free_key(const char *key, intptr_t value, void *arg);
+
+int32_t test_tdict_string();
+
 int32_t generic_strcmp(const void *lhs, const void *rhs);
 
+int32_t generic_intptr_cmp(const void *lhs, const void *rhs);
+
 int32_t test_rbt_add();
 
 int32_t test_rbt_remove();
@@ -63,6 +165,8 @@ int32_t test_rbt_maxn();
 
 int32_t test_rbt_minn();
 
+int32_t test_rbt_churn();
+
 int32_t assert_intptr_veccontents(vector_t *vec, intptr_t *expected, size_t n);
 
 int32_t test_vec_add();
@@ -75,3 +179,4 @@ int32_t test_vec_addi();
 
 int32_t test_vec_resize();
 
+#endif
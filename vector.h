@@ -2,6 +2,9 @@
  * kmdata Data Structures Library
  * Vector implementation. */
 
+#ifndef KMDATA_VECTOR_H
+#define KMDATA_VECTOR_H
+
 #include<stdio.h>
 #include<stdint.h>
 #include<stdlib.h>
@@ -40,4 +43,4 @@ void *vec_addi(vector_t *vec, int32_t i, void *value);
 
 void vec_print(FILE *output, vector_t *vec, void (*disp)(FILE *, const void *));
 
-
+#endif